@@ -5,18 +5,54 @@
 #include "../util/ail/ail.h"       // For typedefs and some useful macros
 #include "../util/ail/ail_alloc.h" // For allocation
 #include "../util/ail/ail_bench.h" // For benchmarking
+#include "../util/cpu.h"           // For runtime detection of SIMD extensions
+#include "../util/args.h"          // For command line options
+#include "../util/pool.h"          // For the worker threads of copy_parallel/move_parallel
+#include "../util/bench.h"         // For exporting benchmark results as CSV/JSON
+#include "../util/pages.h"         // For backing buffers with huge pages
+#include "../util/uring.h"         // For the io_uring backends of the file I/O benchmark
+#include "../util/size_class.h"    // For the size classes of the dispatch and prefetch tables
+#include "../util/prefetch.h"      // For the distances and hints of the prefetching copies
+#include "../util/plugin.h"        // For loading external copy/move routines from shared objects
 #include <stdio.h>                 // For printf
 #include <time.h>                  // For time
 #include <stdlib.h>                // For srand, rand
 #include <string.h>                // For memcpy, memmove (used as reference implementations in benchmark)
-#include <xmmintrin.h>             // For SIMD instructions
+#include <immintrin.h>             // For SIMD instructions
+#if defined(__linux__)
+#   include <sys/mman.h>           // For mmap
+#   include <sys/syscall.h>        // For SYS_mremap, SYS_memfd_create, SYS_copy_file_range, SYS_splice
+#   include <unistd.h>             // For syscall, ftruncate, close, pread, pwrite
+#   include <fcntl.h>              // For open, posix_fadvise
+#   include <sys/vfs.h>            // For statfs
+#   include <sys/sendfile.h>       // For sendfile
+#   include <errno.h>              // For errno
+#endif
 
 #define TEST
 #define BENCH
 // #define BENCH_PER_BUF_SIZE
+#define GENERATED_KERNELS // Adds the kernels generated from every combination of element width, unroll factor, direction and alignment strategy
 #define MIN_BUFFER_SIZE 32
 #define MAX_BUFFER_SIZE AIL_MB(512)
-#define ITER_COUNT 8
+#define ITER_COUNT 8 // Minimum amount of measured calls per routine and buffer
+#define MAX_FUNC_COUNT 192
+#define MAX_PLUGIN_COUNT 8 // Amount of shared objects that can be loaded with -plugin
+#define THREAD_COUNT 0                // Amount of threads used by copy_parallel/move_parallel (0 means one per logical CPU)
+#define PARALLEL_MIN_CHUNK AIL_KB(64) // copy_parallel/move_parallel don't split copies into chunks smaller than this
+#define ALIGN_STEP 4                  // Step between the src/dst offsets that are benchmarked with -alignment
+#define BUFFER_PAGES PAGES_4K         // Kind of pages backing all buffers (see util/pages.h)
+#define COMPARE_PAGES PAGES_2M        // Kind of huge pages that is compared against 4K pages with -compare-pages
+#define DISPATCH_TABLE_PATH "mem-copy-dispatch.txt" // Where the calibrated kernels of mem_copy_auto/mem_move_auto are stored
+#define FILE_IO_SIZE AIL_MB(256)      // Size of the file that is copied with -file-io
+#define FILE_IO_DIRS "/dev/shm,."     // Comma-separated directories in which -file-io creates its files (tmpfs and the disk of the working directory)
+#define FILE_IO_CHUNK AIL_MB(1)       // Size of each read/write of the chunked file I/O backends
+#define URING_QUEUE_DEPTH 8           // Amount of chunks that the io_uring backends keep in flight
+#define COPY_BATCH_PREFETCH 8         // Distance in descriptors at which copy_batch prefetches the regions of upcoming descriptors (0 disables it)
+#define BATCH_SIZE 1024               // Amount of descriptors per batch that is benchmarked with -batch
+#define PREFETCH_DISTANCE AIL_KB(1)   // Distance at which the *_prefetch copies prefetch src, unless a tuned table is loaded
+#define PREFETCH_HINT PREFETCH_T0     // Locality hint of the *_prefetch copies (PREFETCH_T0 or PREFETCH_NTA), unless a tuned table is loaded
+#define PREFETCH_TABLE_PATH "mem-copy-prefetch.txt" // Where -prefetch-tune stores the best distance and hint per stream and size class
 
 
 #ifdef ALL
@@ -56,6 +92,7 @@ typedef struct {
     u8 *dst;
     u8 *src;
     u8 start_byte;
+    Page_Kind pages;
 } Buffer;
 AIL_SLICE_INIT(Buffer);
 
@@ -65,7 +102,10 @@ typedef struct {
     b32 overlap_left;
 } Input;
 
-global Input test_inputs[] = {
+typedef void (*FuncType)(void *dst, void *src, u64 size);
+
+#define TEST_INPUT_CAP 8192
+global Input test_inputs[TEST_INPUT_CAP] = {
     { .size = 1,              .overlap_size = 0 },
     { .size = 1,              .overlap_size = 1 },
     { .size = 15,             .overlap_size = 0 },
@@ -98,7 +138,28 @@ global Input test_inputs[] = {
     { .size = AIL_KB(1) + 17, .overlap_size = AIL_KB(1) + 2, .overlap_left = true },
     { .size = AIL_KB(1) + 17, .overlap_size = AIL_KB(1) + 2, .overlap_left = true },
 };
-typedef Buffer TestBufferList[AIL_ARRLEN(test_inputs)];
+global u64 test_inputs_count;
+typedef Buffer TestBufferList[TEST_INPUT_CAP];
+
+// Adds every size up to SMALL_TEST_MAX_SIZE, each without overlap and with a range of overlaps on both sides,
+// since small copies are mostly handled by special cases per size class, which are easy to get wrong for single sizes
+#define SMALL_TEST_MAX_SIZE 256
+internal void add_small_test_inputs(void)
+{
+    while (test_inputs[test_inputs_count].size) test_inputs_count++;
+    for (u64 size = 0; size <= SMALL_TEST_MAX_SIZE; size++) {
+        u64 overlaps[] = { 0, 1, 2, 7, 8, 15, 16, 31, 32, 63, 64, size/2, size - 8, size - 1, size };
+        for (u64 i = 0; i < AIL_ARRLEN(overlaps); i++) {
+            b32 is_new = overlaps[i] <= size && (!i || overlaps[i]);
+            for (u64 j = 0; j < i && is_new; j++) is_new = overlaps[j] != overlaps[i];
+            if (!is_new) continue;
+            for (u32 left = 0; left < (overlaps[i] ? 2u : 1u); left++) {
+                AIL_ASSERT(test_inputs_count < TEST_INPUT_CAP);
+                test_inputs[test_inputs_count++] = (Input){ .size = size, .overlap_size = overlaps[i], .overlap_left = left };
+            }
+        }
+    }
+}
 
 internal void print_buffer(Buffer buf)
 {
@@ -121,6 +182,9 @@ internal u8 randomize_buffer_start_byte(Buffer *buf)
     return buf->start_byte;
 }
 
+global Page_Kind buffer_pages = BUFFER_PAGES;
+global b32       buffer_populate; // Prefault all pages of new buffers
+
 internal Buffer get_buffer(u64 size, u64 overlap_size, b32 overlap_left)
 {
     Buffer buf = {0};
@@ -128,12 +192,22 @@ internal Buffer get_buffer(u64 size, u64 overlap_size, b32 overlap_left)
     buf.overlap_size = overlap_size;
     randomize_buffer_start_byte(&buf);
     if (!overlap_size) {
-        buf.dst  = AIL_CALL_ALLOC(ail_alloc_pager, size);
-        buf.src  = AIL_CALL_ALLOC(ail_alloc_pager, size);
+        // One kind describes the buffer, so if src had to fall back to smaller pages, dst is mapped again with those
+        Page_Kind src_pages;
+        buf.dst = pages_alloc(size, buffer_pages, buffer_populate, &buf.pages);
+        buf.src = pages_alloc(size, buf.pages, buffer_populate, &src_pages);
+        while (src_pages != buf.pages) {
+            pages_free(buf.dst, size, buf.pages);
+            buf.dst = pages_alloc(size, src_pages, buffer_populate, &buf.pages);
+            if (buf.pages != src_pages) {
+                pages_free(buf.src, size, src_pages);
+                buf.src = pages_alloc(size, buf.pages, buffer_populate, &src_pages);
+            }
+        }
         // AIL_ASSERT((u64)buf.dst % sizeof(__m128) == 0);
         // AIL_ASSERT((u64)buf.src % sizeof(__m128) == 0);
     } else {
-        u8 *left  = AIL_CALL_ALLOC(ail_alloc_pager, size*2 - overlap_size);
+        u8 *left  = pages_alloc(size*2 - overlap_size, buffer_pages, buffer_populate, &buf.pages);
         u8 *right = left + size - overlap_size;
         if (overlap_left) {
             buf.dst = left;
@@ -151,14 +225,15 @@ internal Buffer get_buffer(u64 size, u64 overlap_size, b32 overlap_left)
 internal void free_buffer(Buffer buf)
 {
     if (buf.overlap_size) {
-        AIL_CALL_FREE(ail_alloc_pager, AIL_MIN(buf.dst, buf.src));
+        pages_free(AIL_MIN(buf.dst, buf.src), buf.size*2 - buf.overlap_size, buf.pages);
     } else {
-        AIL_CALL_FREE(ail_alloc_pager, buf.dst);
-        AIL_CALL_FREE(ail_alloc_pager, buf.src);
+        pages_free(buf.dst, buf.size, buf.pages);
+        pages_free(buf.src, buf.size, buf.pages);
     }
 }
 
-internal void fill_buffer(Buffer *buf)
+// Writes the pattern into src, the pages of dst that don't overlap src stay untouched
+internal void fill_source(Buffer *buf)
 {
     u8 x = randomize_buffer_start_byte(buf);
 	for (u64 i = 0; i < buf->size; i++) {
@@ -166,6 +241,13 @@ internal void fill_buffer(Buffer *buf)
 	}
 }
 
+// Touches all pages of dst before filling src, so that no routine pays for the page faults of a fresh buffer
+internal void fill_buffer(Buffer *buf)
+{
+    memset(buf->dst, 0, buf->size);
+    fill_source(buf);
+}
+
 internal b32 test_buffer(Buffer buf)
 {
     u8 x = buf.start_byte;
@@ -176,7 +258,8 @@ internal b32 test_buffer(Buffer buf)
 }
 
 
-internal void copy_bytes(void* restrict dst, void* restrict src, u64 size)
+// The move-procedures reuse some of the copy-procedures for overlapping regions, which is why those can't be marked as restrict
+internal void copy_bytes(void *dst, void *src, u64 size)
 {
     AIL_BENCH_PROFILE_MEM_START(copy_bytes, size);
     u8 *d = dst;
@@ -198,7 +281,7 @@ internal void move_bytes(void *dst, void *src, u64 size)
     AIL_BENCH_PROFILE_END(move_bytes);
 }
 
-internal void copy_bytes_wide(void* restrict dst, void* restrict src, u64 size)
+internal void copy_bytes_wide(void *dst, void *src, u64 size)
 {
     AIL_BENCH_PROFILE_MEM_START(copy_bytes_wide, size);
     u8 *d = dst;
@@ -210,19 +293,19 @@ internal void copy_bytes_wide(void* restrict dst, void* restrict src, u64 size)
         d[i + 2] = s[i + 2];
         d[i + 3] = s[i + 3];
     }
-    for (u64 i = 0; i < rem; i++) {
-        d[size - i - 1] = s[size - i - 1];
+    for (u64 i = size - rem; i < size; i++) {
+        d[i] = s[i];
     }
     AIL_BENCH_PROFILE_END(copy_bytes_wide);
 }
 
-internal void copy_bytes_wide_backwards(void* restrict dst, void* restrict src, u64 size)
+internal void copy_bytes_wide_backwards(void *dst, void *src, u64 size)
 {
     AIL_BENCH_PROFILE_MEM_START(copy_bytes_wide_backwards, size);
     u8 *d = dst;
     u8 *s = src;
     u64 rem = size % 4;
-    for (i64 i = size - 1; i >= 0; i -= 4) {
+    for (i64 i = size - 1; i >= (i64)rem; i -= 4) {
         d[i - 0] = s[i - 0];
         d[i - 1] = s[i - 1];
         d[i - 2] = s[i - 2];
@@ -247,7 +330,7 @@ internal void move_bytes_wide(void *dst, void *src, u64 size)
     AIL_BENCH_PROFILE_END(move_bytes_wide);
 }
 
-internal void copy_quads(void* restrict dst, void* restrict src, u64 size)
+internal void copy_quads(void *dst, void *src, u64 size)
 {
     AIL_BENCH_PROFILE_MEM_START(copy_quads, size);
     u64 n   = size / sizeof(u64);
@@ -259,7 +342,7 @@ internal void copy_quads(void* restrict dst, void* restrict src, u64 size)
     AIL_BENCH_PROFILE_END(copy_quads);
 }
 
-internal void copy_quads_backwards(void* restrict dst, void* restrict src, u64 size)
+internal void copy_quads_backwards(void *dst, void *src, u64 size)
 {
     AIL_BENCH_PROFILE_MEM_START(copy_quads_backwards, size);
     u64 n   = size / sizeof(u64);
@@ -320,7 +403,7 @@ internal void copy_simd(void* restrict dst, void* restrict src, u64 size)
     AIL_BENCH_PROFILE_END(copy_simd);
 }
 
-internal void copy_simd_backwards(void* restrict dst, void* restrict src, u64 size)
+internal void copy_simd_backwards(void *dst, void *src, u64 size)
 {
     AIL_BENCH_PROFILE_MEM_START(copy_simd_backwards, size);
     AIL_STATIC_ASSERT(AIL_IS_2POWER_POS(sizeof(__m128))); // Otherwise, fancy modulo trick below doesn't work
@@ -416,189 +499,2883 @@ internal void copy_simd_aligned(void* restrict dst, void* restrict src, u64 size
     AIL_BENCH_PROFILE_END(copy_simd_aligned);
 }
 
-internal void copy_rep_movs(void* restrict dst, void* restrict src, u64 size)
+CPU_TARGET("avx") internal void copy_avx(void* restrict dst, void* restrict src, u64 size)
 {
-    AIL_BENCH_PROFILE_MEM_START(copy_rep_movs, size);
-    u64 n   = size / sizeof(u64);
-    u64 rem = size & (sizeof(u64) - 1);
-    u64 *s = (u64*)src;
-    u64 *d = (u64*)dst;
-    if (n) __movsq(d, s, n);
-    if (rem) __movsb((u8*)(d + n), (u8*)(s + n), rem);
-    AIL_BENCH_PROFILE_END(copy_rep_movs);
+    AIL_BENCH_PROFILE_MEM_START(copy_avx, size);
+    AIL_STATIC_ASSERT(AIL_IS_2POWER_POS(sizeof(__m256i))); // Otherwise, fancy modulo trick below doesn't work
+    u64 n   = size / sizeof(__m256i);
+    u64 rem = size & (sizeof(__m256i) - 1);
+    __m256i *s = (__m256i*)src;
+    __m256i *d = (__m256i*)dst;
+    for (u64 i = 0; i < n; i++) {
+        _mm256_storeu_si256(d + i, _mm256_loadu_si256(s + i));
+    }
+    if (n && rem) {
+        // The last vector overlaps with already copied bytes, which saves us the byte-loop
+        _mm256_storeu_si256((__m256i*)((u8*)dst + size - sizeof(__m256i)), _mm256_loadu_si256((__m256i*)((u8*)src + size - sizeof(__m256i))));
+    } else {
+        for (u64 i = 0; i < rem; i++) {
+            ((u8*)dst)[size - i - 1] = ((u8*)src)[size - i - 1];
+        }
+    }
+    AIL_BENCH_PROFILE_END(copy_avx);
 }
 
-internal void copy_builtin(void* restrict dst, void* restrict src, u64 size)
+CPU_TARGET("avx") internal void copy_avx_backwards(void* restrict dst, void* restrict src, u64 size)
 {
-    AIL_BENCH_PROFILE_MEM_START(copy_builtin, size);
-    memcpy(dst, src, size);
-    AIL_BENCH_PROFILE_END(copy_builtin);
+    AIL_BENCH_PROFILE_MEM_START(copy_avx_backwards, size);
+    AIL_STATIC_ASSERT(AIL_IS_2POWER_POS(sizeof(__m256i))); // Otherwise, fancy modulo trick below doesn't work
+    u64 n   = size / sizeof(__m256i);
+    u64 rem = size & (sizeof(__m256i) - 1);
+    __m256i *s = (__m256i*)((u8*)src + rem);
+    __m256i *d = (__m256i*)((u8*)dst + rem);
+    for (i64 i = n - 1; i >= 0; i--) {
+        _mm256_storeu_si256(d + i, _mm256_loadu_si256(s + i));
+    }
+    if (n && rem) {
+        _mm256_storeu_si256((__m256i*)dst, _mm256_loadu_si256((__m256i*)src));
+    } else {
+        for (i64 i = rem - 1; i >= 0; i--) {
+            ((u8*)dst)[i] = ((u8*)src)[i];
+        }
+    }
+    AIL_BENCH_PROFILE_END(copy_avx_backwards);
 }
 
-internal void move_builtin(void *dst, void *src, u64 size)
+CPU_TARGET("avx") internal void copy_avx_aligned(void* restrict dst, void* restrict src, u64 size)
 {
-    AIL_BENCH_PROFILE_MEM_START(move_builtin, size);
-    memmove(dst, src, size);
-    AIL_BENCH_PROFILE_END(move_builtin);
+    AIL_BENCH_PROFILE_MEM_START(copy_avx_aligned, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    if (size < 2*sizeof(__m256i)) {
+        __movsb(d, s, size);
+    } else {
+        // Unaligned head and tail are copied with a single unaligned store each, which overlap with the aligned part
+        u64 d_pre_na = ail_alloc_align_forward((u64)d, sizeof(__m256i)) - (u64)d;
+        u64 n = (size - d_pre_na) / sizeof(__m256i);
+        __m256i *da = (__m256i*)(d + d_pre_na);
+        __m256i *sa = (__m256i*)(s + d_pre_na);
+        _mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((__m256i*)s));
+        if ((u64)sa % sizeof(__m256i) == 0) {
+            for (u64 i = 0; i < n; i++) {
+                _mm256_store_si256(da + i, _mm256_load_si256(sa + i));
+            }
+        } else {
+            for (u64 i = 0; i < n; i++) {
+                _mm256_store_si256(da + i, _mm256_loadu_si256(sa + i));
+            }
+        }
+        _mm256_storeu_si256((__m256i*)(d + size - sizeof(__m256i)), _mm256_loadu_si256((__m256i*)(s + size - sizeof(__m256i))));
+    }
+    AIL_BENCH_PROFILE_END(copy_avx_aligned);
 }
 
-typedef void (*FuncType)(void *dst, void *src, u64 size);
-typedef struct Func {
-    const char *name;
-    FuncType func;
-} Func;
-#define FUNC(func) { AIL_STRINGIFY(func), func }
-global Func copy_funcs[] = {
-    FUNC(copy_bytes),
-    FUNC(copy_bytes_wide),
-    FUNC(copy_bytes_wide_backwards),
-    FUNC(copy_quads),
-    FUNC(copy_quads_backwards),
-    FUNC(copy_quads_wide),
-    FUNC(copy_rep_movs),
-    FUNC(copy_simd_backwards),
-    FUNC(copy_simd),
-    FUNC(copy_simd_aligned),
-    FUNC(copy_builtin),
-};
-global Func move_funcs[] = {
-    FUNC(move_bytes),
-    FUNC(move_bytes_wide),
-    FUNC(move_quads),
-    FUNC(move_simd),
-    FUNC(move_simd_with_rep_movs),
-    FUNC(move_builtin),
-};
-
-static void test(TestBufferList buffers, Func func, b32 is_copy_func)
+CPU_TARGET("avx") internal void move_avx(void *dst, void *src, u64 size)
 {
-	for (u64 i = 0; i < AIL_ARRLEN(test_inputs); i++) {
-		Buffer buf = buffers[i];
-        if (!is_copy_func || !buf.overlap_size) {
-            fill_buffer(&buf);
-		    func.func(buf.dst, buf.src, buf.size);
-            if (!test_buffer(buf)) {
-		    	printf("\033[31m%s failed test for buffer-size %zu (with %zu %s-overlapped bytes) :(\033[0m\n", func.name, test_inputs[i].size, test_inputs[i].overlap_size, test_inputs[i].overlap_left ? "left" : "right");
-		    	return;
-		    }
+    AIL_BENCH_PROFILE_MEM_START(move_avx, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    u64 n   = size / sizeof(__m256i);
+    u64 rem = size & (sizeof(__m256i) - 1);
+    if (!n) {
+        move_bytes(d, s, size);
+    } else if (s < d && d < s + size) {
+        // Copying from back to front overwrites the first vector of src before it is read, so it is loaded up front
+        __m256i head = _mm256_loadu_si256((__m256i*)s);
+        __m256i *sv  = (__m256i*)(s + rem);
+        __m256i *dv  = (__m256i*)(d + rem);
+        for (i64 i = n - 1; i >= 0; i--) {
+            _mm256_storeu_si256(dv + i, _mm256_loadu_si256(sv + i));
         }
-	}
-	printf("\033[32m%s passed all tests :)\033[0m\n", func.name);
+        _mm256_storeu_si256((__m256i*)d, head);
+    } else {
+        // Same as above, but the last vector would be overwritten when copying front to back
+        __m256i tail = _mm256_loadu_si256((__m256i*)(s + size - sizeof(__m256i)));
+        __m256i *sv  = (__m256i*)s;
+        __m256i *dv  = (__m256i*)d;
+        for (u64 i = 0; i < n; i++) {
+            _mm256_storeu_si256(dv + i, _mm256_loadu_si256(sv + i));
+        }
+        _mm256_storeu_si256((__m256i*)(d + size - sizeof(__m256i)), tail);
+    }
+    AIL_BENCH_PROFILE_END(move_avx);
 }
 
-void get_printable_mem_size(char *str, u64 mem_size)
+CPU_TARGET("avx512f") internal void copy_avx512(void* restrict dst, void* restrict src, u64 size)
 {
-	if      (mem_size >= AIL_GB(1)) snprintf(str, 8, "%zuGB", mem_size/AIL_GB(1));
-	else if (mem_size >= AIL_MB(1)) snprintf(str, 8, "%zuMB", mem_size/AIL_MB(1));
-	else if (mem_size >= AIL_KB(1)) snprintf(str, 8, "%zuKB", mem_size/AIL_KB(1));
-	else                            snprintf(str, 8, "%zuB", mem_size);
+    AIL_BENCH_PROFILE_MEM_START(copy_avx512, size);
+    AIL_STATIC_ASSERT(AIL_IS_2POWER_POS(sizeof(__m512i))); // Otherwise, fancy modulo trick below doesn't work
+    u64 n   = size / sizeof(__m512i);
+    u64 rem = size & (sizeof(__m512i) - 1);
+    __m512i *s = (__m512i*)src;
+    __m512i *d = (__m512i*)dst;
+    for (u64 i = 0; i < n; i++) {
+        _mm512_storeu_si512(d + i, _mm512_loadu_si512(s + i));
+    }
+    if (n && rem) {
+        _mm512_storeu_si512((u8*)dst + size - sizeof(__m512i), _mm512_loadu_si512((u8*)src + size - sizeof(__m512i)));
+    } else {
+        for (u64 i = 0; i < rem; i++) {
+            ((u8*)dst)[size - i - 1] = ((u8*)src)[size - i - 1];
+        }
+    }
+    AIL_BENCH_PROFILE_END(copy_avx512);
 }
 
-int main(void)
+CPU_TARGET("avx512f") internal void copy_avx512_backwards(void* restrict dst, void* restrict src, u64 size)
 {
-    ail_bench_init();
-    srand((u32)time(NULL));
-    u64 t0 = ail_bench_cpu_timer();
-#ifdef TEST
-    TestBufferList buffers;
-    for (u64 i = 0; i < AIL_ARRLEN(test_inputs); i++) {
-        Input in   = test_inputs[i];
-        buffers[i] = get_buffer(in.size, in.overlap_size, in.overlap_left);
-    }
-    for (u64 i = 0; i < AIL_ARRLEN(copy_funcs); i++) {
-        test(buffers, copy_funcs[i], true);
+    AIL_BENCH_PROFILE_MEM_START(copy_avx512_backwards, size);
+    AIL_STATIC_ASSERT(AIL_IS_2POWER_POS(sizeof(__m512i))); // Otherwise, fancy modulo trick below doesn't work
+    u64 n   = size / sizeof(__m512i);
+    u64 rem = size & (sizeof(__m512i) - 1);
+    __m512i *s = (__m512i*)((u8*)src + rem);
+    __m512i *d = (__m512i*)((u8*)dst + rem);
+    for (i64 i = n - 1; i >= 0; i--) {
+        _mm512_storeu_si512(d + i, _mm512_loadu_si512(s + i));
     }
-    for (u64 i = 0; i < AIL_ARRLEN(move_funcs); i++) {
-        test(buffers, move_funcs[i], false);
+    if (n && rem) {
+        _mm512_storeu_si512(dst, _mm512_loadu_si512(src));
+    } else {
+        for (i64 i = rem - 1; i >= 0; i--) {
+            ((u8*)dst)[i] = ((u8*)src)[i];
+        }
     }
-	for (u64 i = 0; i < AIL_ARRLEN(test_inputs); i++) {
-		free_buffer(buffers[i]);
-	}
-#endif
+    AIL_BENCH_PROFILE_END(copy_avx512_backwards);
+}
 
-#ifdef BENCH
-    ail_bench_clear_anchors();
-#ifdef BENCH_PER_BUF_SIZE
-    for (u64 i = 0, size = MIN_BUFFER_SIZE, overlap = 4; size <= MAX_BUFFER_SIZE; size <<= 2, overlap <<= 1, i++) {
-        Buffer buffers[] = {
-            get_buffer(size, 0, 0),
-            get_buffer(size, overlap, i & 1),
-            get_buffer(size, size - overlap, !(i & 1)),
-        };
-        char mem_size[12];
-        get_printable_mem_size(mem_size, size);
-        printf("Benchmark Results for Copying %s of memory\n", mem_size);
-        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) {
-            Buffer buf = buffers[j];
-            if (!buf.overlap_size) {
-                fill_buffer(&buf);
-                ail_bench_begin_profile();
-                for (u64 idx = 0; idx < AIL_ARRLEN(copy_funcs); idx++) {
-                    for (u64 k = 0; k < ITER_COUNT; k++) {
-                        copy_funcs[idx].func(buf.dst, buf.src, buf.size);
-                    }
-                }
-                ail_bench_end_and_print_profile(1, true);
+CPU_TARGET("avx512f") internal void copy_avx512_aligned(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_avx512_aligned, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    if (size < 2*sizeof(__m512i)) {
+        __movsb(d, s, size);
+    } else {
+        u64 d_pre_na = ail_alloc_align_forward((u64)d, sizeof(__m512i)) - (u64)d;
+        u64 n = (size - d_pre_na) / sizeof(__m512i);
+        __m512i *da = (__m512i*)(d + d_pre_na);
+        __m512i *sa = (__m512i*)(s + d_pre_na);
+        _mm512_storeu_si512(d, _mm512_loadu_si512(s));
+        if ((u64)sa % sizeof(__m512i) == 0) {
+            for (u64 i = 0; i < n; i++) {
+                _mm512_store_si512(da + i, _mm512_load_si512(sa + i));
             }
-        }
-        printf("-----------\n");
-        printf("Benchmark Results for Moving %s of memory\n", mem_size);
-        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) {
-            Buffer buf = buffers[j];
-            fill_buffer(&buf);
-            printf("With %zu overlapped bytes:\n", buf.overlap_size);
-            ail_bench_begin_profile();
-            for (u64 idx = 0; idx < AIL_ARRLEN(move_funcs); idx++) {
-                for (u64 k = 0; k < ITER_COUNT; k++) {
-                    move_funcs[idx].func(buf.dst, buf.src, buf.size);
-                }
+        } else {
+            for (u64 i = 0; i < n; i++) {
+                _mm512_store_si512(da + i, _mm512_loadu_si512(sa + i));
             }
-            ail_bench_end_and_print_profile(1, true);
         }
-        printf("-----------\n");
-        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) free_buffer(buffers[j]);
+        _mm512_storeu_si512(d + size - sizeof(__m512i), _mm512_loadu_si512(s + size - sizeof(__m512i)));
     }
-#else
-    char mem_min_size[12], mem_max_size[12];
-    get_printable_mem_size(mem_min_size, MIN_BUFFER_SIZE);
-    get_printable_mem_size(mem_max_size, MAX_BUFFER_SIZE);
-    printf("Benchmark Results for Copying %s to %s memory\n", mem_min_size, mem_max_size);
-    ail_bench_begin_profile();
-    for (u64 size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size <<= 2) {
-        Buffer buf = get_buffer(size, 0, 0);
-        fill_buffer(&buf);
-        for (u64 idx = 0; idx < AIL_ARRLEN(copy_funcs); idx++) {
-            for (u64 k = 0; k < ITER_COUNT; k++) {
-                copy_funcs[idx].func(buf.dst, buf.src, buf.size);
-            }
+    AIL_BENCH_PROFILE_END(copy_avx512_aligned);
+}
+
+CPU_TARGET("avx512f") internal void move_avx512(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(move_avx512, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    u64 n   = size / sizeof(__m512i);
+    u64 rem = size & (sizeof(__m512i) - 1);
+    if (!n) {
+        move_bytes(d, s, size);
+    } else if (s < d && d < s + size) {
+        __m512i head = _mm512_loadu_si512(s);
+        __m512i *sv  = (__m512i*)(s + rem);
+        __m512i *dv  = (__m512i*)(d + rem);
+        for (i64 i = n - 1; i >= 0; i--) {
+            _mm512_storeu_si512(dv + i, _mm512_loadu_si512(sv + i));
         }
-        free_buffer(buf);
+        _mm512_storeu_si512(d, head);
+    } else {
+        __m512i tail = _mm512_loadu_si512(s + size - sizeof(__m512i));
+        __m512i *sv  = (__m512i*)s;
+        __m512i *dv  = (__m512i*)d;
+        for (u64 i = 0; i < n; i++) {
+            _mm512_storeu_si512(dv + i, _mm512_loadu_si512(sv + i));
+        }
+        _mm512_storeu_si512(d + size - sizeof(__m512i), tail);
     }
-    ail_bench_end_and_print_profile(1, true);
-    printf("-----------\n");
-    printf("Benchmark Results for Moving %s to %s of variously overlapped memory\n", mem_min_size, mem_max_size);
-    ail_bench_begin_profile();
-    for (u64 i = 0, size = MIN_BUFFER_SIZE, overlap = 4; size <= MAX_BUFFER_SIZE; size <<= 2, overlap <<= 1, i++) {
-        Buffer buffers[] = {
-            get_buffer(size, 0, 0),
-            get_buffer(size, overlap, i & 1),
-            get_buffer(size, size - overlap, !(i & 1)),
-        };
-        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) {
-            Buffer buf = buffers[j];
-            fill_buffer(&buf);
-            for (u64 k = 0; k < ITER_COUNT; k++) {
-                for (u64 idx = 0; idx < AIL_ARRLEN(move_funcs); idx++) {
-                    move_funcs[idx].func(buf.dst, buf.src, buf.size);
-                }
-            }
+    AIL_BENCH_PROFILE_END(move_avx512);
+}
+
+// The prefetching copies move one cache line per iteration and prefetch the line of src that lies the tuned distance ahead in
+// the direction of their stream, which is looked up per size class (see util/prefetch.h). The forward and backward copies are
+// the loops of copy_simd and copy_simd_backwards, the two-ended copy alternates between a line at the front and one at the back
+// and meets in the middle, which is the access pattern of reversing a buffer in place.
+typedef enum Prefetch_Stream {
+    PREFETCH_FORWARD,
+    PREFETCH_BACKWARD,
+    PREFETCH_TWO_ENDED,
+    PREFETCH_STREAM_COUNT,
+} Prefetch_Stream;
+global const char *prefetch_stream_names[PREFETCH_STREAM_COUNT] = { "forward", "backward", "two_ended" };
+global Prefetch_Table prefetch_table;
+
+#define COPY_LINE(T, load, store, d, s) for (u32 k = 0; k < 64/sizeof(T); k++) store((T*)(d) + k, load((T*)(s) + k))
+
+#define COPY_PREFETCH(name, T, load, store) \
+    internal void name(void* restrict dst, void* restrict src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(name, size); \
+        Prefetch_Setting p = prefetch_get(&prefetch_table, PREFETCH_FORWARD, size); \
+        u8 *d = (u8*)dst; \
+        u8 *s = (u8*)src; \
+        u64 n = size / 64; \
+        for (u64 i = 0; i < n; i++) { \
+            if (p.distance) PREFETCH(s + i*64 + p.distance, p.hint); \
+            COPY_LINE(T, load, store, d + i*64, s + i*64); \
+        } \
+        for (u64 i = n*64; i < size; i++) d[i] = s[i]; \
+        AIL_BENCH_PROFILE_END(name); \
+    }
+
+#define COPY_BACKWARDS_PREFETCH(name, T, load, store) \
+    internal void name(void* restrict dst, void* restrict src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(name, size); \
+        Prefetch_Setting p = prefetch_get(&prefetch_table, PREFETCH_BACKWARD, size); \
+        u64 rem = size % 64; \
+        u8 *d = (u8*)dst + rem; \
+        u8 *s = (u8*)src + rem; \
+        for (u64 i = size / 64; i-- > 0;) { \
+            if (p.distance) PREFETCH((u64)(s + i*64) - p.distance, p.hint); \
+            COPY_LINE(T, load, store, d + i*64, s + i*64); \
+        } \
+        for (i64 i = rem - 1; i >= 0; i--) ((u8*)dst)[i] = ((u8*)src)[i]; \
+        AIL_BENCH_PROFILE_END(name); \
+    }
+
+#define COPY_TWO_ENDED_PREFETCH(name, T, load, store) \
+    internal void name(void* restrict dst, void* restrict src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(name, size); \
+        Prefetch_Setting p = prefetch_get(&prefetch_table, PREFETCH_TWO_ENDED, size); \
+        u8 *d = (u8*)dst; \
+        u8 *s = (u8*)src; \
+        u64 lo = 0, hi = size / 64; \
+        while (lo < hi) { \
+            if (p.distance) PREFETCH(s + lo*64 + p.distance, p.hint); \
+            COPY_LINE(T, load, store, d + lo*64, s + lo*64); \
+            if (++lo == hi) break; \
+            hi--; \
+            if (p.distance) PREFETCH((u64)(s + hi*64) - p.distance, p.hint); \
+            COPY_LINE(T, load, store, d + hi*64, s + hi*64); \
+        } \
+        for (u64 i = size - size % 64; i < size; i++) d[i] = s[i]; \
+        AIL_BENCH_PROFILE_END(name); \
+    }
+
+COPY_PREFETCH(copy_simd_prefetch,                             __m128i, _mm_loadu_si128,    _mm_storeu_si128)
+COPY_BACKWARDS_PREFETCH(copy_simd_backwards_prefetch,         __m128i, _mm_loadu_si128,    _mm_storeu_si128)
+COPY_TWO_ENDED_PREFETCH(copy_simd_two_ended_prefetch,         __m128i, _mm_loadu_si128,    _mm_storeu_si128)
+CPU_TARGET("avx") COPY_PREFETCH(copy_avx_prefetch,                     __m256i, _mm256_loadu_si256, _mm256_storeu_si256)
+CPU_TARGET("avx") COPY_BACKWARDS_PREFETCH(copy_avx_backwards_prefetch, __m256i, _mm256_loadu_si256, _mm256_storeu_si256)
+CPU_TARGET("avx") COPY_TWO_ENDED_PREFETCH(copy_avx_two_ended_prefetch, __m256i, _mm256_loadu_si256, _mm256_storeu_si256)
+
+// 8-byte accesses go through memcpy, which compiles to a single mov but is valid for any alignment and type of the buffer
+internal inline u64 load_u64(const u8 *p)
+{
+    u64 x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+internal inline void store_u64(u8 *p, u64 x)
+{
+    memcpy(p, &x, sizeof(x));
+}
+
+#ifdef GENERATED_KERNELS
+// Generated kernels cover the cross product of element width (1/8/16/32/64 bytes), unroll factor (1/2/4/8),
+// direction (fwd/bwd) and alignment strategy:
+// - unaligned:  unaligned loads and stores throughout
+// - align_dst:  single bytes are copied until dst is aligned to the element width, then the stores are aligned
+// - align_both: like align_dst, but the loads are aligned as well if src ends up aligned by that (otherwise like align_dst)
+// Aligning a single byte is a no-op, so the 1-byte kernels only exist unaligned. The copies are named
+// copy_gen_<width>x<unroll>_<direction>_<alignment>, the moves move_gen_<width>x<unroll>_<alignment> pick the direction
+// from the overlap at runtime. All loads of a block are issued before its stores, so the forward copies are correct for
+// dst < src and the backward copies for dst > src, which is why the copies don't take restrict pointers.
+#define GEN_ALIGN_unaligned  0
+#define GEN_ALIGN_align_dst  1
+#define GEN_ALIGN_align_both 2
+
+#define GEN_T_1  u8
+#define GEN_T_8  u64
+#define GEN_T_16 __m128i
+#define GEN_T_32 __m256i
+#define GEN_T_64 __m512i
+#define GEN_LOADU_1(p)     (*(u8*)(p))
+#define GEN_LOADA_1(p)     (*(u8*)(p))
+#define GEN_STOREU_1(p, v) (*(u8*)(p) = (v))
+#define GEN_STOREA_1(p, v) (*(u8*)(p) = (v))
+#define GEN_LOADU_8(p)     load_u64((const u8*)(p))
+#define GEN_LOADA_8(p)     load_u64((const u8*)(p))
+#define GEN_STOREU_8(p, v) store_u64((u8*)(p), (v))
+#define GEN_STOREA_8(p, v) store_u64((u8*)(p), (v))
+#define GEN_LOADU_16(p)     _mm_loadu_si128((__m128i*)(p))
+#define GEN_LOADA_16(p)     _mm_load_si128((__m128i*)(p))
+#define GEN_STOREU_16(p, v) _mm_storeu_si128((__m128i*)(p), (v))
+#define GEN_STOREA_16(p, v) _mm_store_si128((__m128i*)(p), (v))
+#define GEN_LOADU_32(p)     _mm256_loadu_si256((__m256i*)(p))
+#define GEN_LOADA_32(p)     _mm256_load_si256((__m256i*)(p))
+#define GEN_STOREU_32(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+#define GEN_STOREA_32(p, v) _mm256_store_si256((__m256i*)(p), (v))
+#define GEN_LOADU_64(p)     _mm512_loadu_si512((void*)(p))
+#define GEN_LOADA_64(p)     _mm512_load_si512((void*)(p))
+#define GEN_STOREU_64(p, v) _mm512_storeu_si512((void*)(p), (v))
+#define GEN_STOREA_64(p, v) _mm512_store_si512((void*)(p), (v))
+#define GEN_TARGET_1
+#define GEN_TARGET_8
+#define GEN_TARGET_16
+#define GEN_TARGET_32 CPU_TARGET("avx")
+#define GEN_TARGET_64 CPU_TARGET("avx512f")
+#define GEN_FEATURES_1  0
+#define GEN_FEATURES_8  0
+#define GEN_FEATURES_16 0
+#define GEN_FEATURES_32 CPU_AVX
+#define GEN_FEATURES_64 CPU_AVX512F
+
+#define GEN_BLOCKS_fwd(T, load, store, U) \
+        for (u64 k_ = 0; k_ < n_; k_++, i_ += (U)*sizeof(T)) {                            \
+            T v_[U];                                                                    \
+            for (u32 j_ = 0; j_ < (U); j_++) v_[j_] = load(s_ + i_ + j_*sizeof(T));      \
+            for (u32 j_ = 0; j_ < (U); j_++) store(d_ + i_ + j_*sizeof(T), v_[j_]);      \
         }
-        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) free_buffer(buffers[j]);
+#define GEN_BLOCKS_bwd(T, load, store, U) \
+        for (u64 k_ = 0; k_ < n_; k_++) {                                                \
+            e_ -= (U)*sizeof(T);                                                        \
+            T v_[U];                                                                    \
+            for (u32 j_ = 0; j_ < (U); j_++) v_[j_] = load(s_ + e_ + j_*sizeof(T));      \
+            for (u32 j_ = 0; j_ < (U); j_++) store(d_ + e_ + j_*sizeof(T), v_[j_]);      \
+        }
+
+#define GEN_COPY_fwd(T, loadu, loada, storeu, storea, U, align) do { \
+        u8 *d_ = (u8*)dst, *s_ = (u8*)src;                                                      \
+        u64 i_ = 0;                                                                             \
+        if ((align) != GEN_ALIGN_unaligned) {                                                   \
+            u64 head_ = AIL_MIN(size, (0 - (u64)d_) & (sizeof(T) - 1));                         \
+            for (; i_ < head_; i_++) d_[i_] = s_[i_];                                           \
+        }                                                                                       \
+        u64 n_ = (size - i_) / ((U)*sizeof(T));                                                 \
+        if ((align) == GEN_ALIGN_align_both && !((u64)(s_ + i_) & (sizeof(T) - 1))) {           \
+            GEN_BLOCKS_fwd(T, loada, storea, U)                                                 \
+        } else if ((align) != GEN_ALIGN_unaligned) {                                            \
+            GEN_BLOCKS_fwd(T, loadu, storea, U)                                                 \
+        } else {                                                                                \
+            GEN_BLOCKS_fwd(T, loadu, storeu, U)                                                 \
+        }                                                                                       \
+        for (; i_ + sizeof(T) <= size; i_ += sizeof(T)) storeu(d_ + i_, loadu(s_ + i_));        \
+        for (; i_ < size; i_++) d_[i_] = s_[i_];                                                \
+    } while (0)
+
+#define GEN_COPY_bwd(T, loadu, loada, storeu, storea, U, align) do { \
+        u8 *d_ = (u8*)dst, *s_ = (u8*)src;                                                      \
+        u64 e_ = size;                                                                          \
+        if ((align) != GEN_ALIGN_unaligned) {                                                   \
+            u64 tail_ = AIL_MIN(size, (u64)(d_ + size) & (sizeof(T) - 1));                      \
+            for (; e_ > size - tail_; e_--) d_[e_ - 1] = s_[e_ - 1];                            \
+        }                                                                                       \
+        u64 n_ = e_ / ((U)*sizeof(T));                                                          \
+        if ((align) == GEN_ALIGN_align_both && !((u64)(s_ + e_) & (sizeof(T) - 1))) {           \
+            GEN_BLOCKS_bwd(T, loada, storea, U)                                                 \
+        } else if ((align) != GEN_ALIGN_unaligned) {                                            \
+            GEN_BLOCKS_bwd(T, loadu, storea, U)                                                 \
+        } else {                                                                                \
+            GEN_BLOCKS_bwd(T, loadu, storeu, U)                                                 \
+        }                                                                                       \
+        for (; e_ >= sizeof(T); e_ -= sizeof(T)) storeu(d_ + e_ - sizeof(T), loadu(s_ + e_ - sizeof(T))); \
+        for (; e_ > 0; e_--) d_[e_ - 1] = s_[e_ - 1];                                           \
+    } while (0)
+
+#define GEN_COPY_NAME(W, U, dir, align) copy_gen_##W##x##U##_##dir##_##align
+#define GEN_MOVE_NAME(W, U, align)      move_gen_##W##x##U##_##align
+
+// The name is passed on separately, since the profiling macros paste it and wouldn't expand GEN_COPY_NAME themselves
+#define GEN_COPY_KERNEL(W, U, dir, align) GEN_COPY_KERNEL_(GEN_COPY_NAME(W, U, dir, align), W, U, dir, align)
+#define GEN_COPY_KERNEL_(name, W, U, dir, align) \
+    GEN_TARGET_##W internal void name(void *dst, void *src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(name, size); \
+        GEN_COPY_##dir(GEN_T_##W, GEN_LOADU_##W, GEN_LOADA_##W, GEN_STOREU_##W, GEN_STOREA_##W, U, GEN_ALIGN_##align); \
+        AIL_BENCH_PROFILE_END(name); \
+    }
+#define GEN_MOVE_KERNEL(W, U, align) GEN_MOVE_KERNEL_(GEN_MOVE_NAME(W, U, align), W, U, align)
+#define GEN_MOVE_KERNEL_(name, W, U, align) \
+    internal void name(void *dst, void *src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(name, size); \
+        if ((u8*)dst > (u8*)src && (u8*)dst < (u8*)src + size) GEN_COPY_NAME(W, U, bwd, align)(dst, src, size); \
+        else                                                   GEN_COPY_NAME(W, U, fwd, align)(dst, src, size); \
+        AIL_BENCH_PROFILE_END(name); \
+    }
+
+// X(width, unroll, ...) for every unroll factor
+#define GEN_UNROLLS(X, W, ...) X(W, 1, __VA_ARGS__) X(W, 2, __VA_ARGS__) X(W, 4, __VA_ARGS__) X(W, 8, __VA_ARGS__)
+#define GEN_COPIES_OF_WIDTH(X, W) \
+    GEN_UNROLLS(X, W, fwd, unaligned) GEN_UNROLLS(X, W, fwd, align_dst) GEN_UNROLLS(X, W, fwd, align_both) \
+    GEN_UNROLLS(X, W, bwd, unaligned) GEN_UNROLLS(X, W, bwd, align_dst) GEN_UNROLLS(X, W, bwd, align_both)
+#define GEN_MOVES_OF_WIDTH(X, W) GEN_UNROLLS(X, W, unaligned) GEN_UNROLLS(X, W, align_dst) GEN_UNROLLS(X, W, align_both)
+// X(width, unroll, direction, alignment) for every generated copy
+#define GEN_COPIES(X) \
+    GEN_UNROLLS(X, 1, fwd, unaligned) GEN_UNROLLS(X, 1, bwd, unaligned) \
+    GEN_COPIES_OF_WIDTH(X, 8) GEN_COPIES_OF_WIDTH(X, 16) GEN_COPIES_OF_WIDTH(X, 32) GEN_COPIES_OF_WIDTH(X, 64)
+// X(width, unroll, alignment) for every generated move
+#define GEN_MOVES(X) \
+    GEN_UNROLLS(X, 1, unaligned) \
+    GEN_MOVES_OF_WIDTH(X, 8) GEN_MOVES_OF_WIDTH(X, 16) GEN_MOVES_OF_WIDTH(X, 32) GEN_MOVES_OF_WIDTH(X, 64)
+
+GEN_COPIES(GEN_COPY_KERNEL)
+GEN_MOVES(GEN_MOVE_KERNEL)
+
+#define GEN_COPY_FUNC(W, U, dir, align) FUNC_REQUIRES(GEN_COPY_NAME(W, U, dir, align), GEN_FEATURES_##W),
+#define GEN_MOVE_FUNC(W, U, align)      FUNC_REQUIRES(GEN_MOVE_NAME(W, U, align), GEN_FEATURES_##W),
+#define GENERATED_COPY_FUNCS GEN_COPIES(GEN_COPY_FUNC)
+#define GENERATED_MOVE_FUNCS GEN_MOVES(GEN_MOVE_FUNC)
+#else
+#define GENERATED_COPY_FUNCS
+#define GENERATED_MOVE_FUNCS
+#endif
+
+// Copies up to SMALL_COPY_MAX_SIZE bytes without any loop: Each size class is covered by (at most) two blocks of
+// the largest power of two not greater than size, one at the start and one at the end of the region, which overlap in the middle.
+// All loads are done before the first store, so the same code also works for overlapping regions.
+#define SMALL_COPY_MAX_SIZE 256
+#define COPY_SMALL_BLOCKS(T, load, store, d, s, size, count) do { \
+        T a_[count], b_[count];                                                                                  \
+        for (u32 i_ = 0; i_ < (count); i_++) a_[i_] = load((T*)(s) + i_);                                         \
+        for (u32 i_ = 0; i_ < (count); i_++) b_[i_] = load((T*)((s) + (size) - (count)*sizeof(T)) + i_);          \
+        for (u32 i_ = 0; i_ < (count); i_++) store((T*)(d) + i_, a_[i_]);                                         \
+        for (u32 i_ = 0; i_ < (count); i_++) store((T*)((d) + (size) - (count)*sizeof(T)) + i_, b_[i_]);          \
+    } while (0)
+#define COPY_SMALL_SCALAR(T, d, s, size) do { \
+        T a_, b_;                                    \
+        memcpy(&a_, (s), sizeof(T));                 \
+        memcpy(&b_, (s) + (size) - sizeof(T), sizeof(T)); \
+        memcpy((d), &a_, sizeof(T));                 \
+        memcpy((d) + (size) - sizeof(T), &b_, sizeof(T)); \
+    } while (0)
+
+internal inline void copy_small_sse2_inline(u8 *d, u8 *s, u64 size)
+{
+    switch (size_class(size)) {
+        case 1: if (size) *d = *s;                                             break; // 0..1
+        case 2: COPY_SMALL_SCALAR(u16, d, s, size);                            break; // 2..3
+        case 3: COPY_SMALL_SCALAR(u32, d, s, size);                            break; // 4..7
+        case 4: COPY_SMALL_SCALAR(u64, d, s, size);                            break; // 8..15
+        case 5: COPY_SMALL_BLOCKS(__m128i, _mm_loadu_si128, _mm_storeu_si128, d, s, size, 1); break; // 16..31
+        case 6: COPY_SMALL_BLOCKS(__m128i, _mm_loadu_si128, _mm_storeu_si128, d, s, size, 2); break; // 32..63
+        case 7: COPY_SMALL_BLOCKS(__m128i, _mm_loadu_si128, _mm_storeu_si128, d, s, size, 4); break; // 64..127
+        default: AIL_ASSERT(size <= SMALL_COPY_MAX_SIZE);
+                COPY_SMALL_BLOCKS(__m128i, _mm_loadu_si128, _mm_storeu_si128, d, s, size, 8); break; // 128..256
+    }
+}
+
+CPU_TARGET("avx") internal inline void copy_small_avx_inline(u8 *d, u8 *s, u64 size)
+{
+    switch (size_class(size)) {
+        case 1: if (size) *d = *s;                                             break; // 0..1
+        case 2: COPY_SMALL_SCALAR(u16, d, s, size);                            break; // 2..3
+        case 3: COPY_SMALL_SCALAR(u32, d, s, size);                            break; // 4..7
+        case 4: COPY_SMALL_SCALAR(u64, d, s, size);                            break; // 8..15
+        case 5: COPY_SMALL_BLOCKS(__m128i, _mm_loadu_si128, _mm_storeu_si128, d, s, size, 1);       break; // 16..31
+        case 6: COPY_SMALL_BLOCKS(__m256i, _mm256_loadu_si256, _mm256_storeu_si256, d, s, size, 1); break; // 32..63
+        case 7: COPY_SMALL_BLOCKS(__m256i, _mm256_loadu_si256, _mm256_storeu_si256, d, s, size, 2); break; // 64..127
+        default: AIL_ASSERT(size <= SMALL_COPY_MAX_SIZE);
+                COPY_SMALL_BLOCKS(__m256i, _mm256_loadu_si256, _mm256_storeu_si256, d, s, size, 4); break; // 128..256
+    }
+}
+
+internal void copy_small(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_small, size);
+    if (size <= SMALL_COPY_MAX_SIZE) copy_small_sse2_inline((u8*)dst, (u8*)src, size);
+    else                             copy_simd(dst, src, size);
+    AIL_BENCH_PROFILE_END(copy_small);
+}
+
+internal void move_small(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(move_small, size);
+    if (size <= SMALL_COPY_MAX_SIZE) copy_small_sse2_inline((u8*)dst, (u8*)src, size);
+    else                             move_simd(dst, src, size);
+    AIL_BENCH_PROFILE_END(move_small);
+}
+
+CPU_TARGET("avx") internal void copy_small_avx(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_small_avx, size);
+    if (size <= SMALL_COPY_MAX_SIZE) copy_small_avx_inline((u8*)dst, (u8*)src, size);
+    else                             copy_avx(dst, src, size);
+    AIL_BENCH_PROFILE_END(copy_small_avx);
+}
+
+CPU_TARGET("avx") internal void move_small_avx(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(move_small_avx, size);
+    if (size <= SMALL_COPY_MAX_SIZE) copy_small_avx_inline((u8*)dst, (u8*)src, size);
+    else                             move_avx(dst, src, size);
+    AIL_BENCH_PROFILE_END(move_small_avx);
+}
+
+// Batched copies of many small independent regions, i.e. the fields of messages into an output frame
+// Each descriptor is copied by the fast path of its size bucket without going through a call, while the regions of the
+// descriptor COPY_BATCH_PREFETCH places ahead are prefetched, so that their cache misses overlap with the current copies
+typedef struct Copy_Desc {
+    void *dst;
+    void *src;
+    u64   size;
+} Copy_Desc;
+
+#define COPY_BATCH_MEDIUM_MAX AIL_KB(4) // Larger descriptors are copied by memcpy, which is worth its call overhead at that size
+global u64 copy_batch_prefetch = COPY_BATCH_PREFETCH;
+
+#define COPY_BLOCK4(T, load, store, d, s) do { \
+        T a_ = load((T*)(s) + 0), b_ = load((T*)(s) + 1), c_ = load((T*)(s) + 2), e_ = load((T*)(s) + 3); \
+        store((T*)(d) + 0, a_); store((T*)(d) + 1, b_); store((T*)(d) + 2, c_); store((T*)(d) + 3, e_);      \
+    } while (0)
+
+// Sizes above SMALL_COPY_MAX_SIZE are copied in blocks of 4 vectors, the last of which ends at the end of the region and overlaps the previous one
+#define COPY_BATCH(name, small, T, load, store) \
+    internal void name(Copy_Desc *descs, u64 count, u64 prefetch) \
+    { \
+        for (u64 i = 0; i < count; i++) { \
+            if (prefetch && i + prefetch < count) { \
+                Copy_Desc *p = &descs[i + prefetch]; \
+                _mm_prefetch((const char*)p->src, _MM_HINT_T0); \
+                _mm_prefetch((const char*)p->src + p->size - 1, _MM_HINT_T0); \
+                _mm_prefetch((const char*)p->dst, _MM_HINT_T0); \
+            } \
+            u8 *d = descs[i].dst; \
+            u8 *s = descs[i].src; \
+            u64 size = descs[i].size; \
+            if (size <= SMALL_COPY_MAX_SIZE) { \
+                small(d, s, size); \
+            } else if (size <= COPY_BATCH_MEDIUM_MAX) { \
+                u64 last = size - 4*sizeof(T); \
+                for (u64 j = 0; j < last; j += 4*sizeof(T)) COPY_BLOCK4(T, load, store, d + j, s + j); \
+                COPY_BLOCK4(T, load, store, d + last, s + last); \
+            } else { \
+                memcpy(d, s, size); \
+            } \
+        } \
+    }
+
+COPY_BATCH(copy_batch_sse2_inline, copy_small_sse2_inline, __m128i, _mm_loadu_si128, _mm_storeu_si128)
+CPU_TARGET("avx") COPY_BATCH(copy_batch_avx_inline, copy_small_avx_inline, __m256i, _mm256_loadu_si256, _mm256_storeu_si256)
+
+// Copies each region of the descriptors, the regions must not overlap each other
+internal void copy_batch(Copy_Desc *descs, u64 count)
+{
+    AIL_BENCH_PROFILE_START(copy_batch);
+    copy_batch_sse2_inline(descs, count, copy_batch_prefetch);
+    AIL_BENCH_PROFILE_END(copy_batch);
+}
+
+CPU_TARGET("avx") internal void copy_batch_avx(Copy_Desc *descs, u64 count)
+{
+    AIL_BENCH_PROFILE_START(copy_batch_avx);
+    copy_batch_avx_inline(descs, count, copy_batch_prefetch);
+    AIL_BENCH_PROFILE_END(copy_batch_avx);
+}
+
+// Copies that checksum the data on the fly, so that it only goes through the caches once instead of a second time for a separate checksum pass
+// The checksum is returned, CRC32C in the lower 32 bits
+typedef u64 (*ChecksumFuncType)(void *dst, void *src, u64 size);
+
+// The crc32 instruction has a latency of 3 cycles, but can start one per cycle, so three independent streams over neighbouring blocks
+// are computed at once. Their CRCs are combined by shifting the first one over the length of a block (multiplying it by x^(8*CRC32C_BLOCK)
+// modulo the polynomial) and xoring the next one, which is done with a lookup table per byte of the CRC.
+#define CRC32C_POLY  0x82F63B78u // Reflected Castagnoli polynomial
+#define CRC32C_BLOCK AIL_KB(1)
+global u32 crc32c_shift_table[4][256];
+
+// Multiplies two polynomials modulo CRC32C_POLY, in the reflected bit order of the CRC (bit 31 is x^0)
+internal u32 crc32c_mul(u32 a, u32 b)
+{
+    u32 m = 1u << 31, p = 0;
+    for (; m; m >>= 1) {
+        if (a & m) p ^= b;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+internal void init_crc32c(void)
+{
+    // x^(8*CRC32C_BLOCK) by square-and-multiply
+    u32 x_pow = 1u << 31, sq = 1u << 30;
+    for (u64 n = 8*CRC32C_BLOCK; n; n >>= 1) {
+        if (n & 1) x_pow = crc32c_mul(x_pow, sq);
+        sq = crc32c_mul(sq, sq);
+    }
+    for (u32 k = 0; k < 4; k++) {
+        for (u32 b = 0; b < 256; b++) crc32c_shift_table[k][b] = crc32c_mul(x_pow, b << (8*k));
+    }
+}
+
+// Returns the state of the CRC after CRC32C_BLOCK zero bytes
+internal inline u64 crc32c_shift(u64 crc)
+{
+    return crc32c_shift_table[0][crc & 0xff] ^ crc32c_shift_table[1][(crc >> 8) & 0xff] ^
+           crc32c_shift_table[2][(crc >> 16) & 0xff] ^ crc32c_shift_table[3][(crc >> 24) & 0xff];
+}
+
+// The CRCs read src again with 8-byte loads rather than extracting the lanes of the vectors just loaded:
+// the reloads hit L1 and are cheaper than the extracts, which measured about half as fast with avx512.
+// With `copy` set to false, the same loop only computes the checksum of src (dst is ignored)
+#define COPY_CRC32C(name, T, load, store, copy) \
+    internal u64 name(void* restrict dst, void* restrict src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(name, size); \
+        u8 *d = (u8*)dst; \
+        u8 *s = (u8*)src; \
+        u64 crc0 = 0xffffffff, i = 0; \
+        for (; i + 3*CRC32C_BLOCK <= size; i += 3*CRC32C_BLOCK) { \
+            u64 crc1 = 0, crc2 = 0; \
+            for (u64 j = i; j < i + CRC32C_BLOCK; j += sizeof(T)) { \
+                if (copy) { \
+                    T a = load((T*)(s + j)), b = load((T*)(s + j + CRC32C_BLOCK)), c = load((T*)(s + j + 2*CRC32C_BLOCK)); \
+                    store((T*)(d + j), a); \
+                    store((T*)(d + j + CRC32C_BLOCK), b); \
+                    store((T*)(d + j + 2*CRC32C_BLOCK), c); \
+                } \
+                for (u64 k = j; k < j + sizeof(T); k += 8) { \
+                    crc0 = _mm_crc32_u64(crc0, load_u64(s + k)); \
+                    crc1 = _mm_crc32_u64(crc1, load_u64(s + k + CRC32C_BLOCK)); \
+                    crc2 = _mm_crc32_u64(crc2, load_u64(s + k + 2*CRC32C_BLOCK)); \
+                } \
+            } \
+            crc0 = crc32c_shift(crc0) ^ crc1; \
+            crc0 = crc32c_shift(crc0) ^ crc2; \
+        } \
+        for (; i + sizeof(T) <= size; i += sizeof(T)) { \
+            if (copy) store((T*)(d + i), load((T*)(s + i))); \
+            for (u64 k = i; k < i + sizeof(T); k += 8) crc0 = _mm_crc32_u64(crc0, load_u64(s + k)); \
+        } \
+        for (; i < size; i++) { \
+            if (copy) d[i] = s[i]; \
+            crc0 = _mm_crc32_u8((u32)crc0, s[i]); \
+        } \
+        AIL_BENCH_PROFILE_END(name); \
+        return (u32)~crc0; \
+    }
+
+CPU_TARGET("sse4.2")         COPY_CRC32C(copy_crc32c_simd,   __m128i, _mm_loadu_si128,    _mm_storeu_si128,    true)
+CPU_TARGET("avx,sse4.2")     COPY_CRC32C(copy_crc32c_avx,    __m256i, _mm256_loadu_si256, _mm256_storeu_si256, true)
+CPU_TARGET("avx512f,sse4.2") COPY_CRC32C(copy_crc32c_avx512, __m512i, _mm512_loadu_si512, _mm512_storeu_si512, true)
+CPU_TARGET("sse4.2")         COPY_CRC32C(crc32c_simd,        __m128i, _mm_loadu_si128,    _mm_storeu_si128,    false)
+
+// A fast non-cryptographic 64-bit hash in the style of XXH3 (but not compatible with it): The data is consumed in stripes of 32 bytes,
+// each 64-bit lane is xored with a key and the product of its two halves is added to its accumulator, while the lane itself is added to
+// its neighbour's accumulator. The 128-bit and 256-bit versions produce the same hash.
+#define HASH64_PRIME1 0x9E3779B185EBCA87ull
+#define HASH64_PRIME2 0xC2B2AE3D27D4EB4Full
+#define HASH64_PRIME3 0x165667B19E3779F9ull
+#define HASH64_STRIPE 32
+global const u64 hash64_keys[4] = { 0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull };
+global const u64 hash64_seeds[4] = { HASH64_PRIME1, HASH64_PRIME2, HASH64_PRIME3, HASH64_PRIME1 ^ HASH64_PRIME2 };
+
+internal u64 hash64_finish(u64 acc[4], u64 size)
+{
+    u64 h = size * HASH64_PRIME1;
+    for (u32 l = 0; l < 4; l++) {
+        h ^= (acc[l] ^ (acc[l] >> 29)) * HASH64_PRIME2;
+        h  = ((h << 31) | (h >> 33)) * HASH64_PRIME1;
+    }
+    h ^= h >> 33;
+    h *= HASH64_PRIME2;
+    h ^= h >> 29;
+    h *= HASH64_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+internal inline __m128i hash64_round_sse2(__m128i acc, __m128i x, __m128i key)
+{
+    __m128i dk = _mm_xor_si128(x, key);
+    acc = _mm_add_epi64(acc, _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32)));
+    return _mm_add_epi64(acc, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+CPU_TARGET("avx2") internal inline __m256i hash64_round_avx2(__m256i acc, __m256i x, __m256i key)
+{
+    __m256i dk = _mm256_xor_si256(x, key);
+    acc = _mm256_add_epi64(acc, _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32)));
+    return _mm256_add_epi64(acc, _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// The last partial stripe is padded with zeros, the size is mixed into the final hash
+#define COPY_HASH64(name, T, load, store, round, copy) \
+    internal u64 name(void* restrict dst, void* restrict src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(name, size); \
+        u8 *d = (u8*)dst; \
+        u8 *s = (u8*)src; \
+        T acc[HASH64_STRIPE/sizeof(T)], key[HASH64_STRIPE/sizeof(T)]; \
+        for (u32 l = 0; l < HASH64_STRIPE/sizeof(T); l++) { \
+            acc[l] = load((T*)hash64_seeds + l); \
+            key[l] = load((T*)hash64_keys + l); \
+        } \
+        u64 i = 0; \
+        for (; i + HASH64_STRIPE <= size; i += HASH64_STRIPE) { \
+            for (u32 l = 0; l < HASH64_STRIPE/sizeof(T); l++) { \
+                T x = load((T*)(s + i) + l); \
+                if (copy) store((T*)(d + i) + l, x); \
+                acc[l] = round(acc[l], x, key[l]); \
+            } \
+        } \
+        if (i < size) { \
+            u8 tail[HASH64_STRIPE] = {0}; \
+            memcpy(tail, s + i, size - i); \
+            if (copy) memcpy(d + i, s + i, size - i); \
+            for (u32 l = 0; l < HASH64_STRIPE/sizeof(T); l++) acc[l] = round(acc[l], load((T*)tail + l), key[l]); \
+        } \
+        u64 lanes[4]; \
+        for (u32 l = 0; l < HASH64_STRIPE/sizeof(T); l++) store((T*)lanes + l, acc[l]); \
+        AIL_BENCH_PROFILE_END(name); \
+        return hash64_finish(lanes, size); \
+    }
+
+COPY_HASH64(copy_hash64_simd, __m128i, _mm_loadu_si128, _mm_storeu_si128, hash64_round_sse2, true)
+COPY_HASH64(hash64_simd,      __m128i, _mm_loadu_si128, _mm_storeu_si128, hash64_round_sse2, false)
+CPU_TARGET("avx2") COPY_HASH64(copy_hash64_avx2, __m256i, _mm256_loadu_si256, _mm256_storeu_si256, hash64_round_avx2, true)
+CPU_TARGET("avx2") COPY_HASH64(hash64_avx2,      __m256i, _mm256_loadu_si256, _mm256_storeu_si256, hash64_round_avx2, false)
+
+// The streaming copies write directly to memory with non-temporal stores, which skips the read-for-ownership of dst
+// and keeps the copy from evicting everything else from the caches. The head and tail are written with regular
+// unaligned stores, overlapping the (aligned) streamed part, and the sfence orders the streamed stores before any later stores
+internal void copy_simd_stream(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_simd_stream, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    if (size < 2*sizeof(__m128i)) {
+        __movsb(d, s, size);
+    } else {
+        u64 d_pre_na = ail_alloc_align_forward((u64)d, sizeof(__m128i)) - (u64)d;
+        u64 n = (size - d_pre_na) / sizeof(__m128i);
+        __m128i *da = (__m128i*)(d + d_pre_na);
+        __m128i *sa = (__m128i*)(s + d_pre_na);
+        _mm_storeu_si128((__m128i*)d, _mm_loadu_si128((__m128i*)s));
+        for (u64 i = 0; i < n; i++) {
+            _mm_stream_si128(da + i, _mm_loadu_si128(sa + i));
+        }
+        _mm_storeu_si128((__m128i*)(d + size - sizeof(__m128i)), _mm_loadu_si128((__m128i*)(s + size - sizeof(__m128i))));
+        _mm_sfence();
+    }
+    AIL_BENCH_PROFILE_END(copy_simd_stream);
+}
+
+CPU_TARGET("avx") internal void copy_avx_stream(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_avx_stream, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    if (size < 2*sizeof(__m256i)) {
+        __movsb(d, s, size);
+    } else {
+        u64 d_pre_na = ail_alloc_align_forward((u64)d, sizeof(__m256i)) - (u64)d;
+        u64 n = (size - d_pre_na) / sizeof(__m256i);
+        __m256i *da = (__m256i*)(d + d_pre_na);
+        __m256i *sa = (__m256i*)(s + d_pre_na);
+        _mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((__m256i*)s));
+        for (u64 i = 0; i < n; i++) {
+            _mm256_stream_si256(da + i, _mm256_loadu_si256(sa + i));
+        }
+        _mm256_storeu_si256((__m256i*)(d + size - sizeof(__m256i)), _mm256_loadu_si256((__m256i*)(s + size - sizeof(__m256i))));
+        _mm_sfence();
+    }
+    AIL_BENCH_PROFILE_END(copy_avx_stream);
+}
+
+CPU_TARGET("avx512f") internal void copy_avx512_stream(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_avx512_stream, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    if (size < 2*sizeof(__m512i)) {
+        __movsb(d, s, size);
+    } else {
+        u64 d_pre_na = ail_alloc_align_forward((u64)d, sizeof(__m512i)) - (u64)d;
+        u64 n = (size - d_pre_na) / sizeof(__m512i);
+        __m512i *da = (__m512i*)(d + d_pre_na);
+        __m512i *sa = (__m512i*)(s + d_pre_na);
+        _mm512_storeu_si512(d, _mm512_loadu_si512(s));
+        for (u64 i = 0; i < n; i++) {
+            _mm512_stream_si512(da + i, _mm512_loadu_si512(sa + i));
+        }
+        _mm512_storeu_si512(d + size - sizeof(__m512i), _mm512_loadu_si512(s + size - sizeof(__m512i)));
+        _mm_sfence();
+    }
+    AIL_BENCH_PROFILE_END(copy_avx512_stream);
+}
+
+// Copies of at least this size use non-temporal stores in copy_stream/move_stream
+// The default of 3/4 of the last-level cache leaves some room for src and whatever else is in the cache
+global u64 stream_threshold;
+global FuncType stream_copy_cached;
+global FuncType stream_copy_uncached;
+
+internal void init_stream_copy(void)
+{
+    stream_threshold = cpu_last_level_cache_size() / 4 * 3;
+    if (!stream_threshold) stream_threshold = AIL_MB(4);
+    if (cpu_supports(CPU_AVX512F)) {
+        stream_copy_cached   = copy_avx512;
+        stream_copy_uncached = copy_avx512_stream;
+    } else if (cpu_supports(CPU_AVX)) {
+        stream_copy_cached   = copy_avx;
+        stream_copy_uncached = copy_avx_stream;
+    } else {
+        stream_copy_cached   = copy_simd;
+        stream_copy_uncached = copy_simd_stream;
+    }
+}
+
+internal void copy_stream(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_stream, size);
+    if (size < stream_threshold) stream_copy_cached(dst, src, size);
+    else                         stream_copy_uncached(dst, src, size);
+    AIL_BENCH_PROFILE_END(copy_stream);
+}
+
+// Streaming stores are only used if the regions don't overlap, since otherwise the copy direction matters
+internal void move_stream(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(move_stream, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    if (d < s + size && s < d + size) {
+        if      (cpu_supports(CPU_AVX512F)) move_avx512(dst, src, size);
+        else if (cpu_supports(CPU_AVX))     move_avx(dst, src, size);
+        else                                move_simd(dst, src, size);
+    } else if (size < stream_threshold) {
+        stream_copy_cached(dst, src, size);
+    } else {
+        stream_copy_uncached(dst, src, size);
+    }
+    AIL_BENCH_PROFILE_END(move_stream);
+}
+
+internal void copy_rep_movs(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_rep_movs, size);
+    u64 n   = size / sizeof(u64);
+    u64 rem = size & (sizeof(u64) - 1);
+    u64 *s = (u64*)src;
+    u64 *d = (u64*)dst;
+    if (n) __movsq(d, s, n);
+    if (rem) __movsb((u8*)(d + n), (u8*)(s + n), rem);
+    AIL_BENCH_PROFILE_END(copy_rep_movs);
+}
+
+// The profiler isn't thread-safe, so the worker threads use memcpy directly instead of any of the profiled procedures
+global Pool pool;
+global u64  parallel_min_chunk = PARALLEL_MIN_CHUNK;
+
+typedef struct Parallel_Copy {
+    u8 *dst;
+    u8 *src;
+    u64 size;
+} Parallel_Copy;
+
+internal void parallel_copy_task(void *arg, u32 idx, u32 count)
+{
+    Parallel_Copy *c = arg;
+    // Chunks are aligned to cache lines, so no two threads write to the same cache line
+    u64 chunk = ail_alloc_align_forward(c->size / count, 64);
+    u64 start = AIL_MIN(idx*chunk, c->size);
+    u64 end   = idx == count - 1 ? c->size : AIL_MIN(start + chunk, c->size);
+    memcpy(c->dst + start, c->src + start, end - start);
+}
+
+internal u32 parallel_task_count(u64 size)
+{
+    u64 n = size / parallel_min_chunk;
+    return (u32)AIL_MAX(1, AIL_MIN(n, pool.thread_count));
+}
+
+internal void copy_parallel(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_parallel, size);
+    Parallel_Copy c = { (u8*)dst, (u8*)src, size };
+    pool_run(&pool, parallel_copy_task, &c, parallel_task_count(size));
+    AIL_BENCH_PROFILE_END(copy_parallel);
+}
+
+// If the regions overlap by all but `dist` bytes, the copy is done in waves of `dist` bytes each.
+// Within a wave, src and dst don't overlap, so its chunks can be copied in parallel. The waves are processed
+// in the same direction as a sequential memmove would copy, so no wave reads bytes that were already overwritten.
+internal void move_parallel(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(move_parallel, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    u64 dist = d < s ? (u64)(s - d) : (u64)(d - s);
+    if (dist >= size) {
+        Parallel_Copy c = { d, s, size };
+        pool_run(&pool, parallel_copy_task, &c, parallel_task_count(size));
+    } else if (dist < 2*parallel_min_chunk) {
+        // Too many waves, each of which would be too small to be worth waking up the workers
+        memmove(d, s, size);
+    } else if (d < s) {
+        for (u64 off = 0; off < size; off += dist) {
+            Parallel_Copy c = { d + off, s + off, AIL_MIN(dist, size - off) };
+            pool_run(&pool, parallel_copy_task, &c, parallel_task_count(c.size));
+        }
+    } else {
+        for (u64 end = size; end > 0;) {
+            u64 n = AIL_MIN(dist, end);
+            end  -= n;
+            Parallel_Copy c = { d + end, s + end, n };
+            pool_run(&pool, parallel_copy_task, &c, parallel_task_count(c.size));
+        }
+    }
+    AIL_BENCH_PROFILE_END(move_parallel);
+}
+
+internal void copy_builtin(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_builtin, size);
+    memcpy(dst, src, size);
+    AIL_BENCH_PROFILE_END(copy_builtin);
+}
+
+internal void move_builtin(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(move_builtin, size);
+    memmove(dst, src, size);
+    AIL_BENCH_PROFILE_END(move_builtin);
+}
+
+// The two-pass versions that the fused copies replace: A copy followed by a checksum of the copied data
+CPU_TARGET("sse4.2") internal u64 copy_then_crc32c(void* restrict dst, void* restrict src, u64 size)
+{
+    copy_builtin(dst, src, size);
+    return crc32c_simd(0, dst, size);
+}
+
+internal u64 copy_then_hash64(void* restrict dst, void* restrict src, u64 size)
+{
+    copy_builtin(dst, src, size);
+    return cpu_supports(CPU_AVX2) ? hash64_avx2(0, dst, size) : hash64_simd(0, dst, size);
+}
+
+// Moving or copying whole pages doesn't require touching their contents: mremap moves the page table entries of src
+// to dst, while mapping the memfd behind src a second time with MAP_PRIVATE shares its pages copy-on-write
+// Both need src and dst to start at the same offset into a page, the unaligned head and tail are copied with SIMD
+#define REMAP_PAGE_SIZE AIL_KB(4)
+
+#if defined(__linux__)
+// The raw syscalls avoid depending on _GNU_SOURCE being defined before the first include
+#   ifndef MREMAP_MAYMOVE
+#       define MREMAP_MAYMOVE 1
+#       define MREMAP_FIXED   2
+#   endif
+#   ifndef MREMAP_DONTUNMAP
+#       define MREMAP_DONTUNMAP 4
+#   endif
+#   ifndef MFD_CLOEXEC
+#       define MFD_CLOEXEC 1
+#   endif
+
+// Buffers from cow_alloc, which are mapped from a memfd that copy_cow can map into dst again
+typedef struct Cow_Region {
+    u8 *base;
+    u64 size;
+    int fd;
+} Cow_Region;
+global Cow_Region cow_regions[16];
+
+// Allocates a buffer whose pages can be shared with copy_cow, returns 0 if memfds aren't supported
+internal u8 *cow_alloc(u64 size)
+{
+    for (u64 i = 0; i < AIL_ARRLEN(cow_regions); i++) {
+        if (cow_regions[i].base) continue;
+        int fd = (int)syscall(SYS_memfd_create, "speedy-cow", MFD_CLOEXEC);
+        if (fd < 0) return 0;
+        u8 *p = ftruncate(fd, (off_t)size) ? MAP_FAILED : mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        cow_regions[i] = (Cow_Region){ p, size, fd };
+        return p;
+    }
+    return 0;
+}
+
+internal void cow_free(u8 *p)
+{
+    for (u64 i = 0; i < AIL_ARRLEN(cow_regions); i++) {
+        if (cow_regions[i].base != p) continue;
+        munmap(p, cow_regions[i].size);
+        close(cow_regions[i].fd);
+        cow_regions[i] = (Cow_Region){0};
+    }
+}
+
+internal Cow_Region *find_cow_region(u8 *p, u64 size)
+{
+    for (u64 i = 0; i < AIL_ARRLEN(cow_regions); i++) {
+        Cow_Region *r = &cow_regions[i];
+        if (r->base && p >= r->base && p + size <= r->base + r->size) return r;
+    }
+    return 0;
+}
+
+typedef enum Remap_Result {
+    REMAP_FAILED,   // Nothing was moved
+    REMAP_DONE,     // The pages were moved to dst and src is mapped with zero-filled pages
+    REMAP_SRC_LOST, // The pages were moved to dst, but src couldn't be mapped again and must not be accessed anymore
+} Remap_Result;
+
+// Amount of calls of move_remap that left parts of src unmapped
+global u64 remap_lost_src_count;
+
+// Older kernels unmap src when moving its pages, so it's replaced with fresh pages
+internal Remap_Result remap_pages_unmap(u8 *d, u8 *s, u64 len)
+{
+    if (syscall(SYS_mremap, s, len, len, MREMAP_MAYMOVE|MREMAP_FIXED, d) == -1) return REMAP_FAILED;
+    return mmap(s, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0) != MAP_FAILED ? REMAP_DONE : REMAP_SRC_LOST;
+}
+
+// MREMAP_DONTUNMAP (Linux 5.7+) leaves src mapped with empty pages
+internal Remap_Result remap_pages_dontunmap(u8 *d, u8 *s, u64 len)
+{
+    if (syscall(SYS_mremap, s, len, len, MREMAP_MAYMOVE|MREMAP_FIXED|MREMAP_DONTUNMAP, d) != -1) return REMAP_DONE;
+    return remap_pages_unmap(d, s, len);
+}
+
+// test_remap replaces this to take the path of older kernels and to simulate failures on it
+global Remap_Result (*remap_pages)(u8 *d, u8 *s, u64 len) = remap_pages_dontunmap;
+#else
+internal u8 *cow_alloc(u64 size) { (void)size; return 0; }
+internal void cow_free(u8 *p) { (void)p; }
+#endif
+
+// Returns the amount of whole pages (in bytes) that follow the unaligned head of the region, 0 if the regions can't be remapped
+// head is set to the amount of bytes before the first page boundary of dst
+internal u64 remap_split(u8 *d, u8 *s, u64 size, u64 *head)
+{
+    u64 off = (u64)d % REMAP_PAGE_SIZE;
+    if (off != (u64)s % REMAP_PAGE_SIZE) return 0;
+    *head = off ? REMAP_PAGE_SIZE - off : 0;
+    if (*head >= size) return 0;
+    return (size - *head) & ~(REMAP_PAGE_SIZE - 1);
+}
+
+// Moves whole pages by remapping them, src is left with zero-filled pages afterwards
+// Overlapping regions can't be remapped and fall back to move_stream
+// If the pages were moved but src couldn't be mapped again, dst is still complete, while the whole pages of src stay
+// unmapped, which is counted in remap_lost_src_count
+internal void move_remap(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(move_remap, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    u64 head = 0;
+    u64 len  = d < s + size && s < d + size ? 0 : remap_split(d, s, size, &head);
+#if defined(__linux__)
+    Remap_Result result = len ? remap_pages(d + head, s + head, len) : REMAP_FAILED;
+    if (result != REMAP_FAILED) {
+        // The head and tail lie outside of the remapped pages, so they are still mapped in src
+        if (head) stream_copy_cached(d, s, head);
+        if (size > head + len) stream_copy_cached(d + head + len, s + head + len, size - head - len);
+        if (result == REMAP_SRC_LOST) remap_lost_src_count++;
+    } else {
+        move_stream(dst, src, size);
+    }
+#else
+    (void)len;
+    move_stream(dst, src, size);
+#endif
+    AIL_BENCH_PROFILE_END(move_remap);
+}
+
+// Lazily copies whole pages by mapping the memfd behind src into dst copy-on-write
+// Only src from cow_alloc can be shared, everything else falls back to copy_stream
+// @Note: Until dst's pages are written, they are shared with the memfd, so later writes to src show up in dst as well.
+// dst is therefore a snapshot that is only valid as long as src isn't modified
+internal void copy_cow(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(copy_cow, size);
+    u8 *d = (u8*)dst;
+    u8 *s = (u8*)src;
+    u64 head = 0;
+    u64 len  = remap_split(d, s, size, &head);
+#if defined(__linux__)
+    Cow_Region *r = len ? find_cow_region(s, size) : 0;
+    if (r && mmap(d + head, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, r->fd, s + head - r->base) != MAP_FAILED) {
+        if (head) stream_copy_cached(d, s, head);
+        if (size > head + len) stream_copy_cached(d + head + len, s + head + len, size - head - len);
+    } else {
+        copy_stream(dst, src, size);
+    }
+#else
+    (void)len;
+    copy_stream(dst, src, size);
+#endif
+    AIL_BENCH_PROFILE_END(copy_cow);
+}
+
+// Filled by calibrate_dispatch or load_dispatch_table with the fastest procedure per size class
+global FuncType copy_dispatch[SIZE_CLASS_COUNT];
+global FuncType move_dispatch[SIZE_CLASS_COUNT];
+
+internal void mem_copy_auto(void* restrict dst, void* restrict src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(mem_copy_auto, size);
+    copy_dispatch[size_class(size)](dst, src, size);
+    AIL_BENCH_PROFILE_END(mem_copy_auto);
+}
+
+internal void mem_move_auto(void *dst, void *src, u64 size)
+{
+    AIL_BENCH_PROFILE_MEM_START(mem_move_auto, size);
+    move_dispatch[size_class(size)](dst, src, size);
+    AIL_BENCH_PROFILE_END(mem_move_auto);
+}
+
+typedef struct Func {
+    const char *name;
+    FuncType func;
+    u32 features; // CPU_Feature flags that are required for running this function
+} Func;
+#define FUNC(func) { AIL_STRINGIFY(func), func, 0 }
+#define FUNC_REQUIRES(func, features) { AIL_STRINGIFY(func), func, features }
+global Func copy_funcs[MAX_FUNC_COUNT] = {
+    FUNC(copy_bytes),
+    FUNC(copy_bytes_wide),
+    FUNC(copy_bytes_wide_backwards),
+    FUNC(copy_quads),
+    FUNC(copy_quads_backwards),
+    FUNC(copy_quads_wide),
+    FUNC(copy_rep_movs),
+    FUNC(copy_simd_backwards),
+    FUNC(copy_simd),
+    FUNC(copy_simd_aligned),
+    FUNC(copy_simd_prefetch),
+    FUNC(copy_simd_backwards_prefetch),
+    FUNC(copy_simd_two_ended_prefetch),
+    FUNC_REQUIRES(copy_avx_backwards,    CPU_AVX),
+    FUNC_REQUIRES(copy_avx,              CPU_AVX),
+    FUNC_REQUIRES(copy_avx_aligned,      CPU_AVX),
+    FUNC_REQUIRES(copy_avx_prefetch,           CPU_AVX),
+    FUNC_REQUIRES(copy_avx_backwards_prefetch, CPU_AVX),
+    FUNC_REQUIRES(copy_avx_two_ended_prefetch, CPU_AVX),
+    FUNC_REQUIRES(copy_avx512_backwards, CPU_AVX512F),
+    FUNC_REQUIRES(copy_avx512,           CPU_AVX512F),
+    FUNC_REQUIRES(copy_avx512_aligned,   CPU_AVX512F),
+    FUNC(copy_simd_stream),
+    FUNC_REQUIRES(copy_avx_stream,       CPU_AVX),
+    FUNC_REQUIRES(copy_avx512_stream,    CPU_AVX512F),
+    FUNC(copy_stream),
+    FUNC(copy_small),
+    FUNC_REQUIRES(copy_small_avx,        CPU_AVX),
+    FUNC(copy_parallel),
+    FUNC(copy_builtin),
+    FUNC(mem_copy_auto),
+    GENERATED_COPY_FUNCS
+};
+global Func move_funcs[MAX_FUNC_COUNT] = {
+    FUNC(move_bytes),
+    FUNC(move_bytes_wide),
+    FUNC(move_quads),
+    FUNC(move_simd),
+    FUNC(move_simd_with_rep_movs),
+    FUNC_REQUIRES(move_avx,    CPU_AVX),
+    FUNC_REQUIRES(move_avx512, CPU_AVX512F),
+    FUNC(move_stream),
+    FUNC(move_small),
+    FUNC_REQUIRES(move_small_avx, CPU_AVX),
+    FUNC(move_parallel),
+    FUNC(move_builtin),
+    FUNC(mem_move_auto),
+    GENERATED_MOVE_FUNCS
+};
+// move_remap zero-fills src and copy_cow only shares the pages of buffers from cow_alloc, so they aren't part of the
+// general lists and are benchmarked separately against the best byte-copying procedures with -remap
+global Func remap_copy_funcs[] = { FUNC(copy_cow),   FUNC(copy_stream), FUNC(copy_builtin) };
+global Func remap_move_funcs[] = { FUNC(move_remap), FUNC(move_stream), FUNC(move_builtin) };
+global u64 copy_funcs_count;
+global u64 move_funcs_count;
+
+// Removes all functions from the list that can't be run on this CPU and returns the amount of remaining functions
+internal u64 filter_supported_funcs(Func *funcs, u64 cap)
+{
+    u64 count = 0;
+    for (u64 i = 0; i < cap && funcs[i].name; i++) {
+        if (cpu_supports(funcs[i].features)) {
+            funcs[count++] = funcs[i];
+        } else {
+            char features[64];
+            cpu_features_to_str(funcs[i].features & ~cpu_features(), features, sizeof(features));
+            printf("\033[33mSkipping %s, since this CPU doesn't support %s\033[0m\n", funcs[i].name, features);
+        }
+    }
+    for (u64 i = count; i < cap; i++) funcs[i] = (Func){0};
+    return count;
+}
+
+void get_printable_mem_size(char *str, u64 mem_size)
+{
+	if      (mem_size >= AIL_GB(1)) snprintf(str, 8, "%zuGB", mem_size/AIL_GB(1));
+	else if (mem_size >= AIL_MB(1)) snprintf(str, 8, "%zuMB", mem_size/AIL_MB(1));
+	else if (mem_size >= AIL_KB(1)) snprintf(str, 8, "%zuKB", mem_size/AIL_KB(1));
+	else                            snprintf(str, 8, "%zuB", mem_size);
+}
+
+internal Func *find_func(Func *funcs, u64 count, const char *name)
+{
+    for (u64 i = 0; i < count; i++) {
+        if (!strcmp(funcs[i].name, name)) return &funcs[i];
+    }
+    return 0;
+}
+
+global Plugin plugins[MAX_PLUGIN_COUNT];
+global u32 plugins_count;
+
+// The profiler only reports routines with an anchor of their own, so plugin routines are called through these trampolines,
+// whose profiles are printed as plugin_<index> (load_plugins prints which routine got which index). The extra call matches
+// the one of copy_builtin/move_builtin into the C library.
+#define MAX_PLUGIN_FUNC_COUNT 16
+global FuncType plugin_funcs[MAX_PLUGIN_FUNC_COUNT];
+global u32 plugin_funcs_count;
+#define PLUGIN_TRAMPOLINE(k) \
+    internal void plugin_##k(void *dst, void *src, u64 size) \
+    { \
+        AIL_BENCH_PROFILE_MEM_START(plugin_##k, size); \
+        plugin_funcs[k](dst, src, size); \
+        AIL_BENCH_PROFILE_END(plugin_##k); \
+    }
+PLUGIN_TRAMPOLINE(0)  PLUGIN_TRAMPOLINE(1)  PLUGIN_TRAMPOLINE(2)  PLUGIN_TRAMPOLINE(3)
+PLUGIN_TRAMPOLINE(4)  PLUGIN_TRAMPOLINE(5)  PLUGIN_TRAMPOLINE(6)  PLUGIN_TRAMPOLINE(7)
+PLUGIN_TRAMPOLINE(8)  PLUGIN_TRAMPOLINE(9)  PLUGIN_TRAMPOLINE(10) PLUGIN_TRAMPOLINE(11)
+PLUGIN_TRAMPOLINE(12) PLUGIN_TRAMPOLINE(13) PLUGIN_TRAMPOLINE(14) PLUGIN_TRAMPOLINE(15)
+global FuncType plugin_trampolines[MAX_PLUGIN_FUNC_COUNT] = {
+    plugin_0, plugin_1, plugin_2,  plugin_3,  plugin_4,  plugin_5,  plugin_6,  plugin_7,
+    plugin_8, plugin_9, plugin_10, plugin_11, plugin_12, plugin_13, plugin_14, plugin_15,
+};
+
+// Loads the shared object of every `-plugin path:copy=symbol,move=symbol,...` argument and appends the routines to copy_funcs/move_funcs
+// They are tested and benchmarked like the built-in ones, so they need to have the signature of FuncType
+internal void load_plugins(int argc, char **argv)
+{
+    plugins_count = plugin_open_all(argc, argv, plugins, MAX_PLUGIN_COUNT);
+    for (u32 i = 0; i < plugins_count; i++) {
+        Plugin *p = &plugins[i];
+        for (u32 j = 0; j < p->symbol_count; j++) {
+            char *symbol = strchr(p->symbols[j], '=');
+            b32 is_copy  = symbol && !strncmp(p->symbols[j], "copy=", 5);
+            b32 is_move  = symbol && !strncmp(p->symbols[j], "move=", 5);
+            if (!is_copy && !is_move) {
+                printf("\033[31mInvalid routine '%s' of the plugin '%s', expected copy=symbol or move=symbol\033[0m\n", p->symbols[j], p->path);
+                continue;
+            }
+            symbol++;
+            Func *funcs = is_copy ? copy_funcs : move_funcs;
+            u64 *count  = is_copy ? &copy_funcs_count : &move_funcs_count;
+            FuncType func = (FuncType)plugin_symbol(p, symbol);
+            if (!func) continue;
+            if (*count == MAX_FUNC_COUNT || plugin_funcs_count == MAX_PLUGIN_FUNC_COUNT) {
+                printf("\033[33mSkipping %s of the plugin '%s', since too many procedures were loaded\033[0m\n", symbol, p->path);
+                continue;
+            }
+            plugin_funcs[plugin_funcs_count] = func;
+            funcs[(*count)++] = (Func){ plugin_name(p, symbol), plugin_trampolines[plugin_funcs_count], 0 };
+            printf("Loaded the %s-procedure %s (profiled as plugin_%u)\n", is_copy ? "copy" : "move", funcs[*count - 1].name, plugin_funcs_count);
+            plugin_funcs_count++;
+        }
+    }
+}
+
+global const char *copy_dispatch_names[SIZE_CLASS_COUNT];
+global const char *move_dispatch_names[SIZE_CLASS_COUNT];
+
+internal void set_default_dispatch(void)
+{
+    for (u32 c = 0; c < SIZE_CLASS_COUNT; c++) {
+        copy_dispatch[c] = copy_builtin;
+        move_dispatch[c] = move_builtin;
+        copy_dispatch_names[c] = "copy_builtin";
+        move_dispatch_names[c] = "move_builtin";
+    }
+}
+
+internal u64 calibration_min_time(FuncType func, Buffer buf)
+{
+    u64 min = (u64)-1;
+    for (u64 k = 0; k < ITER_COUNT; k++) {
+        u64 start = ail_bench_cpu_timer();
+        func(buf.dst, buf.src, buf.size);
+        u64 elapsed = ail_bench_cpu_timer() - start;
+        if (elapsed < min) min = elapsed;
+    }
+    return min;
+}
+
+// Runs every copy-/move-procedure once per size class between MIN_BUFFER_SIZE and MAX_BUFFER_SIZE and
+// fills the dispatch tables with the fastest one. Size classes outside of that range use the closest calibrated class.
+// Move-procedures are measured on non-overlapping and on left-/right-overlapping buffers and ranked by their summed time.
+internal void calibrate_dispatch(void)
+{
+    u32 min_class = size_class(MIN_BUFFER_SIZE);
+    u32 max_class = size_class(MAX_BUFFER_SIZE);
+    printf("Calibrating mem_copy_auto/mem_move_auto for sizes between 2^%u and 2^%u bytes\n", min_class - 1, max_class - 1);
+    for (u32 c = min_class; c <= max_class; c++) {
+        u64 size = c < 2 ? 1 : AIL_MIN(3ull << (c - 2), MAX_BUFFER_SIZE); // Middle of the size class
+
+        Buffer buf = get_buffer(size, 0, 0);
+        fill_buffer(&buf);
+        u64 best_time = (u64)-1;
+        for (u64 idx = 0; idx < copy_funcs_count; idx++) {
+            if (copy_funcs[idx].func == mem_copy_auto) continue;
+            u64 t = calibration_min_time(copy_funcs[idx].func, buf);
+            if (t < best_time) {
+                best_time = t;
+                copy_dispatch[c] = copy_funcs[idx].func;
+                copy_dispatch_names[c] = copy_funcs[idx].name;
+            }
+        }
+        free_buffer(buf);
+
+        Buffer buffers[] = {
+            get_buffer(size, 0, 0),
+            get_buffer(size, size/4, true),
+            get_buffer(size, size/4, false),
+            get_buffer(size, size - size/4, true),
+            get_buffer(size, size - size/4, false),
+        };
+        best_time = (u64)-1;
+        for (u64 idx = 0; idx < move_funcs_count; idx++) {
+            if (move_funcs[idx].func == mem_move_auto) continue;
+            u64 t = 0;
+            for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) {
+                fill_buffer(&buffers[j]);
+                t += calibration_min_time(move_funcs[idx].func, buffers[j]);
+            }
+            if (t < best_time) {
+                best_time = t;
+                move_dispatch[c] = move_funcs[idx].func;
+                move_dispatch_names[c] = move_funcs[idx].name;
+            }
+        }
+        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) free_buffer(buffers[j]);
+
+        char mem_size[12];
+        get_printable_mem_size(mem_size, size);
+        printf("  %-6s (class %2u): %-24s %s\n", mem_size, c, copy_dispatch_names[c], move_dispatch_names[c]);
+    }
+    for (u32 c = 0; c < min_class; c++) {
+        copy_dispatch[c] = copy_dispatch[min_class]; copy_dispatch_names[c] = copy_dispatch_names[min_class];
+        move_dispatch[c] = move_dispatch[min_class]; move_dispatch_names[c] = move_dispatch_names[min_class];
+    }
+    for (u32 c = max_class + 1; c < SIZE_CLASS_COUNT; c++) {
+        copy_dispatch[c] = copy_dispatch[max_class]; copy_dispatch_names[c] = copy_dispatch_names[max_class];
+        move_dispatch[c] = move_dispatch[max_class]; move_dispatch_names[c] = move_dispatch_names[max_class];
+    }
+}
+
+// The table is stored as text, with one line per size class and kind: `<copy|move> <size class> <procedure name>`
+internal b32 save_dispatch_table(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# mem-copy dispatch table: <copy|move> <size class> <procedure>, size class c contains sizes in [2^(c-1), 2^c)\n");
+    for (u32 c = 0; c < SIZE_CLASS_COUNT; c++) fprintf(f, "copy %u %s\n", c, copy_dispatch_names[c]);
+    for (u32 c = 0; c < SIZE_CLASS_COUNT; c++) fprintf(f, "move %u %s\n", c, move_dispatch_names[c]);
+    fclose(f);
+    return true;
+}
+
+// Entries naming procedures that aren't available (i.e. because the file was calibrated on a different CPU) keep their default
+internal b32 load_dispatch_table(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char line[256], kind[16], name[128];
+    u32 c;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%15s %u %127s", kind, &c, name) != 3 || c >= SIZE_CLASS_COUNT) continue;
+        b32 is_copy = !strcmp(kind, "copy");
+        Func *func  = is_copy ? find_func(copy_funcs, copy_funcs_count, name) : find_func(move_funcs, move_funcs_count, name);
+        if (!func || func->func == mem_copy_auto || func->func == mem_move_auto) {
+            printf("\033[33mIgnoring unknown procedure '%s' in %s\033[0m\n", name, path);
+        } else if (is_copy) {
+            copy_dispatch[c] = func->func;
+            copy_dispatch_names[c] = func->name;
+        } else {
+            move_dispatch[c] = func->func;
+            move_dispatch_names[c] = func->name;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static void test(TestBufferList buffers, Func func, b32 is_copy_func)
+{
+	for (u64 i = 0; i < test_inputs_count; i++) {
+		Buffer buf = buffers[i];
+        if (!is_copy_func || !buf.overlap_size) {
+            fill_buffer(&buf);
+		    func.func(buf.dst, buf.src, buf.size);
+            if (!test_buffer(buf)) {
+		    	printf("\033[31m%s failed test for buffer-size %zu (with %zu %s-overlapped bytes) :(\033[0m\n", func.name, test_inputs[i].size, test_inputs[i].overlap_size, test_inputs[i].overlap_left ? "left" : "right");
+		    	return;
+		    }
+        }
+	}
+	printf("\033[32m%s passed all tests :)\033[0m\n", func.name);
+}
+
+#if defined(__linux__)
+// Moves the pages like an older kernel, but without mapping src again, as if that had failed
+internal Remap_Result remap_pages_lose_src(u8 *d, u8 *s, u64 len)
+{
+    return syscall(SYS_mremap, s, len, len, MREMAP_MAYMOVE|MREMAP_FIXED, d) == -1 ? REMAP_FAILED : REMAP_SRC_LOST;
+}
+#endif
+
+// The regular test buffers are too small for remapping any pages, so move_remap and copy_cow are additionally tested
+// on larger regions, with equal and different offsets of src and dst into their pages
+internal void test_remap(void)
+{
+    u64 sizes[] = { REMAP_PAGE_SIZE, 3*REMAP_PAGE_SIZE + 100, AIL_MB(4) + 17 };
+    u64 offsets[][2] = { { 0, 0 }, { 100, 100 }, { REMAP_PAGE_SIZE - 1, REMAP_PAGE_SIZE - 1 }, { 0, 64 } };
+    b32 move_passed = true, copy_passed = true;
+    for (u64 i = 0; i < AIL_ARRLEN(sizes); i++) {
+        for (u64 j = 0; j < AIL_ARRLEN(offsets); j++) {
+            u64 size = sizes[i], total = size + REMAP_PAGE_SIZE;
+            Buffer base = get_buffer(total, 0, 0);
+            Buffer buf  = { .size = size, .dst = base.dst + offsets[j][0], .src = base.src + offsets[j][1] };
+            fill_buffer(&buf);
+            move_remap(buf.dst, buf.src, buf.size);
+            if (move_passed && !test_buffer(buf)) {
+                printf("\033[31mmove_remap failed test for buffer-size %zu (with offsets %zu/%zu) :(\033[0m\n", size, offsets[j][0], offsets[j][1]);
+                move_passed = false;
+            }
+
+            u8 *src = cow_alloc(total);
+            if (!src) {
+                printf("\033[33mSkipping tests of copy_cow, since memfds aren't supported\033[0m\n");
+                free_buffer(base);
+                return;
+            }
+            buf.src = src + offsets[j][1];
+            fill_buffer(&buf);
+            copy_cow(buf.dst, buf.src, buf.size);
+            b32 passed = test_buffer(buf);
+            // Writes to the copy have to stay private
+            buf.dst[size/2] ^= 0xff;
+            passed &= buf.src[size/2] == (u8)(buf.start_byte + size/2);
+            if (copy_passed && !passed) {
+                printf("\033[31mcopy_cow failed test for buffer-size %zu (with offsets %zu/%zu) :(\033[0m\n", size, offsets[j][0], offsets[j][1]);
+                copy_passed = false;
+            }
+            cow_free(src);
+            free_buffer(base);
+        }
+    }
+#if defined(__linux__)
+    // Kernels without MREMAP_DONTUNMAP unmap src and have to map it again, which is forced here, once with mapping src
+    // again succeeding and once with it failing, after which the head and tail still have to be copied
+    Remap_Result (*remap_pages_prev)(u8 *d, u8 *s, u64 len) = remap_pages;
+    for (u32 fail = 0; fail < 2 && move_passed; fail++) {
+        u64 size = 3*REMAP_PAGE_SIZE + 100, total = size + REMAP_PAGE_SIZE;
+        Page_Kind pages;
+        u8 *dst = pages_alloc(total, PAGES_4K, 0, &pages);
+        u8 *src = pages_alloc(total, PAGES_4K, 0, &pages);
+        Buffer buf = { .size = size, .dst = dst + 100, .src = src + 100 };
+        fill_buffer(&buf);
+        u64 lost = remap_lost_src_count;
+        remap_pages = fail ? remap_pages_lose_src : remap_pages_unmap;
+        move_remap(buf.dst, buf.src, buf.size);
+        remap_pages = remap_pages_prev;
+        b32 passed = test_buffer(buf) && remap_lost_src_count == lost + fail;
+        if (!fail) passed &= buf.src[size/2] == 0;
+        if (!passed) {
+            printf("\033[31mmove_remap failed test for buffer-size %zu without MREMAP_DONTUNMAP (%s mapping src again) :(\033[0m\n",
+                   size, fail ? "failing" : "succeeding");
+            move_passed = false;
+        }
+        remap_lost_src_count = lost;
+        pages_free(dst, total, PAGES_4K);
+        pages_free(src, total, PAGES_4K);
+    }
+#endif
+    if (move_passed) printf("\033[32mmove_remap passed all tests :)\033[0m\n");
+    if (copy_passed) printf("\033[32mcopy_cow passed all tests :)\033[0m\n");
+}
+
+// The regular test buffers are all smaller than parallel_min_chunk, so copy_parallel and move_parallel would never split them.
+// They are therefore additionally tested with a small minimum chunk and at least PARALLEL_TEST_THREADS threads, on sizes of
+// several chunks per thread, with overlaps that result in several waves of parallel chunks in both directions.
+#define PARALLEL_TEST_THREADS 4
+#define PARALLEL_TEST_CHUNK   256
+internal void test_parallel(void)
+{
+    u32 thread_count = pool.thread_count;
+    u64 min_chunk    = parallel_min_chunk;
+    if (thread_count < PARALLEL_TEST_THREADS) {
+        pool_deinit(&pool);
+        pool_init(&pool, PARALLEL_TEST_THREADS);
+    }
+    parallel_min_chunk = PARALLEL_TEST_CHUNK;
+
+    u64 chunk = PARALLEL_TEST_CHUNK, threads = pool.thread_count;
+    u64 sizes[] = { 2*chunk - 1, threads*chunk + 1, 3*threads*chunk + 13, 8*threads*chunk + 100 };
+    b32 copy_passed = true, move_passed = true;
+    for (u64 i = 0; i < AIL_ARRLEN(sizes) && copy_passed; i++) {
+        Buffer buf = get_buffer(sizes[i], 0, 0);
+        fill_buffer(&buf);
+        copy_parallel(buf.dst, buf.src, buf.size);
+        if (!test_buffer(buf)) {
+            printf("\033[31mcopy_parallel failed test for buffer-size %zu (with %zu threads) :(\033[0m\n", buf.size, threads);
+            copy_passed = false;
+        }
+        free_buffer(buf);
+    }
+    for (u64 i = 0; i < AIL_ARRLEN(sizes) && move_passed; i++) {
+        u64 size = sizes[i];
+        // Distances between src and dst: a single memmove, exactly the minimum for waves, unaligned waves and a few large waves
+        u64 dists[] = { chunk, 2*chunk, 2*chunk + 17, size/3 + 1, size };
+        for (u64 j = 0; j < AIL_ARRLEN(dists) && move_passed; j++) {
+            if (dists[j] > size) continue;
+            for (u32 left = 0; left < 2 && move_passed; left++) {
+                Buffer buf = get_buffer(size, size - dists[j], left);
+                fill_buffer(&buf);
+                move_parallel(buf.dst, buf.src, buf.size);
+                if (!test_buffer(buf)) {
+                    printf("\033[31mmove_parallel failed test for buffer-size %zu (with %zu %s-overlapped bytes and %zu threads) :(\033[0m\n",
+                           size, size - dists[j], left ? "left" : "right", threads);
+                    move_passed = false;
+                }
+                free_buffer(buf);
+            }
+        }
+    }
+    if (copy_passed) printf("\033[32mcopy_parallel passed all tests with %zu threads :)\033[0m\n", threads);
+    if (move_passed) printf("\033[32mmove_parallel passed all tests with %zu threads :)\033[0m\n", threads);
+
+    parallel_min_chunk = min_chunk;
+    if (thread_count < PARALLEL_TEST_THREADS) {
+        pool_deinit(&pool);
+        pool_init(&pool, thread_count);
+    }
+}
+
+typedef struct Checksum_Func {
+    const char *name;
+    ChecksumFuncType func;
+    u32 features;
+    b32 is_crc; // CRC32C or hash64
+} Checksum_Func;
+#define CHECKSUM_FUNC(func, features, is_crc) { AIL_STRINGIFY(func), func, features, is_crc }
+global Checksum_Func checksum_funcs[] = {
+    CHECKSUM_FUNC(copy_crc32c_simd,   CPU_SSE42,               true),
+    CHECKSUM_FUNC(copy_crc32c_avx,    CPU_SSE42 | CPU_AVX,     true),
+    CHECKSUM_FUNC(copy_crc32c_avx512, CPU_SSE42 | CPU_AVX512F, true),
+    CHECKSUM_FUNC(copy_then_crc32c,   CPU_SSE42,               true),
+    CHECKSUM_FUNC(copy_hash64_simd,   0,                       false),
+    CHECKSUM_FUNC(copy_hash64_avx2,   CPU_AVX2,                false),
+    CHECKSUM_FUNC(copy_then_hash64,   0,                       false),
+};
+global u64 checksum_funcs_count;
+
+// Bit by bit, as the reference for the tests
+internal u32 crc32c_ref(const u8 *p, u64 size)
+{
+    u32 crc = 0xffffffff;
+    for (u64 i = 0; i < size; i++) {
+        crc ^= p[i];
+        for (u32 k = 0; k < 8; k++) crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    }
+    return ~crc;
+}
+
+internal u64 hash64_ref(const u8 *p, u64 size)
+{
+    u64 acc[4];
+    memcpy(acc, hash64_seeds, sizeof(acc));
+    for (u64 i = 0; i < size; i += HASH64_STRIPE) {
+        u64 x[4] = {0};
+        memcpy(x, p + i, AIL_MIN(HASH64_STRIPE, size - i));
+        for (u32 l = 0; l < 4; l++) {
+            u64 dk = x[l] ^ hash64_keys[l];
+            acc[l] += (dk & 0xffffffff) * (dk >> 32) + x[l ^ 1];
+        }
+    }
+    return hash64_finish(acc, size);
+}
+
+// Sizes around the blocks of the interleaved CRC streams and the stripes of the hash
+internal void test_checksum(Checksum_Func func)
+{
+    u64 sizes[] = { 0, 1, 7, 8, 9, 31, 32, 33, 100, 3*CRC32C_BLOCK - 1, 3*CRC32C_BLOCK, 3*CRC32C_BLOCK + 9, 10*CRC32C_BLOCK + 13, AIL_KB(64) + 5 };
+    for (u64 i = 0; i < AIL_ARRLEN(sizes); i++) {
+        Buffer buf = get_buffer(AIL_MAX(sizes[i], 1), 0, 0);
+        buf.size = sizes[i];
+        fill_buffer(&buf);
+        u64 checksum = func.func(buf.dst, buf.src, buf.size);
+        u64 expected = func.is_crc ? crc32c_ref(buf.src, buf.size) : hash64_ref(buf.src, buf.size);
+        b32 passed   = test_buffer(buf) && checksum == expected;
+        buf.size = AIL_MAX(sizes[i], 1);
+        free_buffer(buf);
+        if (!passed) {
+            printf("\033[31m%s failed test for buffer-size %zu (checksum 0x%llx instead of 0x%llx) :(\033[0m\n", func.name, sizes[i],
+                   (unsigned long long)checksum, (unsigned long long)expected);
+            return;
+        }
+    }
+    // The check value of CRC32C
+    if (func.is_crc && (u32)func.func((u8[9]){0}, "123456789", 9) != 0xE3069283) {
+        printf("\033[31m%s computed the wrong CRC32C of \"123456789\" :(\033[0m\n", func.name);
+        return;
+    }
+    printf("\033[32m%s passed all tests :)\033[0m\n", func.name);
+}
+
+typedef void (*BatchFuncType)(Copy_Desc *descs, u64 count);
+
+// Copies batches of every size up to 2*COPY_BATCH_MEDIUM_MAX at random offsets, with prefetch distances shorter and longer than the batches
+internal void test_batch(const char *name, BatchFuncType func)
+{
+    u64 max_size = 2*COPY_BATCH_MEDIUM_MAX;
+    persist Copy_Desc descs[2*COPY_BATCH_MEDIUM_MAX + 1];
+    Buffer buf = get_buffer(max_size*(max_size + 1)/2 + AIL_ARRLEN(descs)*64, 0, 0);
+    fill_buffer(&buf);
+    u64 prefetches[] = { 0, 1, COPY_BATCH_PREFETCH, 2*AIL_ARRLEN(descs) };
+    b32 passed = true;
+    for (u64 k = 0; k < AIL_ARRLEN(prefetches) && passed; k++) {
+        // Descriptors are shuffled, so that every size class is followed by every other one
+        u64 off = 0;
+        for (u64 size = 0; size <= max_size; size++) {
+            off += rand() % 64;
+            descs[size] = (Copy_Desc){ .dst = buf.dst + off, .src = buf.src + off, .size = size };
+            off += size;
+        }
+        for (u64 i = AIL_ARRLEN(descs) - 1; i > 0; i--) {
+            u64 j = rand() % (i + 1);
+            Copy_Desc tmp = descs[i];
+            descs[i] = descs[j];
+            descs[j] = tmp;
+        }
+        memset(buf.dst, 0, buf.size);
+        copy_batch_prefetch = prefetches[k];
+        func(descs, AIL_ARRLEN(descs));
+        for (u64 i = 0; i < AIL_ARRLEN(descs) && passed; i++) {
+            if (memcmp(descs[i].dst, descs[i].src, descs[i].size)) {
+                printf("\033[31m%s failed test for a descriptor of size %zu (with a prefetch distance of %zu) :(\033[0m\n", name, descs[i].size, prefetches[k]);
+                passed = false;
+            }
+        }
+    }
+    copy_batch_prefetch = COPY_BATCH_PREFETCH;
+    free_buffer(buf);
+    if (passed) printf("\033[32m%s passed all tests :)\033[0m\n", name);
+}
+
+global Bench_Driver  bench_driver;
+global Bench_Export  bench_export;
+global Bench_Samples bench_samples[2*MAX_FUNC_COUNT]; // One list of samples per function in copy_funcs/move_funcs (and page kind with -compare-pages)
+
+// Amount of memory touched by copying/moving the buffer
+internal u64 buffer_working_set(Buffer buf)
+{
+    return 2*buf.size - buf.overlap_size;
+}
+
+// Exports the samples of all functions in the list for the given buffer and resets them for the next buffer
+internal void export_func_samples(Func *funcs, u64 count, Buffer buf, const char *params, Bench_Samples *samples)
+{
+    for (u64 i = 0; i < count; i++) {
+        Bench_Key key = {
+            .kernel     = funcs[i].name,
+            .params     = params,
+            .size       = buf.size,
+            .overlap    = buf.overlap_size,
+            .src_offset = (u64)buf.src % 4096,
+            .dst_offset = (u64)buf.dst % 4096,
+            .level      = bench_level_names[bench_cache_level(buffer_working_set(buf))],
+            .pages      = page_kind_names[buf.pages],
+        };
+        bench_export_samples(&bench_export, key, &samples[i]);
+    }
+}
+
+typedef struct Bench_Ctx {
+    Func  *funcs;
+    Buffer buf;
+} Bench_Ctx;
+
+internal void bench_run_func(void *ctx, u64 idx)
+{
+    Bench_Ctx *c = ctx;
+    c->funcs[idx].func(c->buf.dst, c->buf.src, c->buf.size);
+}
+
+// Measures all functions in the list on the given buffer with the benchmark driver and exports the results
+// Returns the index of the function with the lowest median time, which is written to fastest_median if it isn't 0
+internal u64 bench_funcs(Func *funcs, u64 count, Buffer buf, u64 *fastest_median)
+{
+    Bench_Ctx ctx = { funcs, buf };
+    bench_driver_run(&bench_driver, bench_run_func, &ctx, bench_samples, count);
+    u64 fastest = bench_fastest(bench_samples, count);
+    if (fastest_median) *fastest_median = bench_stats(&bench_samples[fastest]).median;
+    export_func_samples(funcs, count, buf, 0, bench_samples);
+    return fastest;
+}
+
+// Sweeps from MIN_BUFFER_SIZE to MAX_BUFFER_SIZE in steps of powers of 4
+internal void bench_powers_of_4(void)
+{
+#ifdef BENCH_PER_BUF_SIZE
+    for (u64 i = 0, size = MIN_BUFFER_SIZE, overlap = 4; size <= MAX_BUFFER_SIZE; size <<= 2, overlap <<= 1, i++) {
+        Buffer buffers[] = {
+            get_buffer(size, 0, 0),
+            get_buffer(size, overlap, i & 1),
+            get_buffer(size, size - overlap, !(i & 1)),
+        };
+        char mem_size[12];
+        get_printable_mem_size(mem_size, size);
+        printf("Benchmark Results for Copying %s of memory\n", mem_size);
+        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) {
+            Buffer buf = buffers[j];
+            if (!buf.overlap_size) {
+                fill_buffer(&buf);
+                ail_bench_begin_profile();
+                bench_funcs(copy_funcs, copy_funcs_count, buf, 0);
+                ail_bench_end_and_print_profile(1, true);
+            }
+        }
+        printf("-----------\n");
+        printf("Benchmark Results for Moving %s of memory\n", mem_size);
+        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) {
+            Buffer buf = buffers[j];
+            fill_buffer(&buf);
+            printf("With %zu overlapped bytes:\n", buf.overlap_size);
+            ail_bench_begin_profile();
+            bench_funcs(move_funcs, move_funcs_count, buf, 0);
+            ail_bench_end_and_print_profile(1, true);
+        }
+        printf("-----------\n");
+        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) free_buffer(buffers[j]);
+    }
+#else
+    char mem_min_size[12], mem_max_size[12];
+    get_printable_mem_size(mem_min_size, MIN_BUFFER_SIZE);
+    get_printable_mem_size(mem_max_size, MAX_BUFFER_SIZE);
+    printf("Benchmark Results for Copying %s to %s memory\n", mem_min_size, mem_max_size);
+    ail_bench_begin_profile();
+    for (u64 size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size <<= 2) {
+        Buffer buf = get_buffer(size, 0, 0);
+        fill_buffer(&buf);
+        bench_funcs(copy_funcs, copy_funcs_count, buf, 0);
+        free_buffer(buf);
+    }
+    ail_bench_end_and_print_profile(1, true);
+    printf("-----------\n");
+    printf("Benchmark Results for Moving %s to %s of variously overlapped memory\n", mem_min_size, mem_max_size);
+    ail_bench_begin_profile();
+    for (u64 i = 0, size = MIN_BUFFER_SIZE, overlap = 4; size <= MAX_BUFFER_SIZE; size <<= 2, overlap <<= 1, i++) {
+        Buffer buffers[] = {
+            get_buffer(size, 0, 0),
+            get_buffer(size, overlap, i & 1),
+            get_buffer(size, size - overlap, !(i & 1)),
+        };
+        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) {
+            Buffer buf = buffers[j];
+            fill_buffer(&buf);
+            bench_funcs(move_funcs, move_funcs_count, buf, 0);
+        }
+        for (u64 j = 0; j < AIL_ARRLEN(buffers); j++) free_buffer(buffers[j]);
+    }
+    ail_bench_end_and_print_profile(1, true);
+#endif
+}
+
+// Benchmarks the generated kernels from MIN_BUFFER_SIZE to MAX_BUFFER_SIZE in steps of powers of 4 and prints the fastest
+// configuration per size (GB/s by median time), next to the fastest of the remaining routines for comparison
+// Moves overlap by half their size, with dst above src on every other size
+internal void bench_generated(void)
+{
+    persist Func lists[4][MAX_FUNC_COUNT]; // Generated copies, other copies, generated moves, other moves
+    u64 counts[4] = {0};
+    for (u64 i = 0; i < copy_funcs_count; i++) {
+        u32 k = strncmp(copy_funcs[i].name, "copy_gen_", 9) ? 1 : 0;
+        lists[k][counts[k]++] = copy_funcs[i];
+    }
+    for (u64 i = 0; i < move_funcs_count; i++) {
+        u32 k = strncmp(move_funcs[i].name, "move_gen_", 9) ? 3 : 2;
+        lists[k][counts[k]++] = move_funcs[i];
+    }
+    if (!counts[0]) {
+        printf("\033[33mNo generated kernels to benchmark (GENERATED_KERNELS isn't defined)\033[0m\n");
+        return;
+    }
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+    printf("Fastest generated kernels against the fastest other routines (GB/s by median time)\n");
+    printf("%8s | %-28s %8s | %-28s %8s | %-28s %8s | %-28s %8s\n", "size", "generated copy", "", "other copy", "", "generated move", "", "other move", "");
+    for (u64 i = 0, size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size <<= 2, i++) {
+        Buffer bufs[2] = { get_buffer(size, 0, 0), get_buffer(size, size/2, i & 1) };
+        // The driver prints warnings while measuring, so the row is printed once all lists are done
+        u64 fastest[4], median[4];
+        for (u32 k = 0; k < 4; k++) {
+            Buffer buf = bufs[k / 2];
+            fill_buffer(&buf);
+            fastest[k] = bench_funcs(lists[k], counts[k], buf, &median[k]);
+        }
+        char mem_size[12];
+        get_printable_mem_size(mem_size, size);
+        printf("%8s |", mem_size);
+        for (u32 k = 0; k < 4; k++) {
+            printf(" %-28s %8.2f%s", lists[k][fastest[k]].name, (f64)size / (f64)median[k] * (f64)cpu_freq / 1e9, k < 3 ? " |" : "\n");
+        }
+        free_buffer(bufs[0]);
+        free_buffer(bufs[1]);
+    }
+    printf("-----------\n");
+}
+
+global u64 align_bench_sizes[] = { 256, AIL_KB(4), AIL_KB(64) };
+
+// Benchmarks every routine with all combinations of the src and dst offsets from bench_alignment_offsets and
+// prints a heat map of the median GB/s for each routine and size in align_bench_sizes
+// Copies use distinct buffers, moves overlap by roughly half their size
+internal void bench_alignment(u64 step)
+{
+    u64 offsets[66];
+    u64 n = bench_alignment_offsets(offsets, AIL_ARRLEN(offsets), step);
+    f64 *gb_per_s = malloc(MAX_FUNC_COUNT*n*n*sizeof(*gb_per_s));
+    u64 cpu_freq  = ail_bench_cpu_timer_freq();
+    for (u64 i = 0; i < AIL_ARRLEN(align_bench_sizes); i++) {
+        u64 size = align_bench_sizes[i];
+        for (u32 is_move = 0; is_move < 2; is_move++) {
+            Func *funcs = is_move ? move_funcs : copy_funcs;
+            u64  count  = is_move ? move_funcs_count : copy_funcs_count;
+            // Moves place dst at the position closest to half the size behind src that has the offset of dst into its page,
+            // which may also be in front of src, so how much they overlap depends on the offsets (and small sizes may not overlap)
+            // src starts a page into its region, so that both regions have room for all offsets
+            Buffer base = get_buffer(2*size + 3*4096, 0, 0);
+            u64 min_overlap = size, max_overlap = 0;
+            for (u64 si = 0; si < n; si++) {
+                for (u64 di = 0; di < n; di++) {
+                    Buffer buf = { .size = size, .pages = base.pages };
+                    buf.src = base.src + 4096 + offsets[si];
+                    if (is_move) {
+                        i64 shift = (i64)((offsets[di] - offsets[si] - size/2) & 4095);
+                        if (shift >= 2048 && (i64)(size/2) + shift - 4096 != 0) shift -= 4096; // dst mustn't be src
+                        buf.dst   = buf.src + size/2 + shift;
+                    } else {
+                        buf.dst = base.dst + offsets[di];
+                    }
+                    u64 dist = buf.dst > buf.src ? (u64)(buf.dst - buf.src) : (u64)(buf.src - buf.dst);
+                    buf.overlap_size = is_move && dist < size ? size - dist : 0;
+                    min_overlap = AIL_MIN(min_overlap, buf.overlap_size);
+                    max_overlap = AIL_MAX(max_overlap, buf.overlap_size);
+                    fill_buffer(&buf);
+                    Bench_Ctx ctx = { funcs, buf };
+                    bench_driver_run(&bench_driver, bench_run_func, &ctx, bench_samples, count);
+                    for (u64 k = 0; k < count; k++) {
+                        u64 median = bench_stats(&bench_samples[k]).median;
+                        gb_per_s[(k*n + si)*n + di] = median ? (f64)size / (f64)median * (f64)cpu_freq / 1e9 : 0;
+                    }
+                    export_func_samples(funcs, count, buf, 0, bench_samples);
+                }
+            }
+            free_buffer(base);
+
+            char overlap[64] = "";
+            if (is_move) snprintf(overlap, sizeof(overlap), " (overlapping by %zu to %zu bytes)", min_overlap, max_overlap);
+            for (u64 k = 0; k < count; k++) {
+                printf("%s of %zu bytes%s in GB/s:\n", funcs[k].name, size, overlap);
+                bench_print_heat_map("src", offsets, n, "dst", offsets, n, &gb_per_s[k*n*n]);
+            }
+            printf("-----------\n");
+        }
+    }
+    free(gb_per_s);
+}
+
+typedef struct Pages_Ctx {
+    Func  *funcs;
+    u64    count;
+    Buffer bufs[2]; // Backed by 4K pages and by huge pages
+} Pages_Ctx;
+
+// Routines [0, count) run on the 4K buffer and [count, 2*count) on the huge-page buffer
+internal void bench_run_pages(void *ctx, u64 idx)
+{
+    Pages_Ctx *c = ctx;
+    Buffer buf = c->bufs[idx / c->count];
+    c->funcs[idx % c->count].func(buf.dst, buf.src, buf.size);
+}
+
+// Benchmarks every routine on buffers backed by 4K pages and by huge pages of the given kind and prints
+// their median bandwidths side by side
+// Both buffers are measured in the same run of the driver, so that both page sizes see the same conditions
+internal void bench_compare_pages(Page_Kind huge)
+{
+    persist f64 gb_per_s[2*MAX_FUNC_COUNT];
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+    Page_Kind prev_pages = buffer_pages;
+    printf("Comparing 4K pages against %s pages\n", page_kind_names[huge]);
+    for (u64 size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size <<= 2) {
+        for (u32 is_move = 0; is_move < 2; is_move++) {
+            Pages_Ctx ctx = {
+                .funcs = is_move ? move_funcs : copy_funcs,
+                .count = is_move ? move_funcs_count : copy_funcs_count,
+            };
+            for (u32 k = 0; k < 2; k++) {
+                buffer_pages = k ? huge : PAGES_4K;
+                ctx.bufs[k]  = get_buffer(size, is_move ? size/2 : 0, 0);
+                fill_buffer(&ctx.bufs[k]);
+            }
+            bench_driver_run(&bench_driver, bench_run_pages, &ctx, bench_samples, 2*ctx.count);
+            for (u64 i = 0; i < 2*ctx.count; i++) {
+                u64 median  = bench_stats(&bench_samples[i]).median;
+                gb_per_s[i] = median ? (f64)size / (f64)median * (f64)cpu_freq / 1e9 : 0;
+            }
+
+            char mem_size[12];
+            get_printable_mem_size(mem_size, size);
+            printf("%s %s%s (GB/s by median time):\n", is_move ? "Moving" : "Copying", mem_size, is_move ? " overlapping by half" : "");
+            printf("  %-28s %10s %10s %8s\n", "routine", "4K", page_kind_names[ctx.bufs[1].pages], "change");
+            for (u64 i = 0; i < ctx.count; i++) {
+                f64 small = gb_per_s[i], large = gb_per_s[ctx.count + i];
+                printf("  %-28s %10.2f %10.2f %+7.1f%%\n", ctx.funcs[i].name, small, large, small ? (large/small - 1)*100 : 0);
+            }
+            for (u32 k = 0; k < 2; k++) {
+                export_func_samples(ctx.funcs, ctx.count, ctx.bufs[k], 0, &bench_samples[k*ctx.count]);
+                free_buffer(ctx.bufs[k]);
+            }
+        }
+        printf("-----------\n");
+    }
+    buffer_pages = prev_pages;
+}
+
+// Measures the first call of each routine on freshly mapped buffers, including the page faults of dst, and compares it
+// against the steady state of repeated calls on a buffer whose pages were all touched beforehand
+// Each cold call gets its own buffers and the routines take turns in a new random order each round, so no routine
+// benefits from faults that were taken by another one
+internal void bench_cold_warm(void)
+{
+    persist u64 order[MAX_FUNC_COUNT];
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+    const char *cold_params = buffer_populate ? "cold,populate" : "cold";
+    printf("Comparing cold calls on fresh buffers%s against warm calls\n", buffer_populate ? " (prefaulted with MAP_POPULATE)" : "");
+    for (u64 size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size <<= 2) {
+        for (u32 is_move = 0; is_move < 2; is_move++) {
+            Func *funcs   = is_move ? move_funcs : copy_funcs;
+            u64   count   = is_move ? move_funcs_count : copy_funcs_count;
+            u64   overlap = is_move ? size/2 : 0;
+            Bench_Samples *cold = bench_samples, *warm = &bench_samples[count];
+            Buffer buf = {0};
+
+            for (u64 i = 0; i < count; i++) order[i] = i;
+            for (u64 rep = 0; rep < bench_driver.min_reps; rep++) {
+                for (u64 i = count - 1; i > 0; i--) {
+                    u64 j = (u64)rand() % (i + 1);
+                    u64 tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+                }
+                for (u64 i = 0; i < count; i++) {
+                    u64 k = order[i];
+                    buf = get_buffer(size, overlap, rep & 1);
+                    fill_source(&buf);
+                    if (bench_perf.count) BENCH_TIME_COUNTERS(&cold[k], funcs[k].func(buf.dst, buf.src, buf.size));
+                    else                  BENCH_TIME(&cold[k], funcs[k].func(buf.dst, buf.src, buf.size));
+                    free_buffer(buf);
+                }
+            }
+
+            buf = get_buffer(size, overlap, 0);
+            fill_buffer(&buf);
+            Bench_Ctx ctx = { funcs, buf };
+            bench_driver_run(&bench_driver, bench_run_func, &ctx, warm, count);
+
+            char mem_size[12];
+            get_printable_mem_size(mem_size, size);
+            printf("%s %s%s (median time):\n", is_move ? "Moving" : "Copying", mem_size, is_move ? " overlapping by half" : "");
+            printf("  %-28s %12s %10s | %12s %10s | %8s\n", "routine", "cold us", "GB/s", "warm us", "GB/s", "cold/warm");
+            for (u64 i = 0; i < count; i++) {
+                u64 c = bench_stats(&cold[i]).median, w = bench_stats(&warm[i]).median;
+                printf("  %-28s %12.3f %10.2f | %12.3f %10.2f | %8.2fx\n", funcs[i].name,
+                       ail_bench_cpu_elapsed_to_ms(c)*1000, c ? (f64)size / (f64)c * (f64)cpu_freq / 1e9 : 0,
+                       ail_bench_cpu_elapsed_to_ms(w)*1000, w ? (f64)size / (f64)w * (f64)cpu_freq / 1e9 : 0,
+                       w ? (f64)c / (f64)w : 0);
+            }
+            export_func_samples(funcs, count, buf, cold_params, cold);
+            export_func_samples(funcs, count, buf, "warm", warm);
+            free_buffer(buf);
+        }
+        printf("-----------\n");
+    }
+}
+
+typedef struct Remap_Ctx {
+    Func *funcs;
+    u64   size;
+    u8   *dst[3]; // Per routine, the remapping routine (index 0) gets its own buffers, so that the others never see its empty pages
+    u8   *src[3];
+    b32   is_move;
+    b32   swapped;
+} Remap_Ctx;
+
+// move_remap alternates its direction, so that its src always holds the pages that it moved last time
+internal void bench_run_remap(void *ctx, u64 idx)
+{
+    Remap_Ctx *c = ctx;
+    b32 swapped = !idx && c->swapped;
+    if (swapped) c->funcs[idx].func(c->src[idx], c->dst[idx], c->size);
+    else         c->funcs[idx].func(c->dst[idx], c->src[idx], c->size);
+    if (!idx) c->swapped ^= c->is_move;
+}
+
+// Benchmarks move_remap and copy_cow against the byte-copying procedures from one page up to MAX_BUFFER_SIZE in steps of
+// powers of 2 and reports the smallest size from which on remapping is always the fastest
+internal void bench_remap(void)
+{
+    persist u64 sizes[64];
+    persist u64 medians[64][2][AIL_ARRLEN(remap_copy_funcs)];
+    u64 count = 0;
+    for (u64 size = REMAP_PAGE_SIZE; size <= MAX_BUFFER_SIZE && count < AIL_ARRLEN(sizes); size <<= 1) sizes[count++] = size;
+    printf("Benchmark Results for remapping pages instead of copying them (median time in us)\n");
+    printf("%12s |", "size");
+    for (u64 k = 0; k < AIL_ARRLEN(remap_copy_funcs); k++) printf(" %14s", remap_copy_funcs[k].name);
+    printf(" |");
+    for (u64 k = 0; k < AIL_ARRLEN(remap_move_funcs); k++) printf(" %14s", remap_move_funcs[k].name);
+    printf("\n");
+    for (u64 i = 0; i < count; i++) {
+        u64 size = sizes[i];
+        for (u32 is_move = 0; is_move < 2; is_move++) {
+            Remap_Ctx ctx = { .funcs = is_move ? remap_move_funcs : remap_copy_funcs, .size = size, .is_move = is_move };
+            // Copies share their src, which is backed by a memfd for copy_cow
+            Buffer own = get_buffer(size, 0, 0), shared = get_buffer(size, 0, 0);
+            u8 *cow_src = is_move ? 0 : cow_alloc(size);
+            for (u64 k = 0; k < AIL_ARRLEN(ctx.dst); k++) {
+                ctx.dst[k] = k ? shared.dst : own.dst;
+                ctx.src[k] = cow_src ? cow_src : k ? shared.src : own.src;
+            }
+            Buffer fill[] = {
+                { .size = size, .dst = own.dst,    .src = ctx.src[0] },
+                { .size = size, .dst = shared.dst, .src = ctx.src[1] },
+            };
+            fill_buffer(&fill[0]);
+            fill_buffer(&fill[1]);
+            bench_driver_run(&bench_driver, bench_run_remap, &ctx, bench_samples, AIL_ARRLEN(ctx.dst));
+            for (u64 k = 0; k < AIL_ARRLEN(ctx.dst); k++) medians[i][is_move][k] = bench_stats(&bench_samples[k]).median;
+            Buffer key_buf = { .size = size, .dst = ctx.dst[0], .src = ctx.src[0], .pages = shared.pages };
+            export_func_samples(ctx.funcs, AIL_ARRLEN(ctx.dst), key_buf, cow_src ? "memfd" : 0, bench_samples);
+            if (cow_src) cow_free(cow_src);
+            free_buffer(own);
+            free_buffer(shared);
+        }
+#if defined(__linux__)
+        // The measured times of such calls don't include mapping src again, so the results of this size are dropped
+        if (remap_lost_src_count) {
+            printf("\033[31mStopping, since move_remap couldn't map its src again %zu times :(\033[0m\n", remap_lost_src_count);
+            count = i;
+            break;
+        }
+#endif
+        printf("%12zu |", size);
+        for (u32 is_move = 0; is_move < 2; is_move++) {
+            for (u64 k = 0; k < AIL_ARRLEN(remap_copy_funcs); k++) printf(" %14.3f", ail_bench_cpu_elapsed_to_ms(medians[i][is_move][k])*1000);
+            printf(is_move ? "\n" : " |");
+        }
+    }
+    for (u32 is_move = 0; is_move < 2; is_move++) {
+        // The crossover is the smallest size from which on the remapping procedure beats both others at every size
+        u64 crossover = 0;
+        for (u64 i = count; i > 0; i--) {
+            u64 *m = medians[i - 1][is_move];
+            if (m[0] >= m[1] || m[0] >= m[2]) break;
+            crossover = sizes[i - 1];
+        }
+        const char *name = is_move ? remap_move_funcs[0].name : remap_copy_funcs[0].name;
+        if (crossover) {
+            char mem_size[12];
+            get_printable_mem_size(mem_size, crossover);
+            printf("%s is the fastest from %s on\n", name, mem_size);
+        } else if (count) {
+            printf("%s is slower than copying the bytes at %zu bytes\n", name, sizes[count - 1]);
+        }
+    }
+    printf("-----------\n");
+}
+
+typedef struct Prefetch_Ctx {
+    Buffer buf;
+    FuncType func;
+    u32 stream;
+    Prefetch_Setting *candidates;
+} Prefetch_Ctx;
+
+// Every call runs the kernel with another candidate setting for the size class of the buffer
+internal void bench_run_prefetch(void *ctx, u64 idx)
+{
+    Prefetch_Ctx *c = ctx;
+    prefetch_table.settings[c->stream][size_class(c->buf.size)] = c->candidates[idx];
+    c->func(c->buf.dst, c->buf.src, c->buf.size);
+}
+
+// Measures the forward, backward and two-ended prefetching copies with every candidate distance and hint on powers of 4 from 4KB
+// to MAX_BUFFER_SIZE, one size per band of size classes, and stores the fastest setting of each stream and band in `path`
+// The widest supported kernels are tuned and the settings apply to the SSE and AVX versions alike
+internal void bench_prefetch_tune(const char *path)
+{
+    FuncType kernels[2][PREFETCH_STREAM_COUNT] = {
+        { copy_simd_prefetch, copy_simd_backwards_prefetch, copy_simd_two_ended_prefetch },
+        { copy_avx_prefetch,  copy_avx_backwards_prefetch,  copy_avx_two_ended_prefetch },
+    };
+    b32 avx = cpu_supports(CPU_AVX);
+    Prefetch_Setting candidates[2*AIL_ARRLEN(prefetch_distances)];
+    u32 candidate_count = prefetch_candidates(candidates);
+    b32 tuned[PREFETCH_STREAM_COUNT][SIZE_CLASS_COUNT] = {0};
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+
+    printf("Tuning the prefetch distance of the %s copies (GB/s by median time without prefetching and with the best setting)\n", avx ? "AVX" : "SSE");
+    printf("%8s |", "");
+    for (u32 k = 0; k < PREFETCH_STREAM_COUNT; k++) printf(" %-28s |", prefetch_stream_names[k]);
+    printf("\n%8s |", "size");
+    for (u32 k = 0; k < PREFETCH_STREAM_COUNT; k++) printf(" %8s %8s %-10s |", "none", "best", "setting");
+    printf("\n");
+    for (u64 size = AIL_KB(4); size <= MAX_BUFFER_SIZE; size <<= 2) {
+        Buffer buf = get_buffer(size, 0, 0);
+        fill_buffer(&buf);
+        // The driver prints warnings while measuring, so the row is printed once all streams are done
+        f64 gb_per_s[PREFETCH_STREAM_COUNT][2];
+        for (u32 k = 0; k < PREFETCH_STREAM_COUNT; k++) {
+            Prefetch_Ctx ctx = { buf, kernels[avx][k], k, candidates };
+            bench_driver_run(&bench_driver, bench_run_prefetch, &ctx, bench_samples, candidate_count);
+            u64 best = bench_fastest(bench_samples, candidate_count);
+            u64 best_median = bench_stats(&bench_samples[best]).median;
+            u64 none_median = bench_stats(&bench_samples[0]).median;
+            u32 c = size_class(size);
+            prefetch_table.settings[k][c] = candidates[best];
+            tuned[k][c] = true;
+            gb_per_s[k][0] = (f64)size / (f64)none_median * (f64)cpu_freq / 1e9;
+            gb_per_s[k][1] = (f64)size / (f64)best_median * (f64)cpu_freq / 1e9;
+            for (u32 i = 0; i < candidate_count; i++) {
+                char params[48];
+                snprintf(params, sizeof(params), "distance=%zu,hint=%s", candidates[i].distance, prefetch_hint_names[candidates[i].hint]);
+                Bench_Key key = { .kernel = prefetch_stream_names[k], .params = params, .size = size, .level = bench_level_names[bench_cache_level(2*size)], .pages = page_kind_names[buf.pages] };
+                bench_export_samples(&bench_export, key, &bench_samples[i]);
+            }
+        }
+        char mem_size[12];
+        get_printable_mem_size(mem_size, size);
+        printf("%8s |", mem_size);
+        for (u32 k = 0; k < PREFETCH_STREAM_COUNT; k++) {
+            Prefetch_Setting best = prefetch_table.settings[k][size_class(size)];
+            char setting[16];
+            snprintf(setting, sizeof(setting), "%zu %s", best.distance, best.distance ? prefetch_hint_names[best.hint] : "");
+            printf(" %8.2f %8.2f %-10s |", gb_per_s[k][0], gb_per_s[k][1], setting);
+        }
+        printf("\n");
+        free_buffer(buf);
+    }
+    printf("-----------\n");
+    for (u32 k = 0; k < PREFETCH_STREAM_COUNT; k++) prefetch_table_spread(&prefetch_table, k, tuned[k]);
+    if (prefetch_table_save(&prefetch_table, path)) printf("Saved prefetch distances to %s\n", path);
+    else printf("\033[31mFailed to save prefetch distances to %s\033[0m\n", path);
+}
+
+global volatile u64 checksum_sink; // Keeps the checksums from being optimized away
+
+internal void bench_run_checksum(void *ctx, u64 idx)
+{
+    Buffer *buf = ctx;
+    checksum_sink ^= checksum_funcs[idx].func(buf->dst, buf->src, buf->size);
+}
+
+// Benchmarks the fused copies against copy_builtin followed by a separate checksum pass from MIN_BUFFER_SIZE to MAX_BUFFER_SIZE
+// and prints the median GB/s of each routine per size, as well as the speedup of the fastest fused copy over the two passes
+internal void bench_checksum(void)
+{
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+    printf("Benchmark Results for copying and checksumming memory (median GB/s)\n");
+    printf("%12s |", "size");
+    for (u64 i = 0; i < checksum_funcs_count; i++) printf(" %18s", checksum_funcs[i].name);
+    printf(" | %10s %10s\n", "crc fused", "hash fused");
+    for (u64 size = MIN_BUFFER_SIZE; size <= MAX_BUFFER_SIZE; size <<= 2) {
+        Buffer buf = get_buffer(size, 0, 0);
+        fill_buffer(&buf);
+        bench_driver_run(&bench_driver, bench_run_checksum, &buf, bench_samples, checksum_funcs_count);
+
+        // Speedup of the fastest fused routine of each kind over the two-pass routine of that kind
+        u64 fused[2] = { (u64)-1, (u64)-1 }, two_pass[2] = {0};
+        printf("%12zu |", size);
+        for (u64 i = 0; i < checksum_funcs_count; i++) {
+            u64 median = bench_stats(&bench_samples[i]).median;
+            b32 is_crc = checksum_funcs[i].is_crc;
+            if (!strncmp(checksum_funcs[i].name, "copy_then_", 10)) two_pass[is_crc] = median;
+            else fused[is_crc] = AIL_MIN(fused[is_crc], median);
+            printf(" %18.2f", median ? (f64)size / (f64)median * (f64)cpu_freq / 1e9 : 0);
+            Bench_Key key = { .kernel = checksum_funcs[i].name, .params = "checksum", .size = size, .level = bench_level_names[bench_cache_level(2*size)], .pages = page_kind_names[buf.pages] };
+            bench_export_samples(&bench_export, key, &bench_samples[i]);
+        }
+        printf(" | %9.2fx %9.2fx\n", two_pass[1] && fused[1] != (u64)-1 ? (f64)two_pass[1] / (f64)fused[1] : 0,
+               two_pass[0] && fused[0] != (u64)-1 ? (f64)two_pass[0] / (f64)fused[0] : 0);
+        free_buffer(buf);
+    }
+    printf("-----------\n");
+}
+
+// Copying a batch descriptor by descriptor with the regular procedures, which is what copy_batch replaces
+// These pay for the profiler on each call, batch_each_memcpy shows the cost of unprofiled calls
+internal void batch_each_copy_simd(Copy_Desc *descs, u64 count)    { for (u64 i = 0; i < count; i++) copy_simd(descs[i].dst, descs[i].src, descs[i].size); }
+internal void batch_each_copy_builtin(Copy_Desc *descs, u64 count) { for (u64 i = 0; i < count; i++) copy_builtin(descs[i].dst, descs[i].src, descs[i].size); }
+internal void batch_each_memcpy(Copy_Desc *descs, u64 count)       { for (u64 i = 0; i < count; i++) memcpy(descs[i].dst, descs[i].src, descs[i].size); }
+CPU_TARGET("avx") internal void copy_batch_avx_no_prefetch(Copy_Desc *descs, u64 count) { copy_batch_avx_inline(descs, count, 0); }
+
+typedef struct Batch_Func {
+    const char *name;
+    BatchFuncType func;
+    u32 features;
+} Batch_Func;
+global Batch_Func batch_funcs[] = {
+    FUNC(batch_each_copy_simd),
+    FUNC(batch_each_copy_builtin),
+    FUNC(batch_each_memcpy),
+    FUNC(copy_batch),
+    FUNC_REQUIRES(copy_batch_avx,             CPU_AVX),
+    FUNC_REQUIRES(copy_batch_avx_no_prefetch, CPU_AVX),
+};
+
+// Sizes of the fields of typical messages: mostly integers, flags and short strings, with the occasional larger blob
+typedef struct Batch_Bucket {
+    u64 min, max;
+    u32 per_mille;
+} Batch_Bucket;
+global Batch_Bucket batch_buckets[] = {
+    { 1,    8,          400 },
+    { 9,    32,         300 },
+    { 33,   128,        200 },
+    { 129,  512,        80 },
+    { 513,  AIL_KB(2),  18 },
+    { AIL_KB(2) + 1, AIL_KB(16), 2 },
+};
+global u64 batch_arena_sizes[] = { AIL_KB(256), AIL_MB(256) };
+
+typedef struct Batch_Ctx {
+    Copy_Desc *descs;   // Pool of descriptors, each call copies the next `batch_size` of them
+    u64 pool_size;
+    u64 batch_size;
+    u64 next[AIL_ARRLEN(batch_funcs)];
+} Batch_Ctx;
+
+internal void bench_run_batch(void *ctx, u64 idx)
+{
+    Batch_Ctx *c = ctx;
+    batch_funcs[idx].func(c->descs + c->next[idx], c->batch_size);
+    c->next[idx] = (c->next[idx] + c->batch_size) % c->pool_size;
+}
+
+// Copies batches of fields with random sizes from random places of an arena into a packed output frame
+// Every batch writes into the same frame, while the sources of the pool of batches are spread over the whole arena,
+// so that they miss the caches once the arena doesn't fit into them anymore
+internal void bench_batch(u64 batch_size)
+{
+    persist Batch_Func funcs[AIL_ARRLEN(batch_funcs)];
+    u64 count = 0;
+    for (u64 i = 0; i < AIL_ARRLEN(batch_funcs); i++) {
+        if (cpu_supports(batch_funcs[i].features)) funcs[count++] = batch_funcs[i];
+    }
+    memcpy(batch_funcs, funcs, count*sizeof(*funcs));
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+    batch_size   = AIL_MAX(batch_size, 1);
+    for (u64 a = 0; a < AIL_ARRLEN(batch_arena_sizes); a++) {
+        u64 arena_size = batch_arena_sizes[a];
+        // The pool touches each line of the arena about twice, so that the sources of consecutive calls differ
+        u64 pool_size  = AIL_MAX(1, AIL_MIN(arena_size / 32, AIL_MB(2)) / batch_size) * batch_size;
+        Page_Kind pages;
+        Copy_Desc *descs = pages_alloc(pool_size*sizeof(Copy_Desc), PAGES_4K, 0, &pages);
+        u8 *arena = pages_alloc(arena_size, buffer_pages, 0, &pages);
+        for (u64 i = 0; i < arena_size; i++) arena[i] = (u8)i;
+
+        u64 frame_size = 0, total = 0;
+        for (u64 b = 0; b < pool_size; b += batch_size) {
+            u64 off = 0;
+            for (u64 i = b; i < b + batch_size; i++) {
+                u32 r = (u32)rand() % 1000;
+                u64 k = 0;
+                while (r >= batch_buckets[k].per_mille) r -= batch_buckets[k++].per_mille;
+                u64 size = batch_buckets[k].min + (u64)rand() % (batch_buckets[k].max - batch_buckets[k].min + 1);
+                descs[i] = (Copy_Desc){ .dst = (void*)off, .src = arena + ((u64)rand()*RAND_MAX + (u64)rand()) % (arena_size - size), .size = size };
+                off   += size;
+                total += size;
+            }
+            frame_size = AIL_MAX(frame_size, off);
+        }
+        u8 *frame = pages_alloc(frame_size, PAGES_4K, 0, &pages);
+        memset(frame, 0, frame_size);
+        for (u64 i = 0; i < pool_size; i++) descs[i].dst = frame + (u64)descs[i].dst;
+
+        Batch_Ctx ctx = { .descs = descs, .pool_size = pool_size, .batch_size = batch_size };
+        bench_driver_run(&bench_driver, bench_run_batch, &ctx, bench_samples, count);
+
+        char arena_str[12], params[64];
+        get_printable_mem_size(arena_str, arena_size);
+        snprintf(params, sizeof(params), "arena=%s,batch=%zu", arena_str, batch_size);
+        u64 bytes_per_batch = total / (pool_size / batch_size);
+        printf("Copying batches of %zu fields (%zu bytes on average) from an arena of %s (median time):\n", batch_size, bytes_per_batch, arena_str);
+        printf("  %-28s %12s %10s %10s %8s\n", "routine", "us/batch", "ns/field", "GB/s", "speedup");
+        u64 base = bench_stats(&bench_samples[0]).median;
+        for (u64 i = 0; i < count; i++) {
+            u64 median = bench_stats(&bench_samples[i]).median;
+            f64 us     = ail_bench_cpu_elapsed_to_ms(median)*1000;
+            printf("  %-28s %12.3f %10.2f %10.2f %7.2fx\n", batch_funcs[i].name, us, us*1000 / (f64)batch_size,
+                   median ? (f64)bytes_per_batch / (f64)median * (f64)cpu_freq / 1e9 : 0, median ? (f64)base / (f64)median : 0);
+            Bench_Key key = { .kernel = batch_funcs[i].name, .params = params, .size = bytes_per_batch, .pages = page_kind_names[pages] };
+            bench_export_samples(&bench_export, key, &bench_samples[i]);
+        }
+        printf("-----------\n");
+        pages_free(frame, frame_size, PAGES_4K);
+        pages_free(arena, arena_size, pages);
+        pages_free(descs, pool_size*sizeof(Copy_Desc), PAGES_4K);
+    }
+}
+
+#if defined(__linux__)
+// The raw syscalls and O_DIRECT fallback avoid depending on _GNU_SOURCE being defined before the first include
+#ifndef O_DIRECT
+#   define O_DIRECT __O_DIRECT
+#endif
+#ifndef F_SETPIPE_SZ
+#   define F_SETPIPE_SZ 1031
+#endif
+#define FILE_IO_ALIGN 4096 // O_DIRECT requires buffers, offsets and sizes to be aligned to the logical block size
+
+typedef struct File_Job {
+    int src;        // Both files are opened twice, once with the page cache and once with O_DIRECT
+    int dst;
+    int src_direct; // -1 if the file system doesn't support O_DIRECT
+    int dst_direct;
+    u8 *buf;        // Destination of the file->buffer backends with `size` bytes
+    u8 *chunks;     // `depth` chunks of `chunk_size` bytes for the chunked backends
+    u64 size;
+    u64 chunk_size;
+    u32 depth;
+} File_Job;
+
+typedef b32 (*File_Func)(File_Job *job);
+
+typedef struct File_Backend {
+    const char *name;
+    File_Func func;
+} File_Backend;
+#define FILE_BACKEND(func) { AIL_STRINGIFY(func), func }
+
+internal b32 file_copy_chunked(int src, int dst, u8 *chunk, u64 size, u64 chunk_size)
+{
+    for (u64 off = 0; off < size;) {
+        ssize_t n = pread(src, chunk, AIL_MIN(chunk_size, size - off), (off_t)off);
+        if (n <= 0 || pwrite(dst, chunk, (u64)n, (off_t)off) != n) return false;
+        off += (u64)n;
+    }
+    return true;
+}
+
+internal b32 file_read_chunked(int src, u8 *buf, u64 size, u64 chunk_size)
+{
+    for (u64 off = 0; off < size;) {
+        ssize_t n = pread(src, buf + off, AIL_MIN(chunk_size, size - off), (off_t)off);
+        if (n <= 0) return false;
+        off += (u64)n;
+    }
+    return true;
+}
+
+internal b32 file_read_write(File_Job *job)
+{
+    return file_copy_chunked(job->src, job->dst, job->chunks, job->size, job->chunk_size);
+}
+
+internal b32 file_direct(File_Job *job)
+{
+    if (job->src_direct < 0 || job->dst_direct < 0) return false;
+    return file_copy_chunked(job->src_direct, job->dst_direct, job->chunks, job->size, job->chunk_size);
+}
+
+internal b32 file_mmap_copy(File_Job *job, FuncType copy, b32 to_buffer)
+{
+    u8 *s = mmap(0, job->size, PROT_READ, MAP_SHARED, job->src, 0);
+    u8 *d = to_buffer ? job->buf : mmap(0, job->size, PROT_READ|PROT_WRITE, MAP_SHARED, job->dst, 0);
+    b32 ok = s != MAP_FAILED && d != MAP_FAILED;
+    if (ok) copy(d, s, job->size);
+    if (s != MAP_FAILED) munmap(s, job->size);
+    if (!to_buffer && d != MAP_FAILED) munmap(d, job->size);
+    return ok;
+}
+
+internal b32 file_mmap_copy_simd(File_Job *job)    { return file_mmap_copy(job, copy_simd,    false); }
+internal b32 file_mmap_copy_builtin(File_Job *job) { return file_mmap_copy(job, copy_builtin, false); }
+
+internal b32 file_copy_file_range(File_Job *job)
+{
+    loff_t off_in = 0, off_out = 0;
+    while ((u64)off_in < job->size) {
+        long n = syscall(SYS_copy_file_range, job->src, &off_in, job->dst, &off_out, job->size - (u64)off_in, 0);
+        if (n <= 0) return false;
+    }
+    return true;
+}
+
+internal b32 file_sendfile(File_Job *job)
+{
+    off_t off = 0;
+    if (lseek(job->dst, 0, SEEK_SET) != 0) return false;
+    while ((u64)off < job->size) {
+        if (sendfile(job->dst, job->src, &off, job->size - (u64)off) <= 0) return false;
+    }
+    return true;
+}
+
+// Moves the data through a pipe, whose buffer is enlarged to a chunk if possible
+internal b32 file_splice(File_Job *job)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds)) return false;
+    long pipe_size = fcntl(pipe_fds[1], F_SETPIPE_SZ, (int)job->chunk_size);
+    if (pipe_size <= 0) pipe_size = AIL_KB(64);
+    loff_t off_in = 0, off_out = 0;
+    b32 ok = true;
+    while (ok && (u64)off_in < job->size) {
+        long n = syscall(SYS_splice, job->src, &off_in, pipe_fds[1], 0, AIL_MIN((u64)pipe_size, job->size - (u64)off_in), 0);
+        ok = n > 0;
+        while (ok && n > 0) {
+            long m = syscall(SYS_splice, pipe_fds[0], 0, job->dst, &off_out, (u64)n, 0);
+            ok = m > 0;
+            n -= m;
+        }
+    }
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return ok;
+}
+
+// Keeps `depth` chunks in flight, each chunk is read and then written by a linked pair of submissions
+// If dst is -1, the chunks are read directly into the buffer instead
+// A read or write that transferred less than its whole chunk fails the copy, since the chunk would be incomplete
+internal b32 file_uring_copy(File_Job *job, int dst)
+{
+    Uring ring;
+    if (!uring_init(&ring, 2*job->depth)) return false;
+    u64 next = 0, done = 0, chunks = (job->size + job->chunk_size - 1) / job->chunk_size;
+    b32 ok = true;
+    // user_data holds the chunk's index, shifted by one bit for marking writes
+    for (u32 slot = 0; slot < job->depth && next < chunks; slot++, next++) {
+        u64 off = next*job->chunk_size;
+        u32 len = (u32)AIL_MIN(job->chunk_size, job->size - off);
+        u8 *mem = dst < 0 ? job->buf + off : job->chunks + slot*job->chunk_size;
+        struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+        uring_prep_rw(sqe, IORING_OP_READ, job->src, mem, len, off, next << 1);
+        if (dst >= 0) {
+            sqe->flags |= IOSQE_IO_LINK;
+            uring_prep_rw(uring_get_sqe(&ring), IORING_OP_WRITE, dst, mem, len, off, (next << 1) | 1 | ((u64)slot << 48));
+        }
+    }
+    if (uring_submit(&ring, 0) < 0) ok = false;
+    while (ok && done < chunks) {
+        struct io_uring_cqe cqe;
+        if (!uring_wait_cqe(&ring, &cqe)) {
+            ok = false;
+            break;
+        }
+        u64 chunk = (cqe.user_data >> 1) & ((1ull << 47) - 1);
+        if (cqe.res < 0 || (u64)cqe.res != AIL_MIN(job->chunk_size, job->size - chunk*job->chunk_size)) {
+            errno = cqe.res < 0 ? -cqe.res : EIO;
+            ok = false;
+            break;
+        }
+        b32 is_write = cqe.user_data & 1;
+        if (dst >= 0 && !is_write) continue;
+        done++;
+        if (next == chunks) continue;
+        // Reuse the finished chunk's slot for the next one
+        u32 slot = dst >= 0 ? (u32)(cqe.user_data >> 48) : 0;
+        u64 off  = next*job->chunk_size;
+        u32 len  = (u32)AIL_MIN(job->chunk_size, job->size - off);
+        u8 *mem  = dst < 0 ? job->buf + off : job->chunks + slot*job->chunk_size;
+        struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+        uring_prep_rw(sqe, IORING_OP_READ, job->src, mem, len, off, next << 1);
+        if (dst >= 0) {
+            sqe->flags |= IOSQE_IO_LINK;
+            uring_prep_rw(uring_get_sqe(&ring), IORING_OP_WRITE, dst, mem, len, off, (next << 1) | 1 | ((u64)slot << 48));
+        }
+        next++;
+        if (uring_submit(&ring, 0) < 0) ok = false;
+    }
+    uring_deinit(&ring);
+    return ok;
+}
+
+internal b32 file_uring(File_Job *job) { return file_uring_copy(job, job->dst); }
+
+internal b32 file_read_to_buffer(File_Job *job)
+{
+    return file_read_chunked(job->src, job->buf, job->size, job->chunk_size);
+}
+
+internal b32 file_direct_to_buffer(File_Job *job)
+{
+    return job->src_direct >= 0 && file_read_chunked(job->src_direct, job->buf, job->size, job->chunk_size);
+}
+
+internal b32 file_mmap_copy_simd_to_buffer(File_Job *job)    { return file_mmap_copy(job, copy_simd,    true); }
+internal b32 file_mmap_copy_builtin_to_buffer(File_Job *job) { return file_mmap_copy(job, copy_builtin, true); }
+internal b32 file_uring_to_buffer(File_Job *job)             { return file_uring_copy(job, -1); }
+
+global File_Backend file_to_file_backends[] = {
+    FILE_BACKEND(file_read_write),
+    FILE_BACKEND(file_direct),
+    FILE_BACKEND(file_mmap_copy_simd),
+    FILE_BACKEND(file_mmap_copy_builtin),
+    FILE_BACKEND(file_copy_file_range),
+    FILE_BACKEND(file_sendfile),
+    FILE_BACKEND(file_splice),
+    FILE_BACKEND(file_uring),
+};
+global File_Backend file_to_buffer_backends[] = {
+    FILE_BACKEND(file_read_to_buffer),
+    FILE_BACKEND(file_direct_to_buffer),
+    FILE_BACKEND(file_mmap_copy_simd_to_buffer),
+    FILE_BACKEND(file_mmap_copy_builtin_to_buffer),
+    FILE_BACKEND(file_uring_to_buffer),
+};
+
+// The pattern's period of 251 bytes doesn't divide any power of 2, so chunks that end up at wrong offsets are detected
+internal u8 file_pattern(u64 i) { return (u8)(i % 251); }
+
+// Checks a few blocks spread over the copy
+internal b32 file_check(File_Job *job, b32 to_buffer)
+{
+    u8 block[256];
+    for (u64 k = 0; k <= 16; k++) {
+        u64 off = AIL_MIN(k*(job->size/16), job->size - sizeof(block));
+        if (to_buffer) memcpy(block, job->buf + off, sizeof(block));
+        else if (pread(job->dst, block, sizeof(block), (off_t)off) != sizeof(block)) return false;
+        for (u64 i = 0; i < sizeof(block); i++) {
+            if (block[i] != file_pattern(off + i)) return false;
+        }
+    }
+    return true;
+}
+
+internal const char *file_system_name(const char *dir, char *str, u64 str_size)
+{
+    struct statfs fs;
+    if (statfs(dir, &fs)) return "unknown";
+    switch ((u64)fs.f_type) {
+        case 0x01021994: return "tmpfs";
+        case 0xEF53:     return "ext4";
+        case 0x58465342: return "xfs";
+        case 0x9123683E: return "btrfs";
+        case 0x794C7630: return "overlayfs";
+        default:
+            snprintf(str, str_size, "fs-0x%lx", (unsigned long)fs.f_type);
+            return str;
+    }
+}
+
+typedef struct File_Ctx {
+    File_Job      job;
+    File_Backend *backends;
+    b32  to_buffer;
+    b32  drop_cache; // Evict src from the page cache before each call
+    b32  sync;       // Flush dst to the disk after each call
+    u64  cpu_ns[16]; // Process CPU time of all calls (including io_uring workers and the kernel)
+    u64  calls[16];
+    u64  failures[16]; // Calls that failed, whose times don't measure a complete copy
+} File_Ctx;
+
+internal u64 process_cpu_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return (u64)t.tv_sec*1000000000ull + (u64)t.tv_nsec;
+}
+
+internal void bench_run_file(void *ctx, u64 idx)
+{
+    File_Ctx *c = ctx;
+    if (c->drop_cache) posix_fadvise(c->job.src, 0, 0, POSIX_FADV_DONTNEED);
+    u64 start = process_cpu_ns();
+    if (!c->backends[idx].func(&c->job)) c->failures[idx]++;
+    if (c->sync && !c->to_buffer) fdatasync(c->job.dst);
+    c->cpu_ns[idx] += process_cpu_ns() - start;
+    c->calls[idx]++;
+}
+
+// Copies a file with each backend, once from file to file and once from file to a buffer, in every directory
+// Backends that fail (i.e. O_DIRECT on tmpfs or io_uring in containers) are skipped
+internal void bench_file_io(u64 size, const char *dirs, u64 chunk_size, u32 depth, b32 drop_cache, b32 sync)
+{
+    size       = AIL_MAX(FILE_IO_ALIGN, (size + FILE_IO_ALIGN - 1) & ~(u64)(FILE_IO_ALIGN - 1));
+    chunk_size = AIL_MAX(FILE_IO_ALIGN, chunk_size & ~(u64)(FILE_IO_ALIGN - 1));
+    depth      = AIL_MAX(depth, 1);
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+    Page_Kind pages;
+    u8 *buf    = pages_alloc(size, PAGES_4K, 0, &pages);
+    u8 *chunks = pages_alloc(chunk_size*depth, PAGES_4K, 0, &pages);
+    for (u64 i = 0; i < size; i++) buf[i] = file_pattern(i);
+
+    for (const char *dir = dirs; *dir;) {
+        u64 dir_len = strcspn(dir, ",");
+        char dir_str[512], src_path[600], dst_path[600], fs_str[32];
+        snprintf(dir_str,  sizeof(dir_str),  "%.*s", (int)dir_len, dir);
+        snprintf(src_path, sizeof(src_path), "%s/speedy-file-io-src.bin", dir_str);
+        snprintf(dst_path, sizeof(dst_path), "%s/speedy-file-io-dst.bin", dir_str);
+        dir += dir_len + (dir[dir_len] == ',');
+        const char *fs = file_system_name(dir_str, fs_str, sizeof(fs_str));
+
+        File_Ctx ctx = { .drop_cache = drop_cache, .sync = sync };
+        File_Job *job = &ctx.job;
+        *job = (File_Job){ .chunks = chunks, .size = size, .chunk_size = chunk_size, .depth = depth };
+        job->src = open(src_path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+        job->dst = open(dst_path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+        if (job->src < 0 || job->dst < 0 || pwrite(job->src, buf, size, 0) != (ssize_t)size || ftruncate(job->dst, (off_t)size)) {
+            printf("\033[31mCould not create the files for benchmarking file I/O in %s: %s\033[0m\n", dir_str, strerror(errno));
+            if (job->src >= 0) { close(job->src); unlink(src_path); }
+            if (job->dst >= 0) { close(job->dst); unlink(dst_path); }
+            continue;
+        }
+        fsync(job->src);
+        job->src_direct = open(src_path, O_RDONLY|O_DIRECT);
+        job->dst_direct = open(dst_path, O_WRONLY|O_DIRECT);
+
+        char mem_size[12], params[96];
+        get_printable_mem_size(mem_size, size);
+        snprintf(params, sizeof(params), "fs=%s", fs);
+        for (u32 to_buffer = 0; to_buffer < 2; to_buffer++) {
+            File_Backend *all   = to_buffer ? file_to_buffer_backends : file_to_file_backends;
+            u64           count = to_buffer ? AIL_ARRLEN(file_to_buffer_backends) : AIL_ARRLEN(file_to_file_backends);
+            File_Backend backends[16];
+            u64 supported = 0;
+            job->buf = to_buffer ? pages_alloc(size, buffer_pages, 0, &pages) : 0;
+            // Each backend is tried once, so that failing ones aren't benchmarked and wrong copies are noticed
+            for (u64 i = 0; i < count; i++) {
+                if (to_buffer) memset(job->buf, 0, size);
+                else if (ftruncate(job->dst, 0) || ftruncate(job->dst, (off_t)size)) continue;
+                errno = 0;
+                if (!all[i].func(job))                printf("\033[33mSkipping %s on %s, since it failed: %s\033[0m\n", all[i].name, fs, errno ? strerror(errno) : "unsupported");
+                else if (!file_check(job, to_buffer)) printf("\033[31m%s produced a wrong copy on %s :(\033[0m\n", all[i].name, fs);
+                else                                  backends[supported++] = all[i];
+            }
+            if (!supported) {
+                if (job->buf) pages_free(job->buf, size, pages);
+                continue;
+            }
+            ctx.backends  = backends;
+            ctx.to_buffer = to_buffer;
+            memset(ctx.cpu_ns, 0, sizeof(ctx.cpu_ns));
+            memset(ctx.calls,  0, sizeof(ctx.calls));
+            memset(ctx.failures, 0, sizeof(ctx.failures));
+            bench_driver_run(&bench_driver, bench_run_file, &ctx, bench_samples, supported);
+
+            printf("Copying a file of %s %s in %s (%s)%s%s:\n", mem_size, to_buffer ? "to a buffer" : "to another file", dir_str, fs,
+                   drop_cache ? ", source evicted from the page cache" : "", sync && !to_buffer ? ", synced" : "");
+            printf("  %-34s %10s %10s %12s %8s\n", "backend", "median ms", "GB/s", "CPU ns/byte", "CPU %");
+            for (u64 i = 0; i < supported; i++) {
+                if (ctx.failures[i]) {
+                    printf("\033[31m  %-34s failed %zu of %zu calls, so its times are invalid :(\033[0m\n", backends[i].name, ctx.failures[i], ctx.calls[i]);
+                    // Exporting resets the samples otherwise, without it they would carry over to the backend measured at this index next
+                    bench_samples_reset(&bench_samples[i]);
+                    continue;
+                }
+                u64 median = bench_stats(&bench_samples[i]).median;
+                f64 cpu_ns = ctx.calls[i] ? (f64)ctx.cpu_ns[i] / (f64)ctx.calls[i] : 0;
+                f64 wall_ns = (f64)median / (f64)cpu_freq * 1e9;
+                printf("  %-34s %10.3f %10.2f %12.4f %7.1f%%\n", backends[i].name, wall_ns / 1e6, median ? (f64)size / wall_ns : 0,
+                       cpu_ns / (f64)size, wall_ns ? cpu_ns / wall_ns * 100 : 0);
+                Bench_Key key = { .kernel = backends[i].name, .params = params, .size = size };
+                bench_export_samples(&bench_export, key, &bench_samples[i]);
+            }
+            printf("-----------\n");
+            if (job->buf) pages_free(job->buf, size, pages);
+        }
+
+        close(job->src);
+        close(job->dst);
+        if (job->src_direct >= 0) close(job->src_direct);
+        if (job->dst_direct >= 0) close(job->dst_direct);
+        unlink(src_path);
+        unlink(dst_path);
+    }
+    pages_free(chunks, chunk_size*depth, PAGES_4K);
+    pages_free(buf, size, PAGES_4K);
+}
+#endif
+
+typedef struct Sweep_Point {
+    u64 size;
+    u64 copy_fastest, copy_median;
+    u64 move_fastest, move_median;
+} Sweep_Point;
+
+// Sweeps over sizes that are concentrated around the capacities of the host's caches, where the rankings of the routines change
+// Copies use distinct buffers, moves overlap by half of their size
+internal void bench_cache_sweep(void)
+{
+    CPU_Cache_Info cache = cpu_cache_info();
+    char l1_str[12], l2_str[12], l3_str[12];
+    get_printable_mem_size(l1_str, cache.l1d);
+    get_printable_mem_size(l2_str, cache.l2);
+    get_printable_mem_size(l3_str, cache.l3);
+    printf("Cache-aware sweep for L1d: %s, L2: %s, L3: %s\n", l1_str, l2_str, l3_str);
+
+    persist u64 sizes[128];
+    persist Sweep_Point points[128];
+    u64 count = bench_cache_sweep_sizes(sizes, 0,     AIL_ARRLEN(sizes), MIN_BUFFER_SIZE, MAX_BUFFER_SIZE, 2.0);
+    count     = bench_cache_sweep_sizes(sizes, count, AIL_ARRLEN(sizes), MIN_BUFFER_SIZE, MAX_BUFFER_SIZE, 1.5);
+    for (u64 i = 0; i < count; i++) {
+        u64 size = sizes[i];
+        Sweep_Point *p = &points[i];
+        p->size = size;
+
+        Buffer buf = get_buffer(size, 0, 0);
+        fill_buffer(&buf);
+        printf("Benchmark Results for Copying %zu bytes (working set fits in %s)\n", size, bench_level_names[bench_cache_level(buffer_working_set(buf))]);
+        ail_bench_begin_profile();
+        p->copy_fastest = bench_funcs(copy_funcs, copy_funcs_count, buf, &p->copy_median);
+        ail_bench_end_and_print_profile(1, true);
+        free_buffer(buf);
+
+        // Every point moves in the same direction (dst behind src, which is copied from the back), so neighbouring points are comparable
+        buf = get_buffer(size, size/2, false);
+        fill_buffer(&buf);
+        printf("Benchmark Results for Moving %zu bytes with %zu right-overlapped bytes (working set fits in %s)\n", size, buf.overlap_size, bench_level_names[bench_cache_level(buffer_working_set(buf))]);
+        ail_bench_begin_profile();
+        p->move_fastest = bench_funcs(move_funcs, move_funcs_count, buf, &p->move_median);
+        ail_bench_end_and_print_profile(1, true);
+        free_buffer(buf);
+        printf("-----------\n");
+    }
+
+    u64 cpu_freq = ail_bench_cpu_timer_freq();
+    printf("Fastest routines per size (by median time):\n");
+    printf("%12s %-5s | %-24s %8s | %-24s %8s\n", "size", "level", "copy", "GB/s", "move", "GB/s");
+    for (u64 i = 0; i < count; i++) {
+        Sweep_Point p = points[i];
+        Bench_Level copy_level = bench_cache_level(2*p.size);
+        Bench_Level move_level = bench_cache_level(p.size + p.size/2);
+        // Points between the two curves' boundaries fit into different levels for copies and moves
+        char level[12];
+        if (copy_level == move_level) snprintf(level, sizeof(level), "%s", bench_level_names[copy_level]);
+        else snprintf(level, sizeof(level), "%s/%s", bench_level_names[copy_level], bench_level_names[move_level]);
+        printf("%12zu %-5s | %-24s %8.2f | %-24s %8.2f\n", p.size, level,
+               copy_funcs[p.copy_fastest].name, (f64)p.size / (f64)p.copy_median * (f64)cpu_freq / 1e9,
+               move_funcs[p.move_fastest].name, (f64)p.size / (f64)p.move_median * (f64)cpu_freq / 1e9);
+    }
+    printf("-----------\n");
+}
+
+int main(int argc, char **argv)
+{
+    ail_bench_init();
+    srand((u32)time(NULL));
+    u64 t0 = ail_bench_cpu_timer();
+#ifdef BENCH
+    // Without the baseline, the run couldn't be judged, so it stops before testing or measuring anything
+    if (!bench_baseline_from_args(argc, argv)) return 1;
+#endif
+    copy_funcs_count = filter_supported_funcs(copy_funcs, AIL_ARRLEN(copy_funcs));
+    move_funcs_count = filter_supported_funcs(move_funcs, AIL_ARRLEN(move_funcs));
+    load_plugins(argc, argv);
+    init_stream_copy();
+    init_crc32c();
+    for (u64 i = 0; i < AIL_ARRLEN(checksum_funcs); i++) {
+        if (cpu_supports(checksum_funcs[i].features)) checksum_funcs[checksum_funcs_count++] = checksum_funcs[i];
+    }
+    char stream_threshold_str[12];
+    get_printable_mem_size(stream_threshold_str, stream_threshold);
+    printf("copy_stream/move_stream use non-temporal stores for copies of at least %s\n", stream_threshold_str);
+    pool_init(&pool, (u32)args_get_u64(argc, argv, "-threads", THREAD_COUNT));
+    parallel_min_chunk = AIL_MAX(1, args_get_u64(argc, argv, "-parallel-min-chunk", PARALLEL_MIN_CHUNK));
+    printf("copy_parallel/move_parallel use up to %u threads\n", pool.thread_count);
+    buffer_pages = page_kind_from_str(args_get(argc, argv, "-pages", 0), BUFFER_PAGES);
+    if (buffer_pages != PAGES_4K) printf("Buffers are backed by %s pages\n", page_kind_names[buffer_pages]);
+    buffer_populate = args_has(argc, argv, "-populate");
+    copy_batch_prefetch = args_get_u64(argc, argv, "-batch-prefetch", COPY_BATCH_PREFETCH);
+    prefetch_table_init(&prefetch_table, prefetch_stream_names, PREFETCH_STREAM_COUNT, (Prefetch_Setting){ PREFETCH_DISTANCE, PREFETCH_HINT });
+    const char *prefetch_table_path = args_get(argc, argv, "-prefetch-table", PREFETCH_TABLE_PATH);
+    if (prefetch_table_load(&prefetch_table, prefetch_table_path)) printf("Loaded prefetch distances from %s\n", prefetch_table_path);
+    set_default_dispatch();
+    const char *dispatch_table_path = args_get(argc, argv, "-dispatch-table", DISPATCH_TABLE_PATH);
+    if (args_has(argc, argv, "-calibrate")) {
+        calibrate_dispatch();
+        if (save_dispatch_table(dispatch_table_path)) printf("Saved dispatch table to %s\n", dispatch_table_path);
+        else printf("\033[31mFailed to save dispatch table to %s\033[0m\n", dispatch_table_path);
+    } else if (load_dispatch_table(dispatch_table_path)) {
+        printf("Loaded dispatch table from %s\n", dispatch_table_path);
+    } else {
+        printf("No dispatch table found at %s, mem_copy_auto/mem_move_auto use copy_builtin/move_builtin (run with -calibrate to create one)\n", dispatch_table_path);
+    }
+#ifdef TEST
+    persist TestBufferList buffers;
+    add_small_test_inputs();
+    for (u64 i = 0; i < test_inputs_count; i++) {
+        Input in   = test_inputs[i];
+        buffers[i] = get_buffer(in.size, in.overlap_size, in.overlap_left);
+    }
+    for (u64 i = 0; i < copy_funcs_count; i++) {
+        test(buffers, copy_funcs[i], true);
+    }
+    for (u64 i = 0; i < move_funcs_count; i++) {
+        test(buffers, move_funcs[i], false);
+    }
+    test(buffers, remap_copy_funcs[0], true);
+    test(buffers, remap_move_funcs[0], false);
+    test_remap();
+    test_parallel();
+    for (u64 i = 0; i < checksum_funcs_count; i++) {
+        test_checksum(checksum_funcs[i]);
+    }
+    test_batch("copy_batch", copy_batch);
+    if (cpu_supports(CPU_AVX)) test_batch("copy_batch_avx", copy_batch_avx);
+	for (u64 i = 0; i < test_inputs_count; i++) {
+		free_buffer(buffers[i]);
+	}
+#endif
+
+    int exit_code = 0; // Set if the benchmark results regressed against the baseline
+#ifdef BENCH
+    ail_bench_clear_anchors();
+    bench_driver = bench_driver_from_args(argc, argv, ITER_COUNT);
+    const char *export_path = args_get(argc, argv, "-export", 0);
+    if (bench_export_open(&bench_export, export_path)) printf("Exporting benchmark results to %s\n", export_path);
+    if      (args_has(argc, argv, "-cache-sweep"))   bench_cache_sweep();
+    else if (args_has(argc, argv, "-alignment"))     bench_alignment(args_get_u64(argc, argv, "-align-step", ALIGN_STEP));
+    else if (args_has(argc, argv, "-compare-pages")) bench_compare_pages(page_kind_from_str(args_get(argc, argv, "-huge-pages", 0), COMPARE_PAGES));
+    else if (args_has(argc, argv, "-cold"))          bench_cold_warm();
+    else if (args_has(argc, argv, "-remap"))         bench_remap();
+    else if (args_has(argc, argv, "-checksum"))      bench_checksum();
+    else if (args_has(argc, argv, "-prefetch-tune")) bench_prefetch_tune(prefetch_table_path);
+    else if (args_has(argc, argv, "-generated"))     bench_generated();
+    else if (args_has(argc, argv, "-batch"))         bench_batch(args_get_u64(argc, argv, "-batch-size", BATCH_SIZE));
+#if defined(__linux__)
+    else if (args_has(argc, argv, "-file-io")) {
+        bench_file_io(args_get_u64(argc, argv, "-file-size", FILE_IO_SIZE), args_get(argc, argv, "-file-dirs", FILE_IO_DIRS),
+                      args_get_u64(argc, argv, "-file-chunk", FILE_IO_CHUNK), (u32)args_get_u64(argc, argv, "-uring-depth", URING_QUEUE_DEPTH),
+                      args_has(argc, argv, "-file-drop-cache"), args_has(argc, argv, "-file-sync"));
     }
-    ail_bench_end_and_print_profile(1, true);
 #endif
+    else                                             bench_powers_of_4();
+    bench_export_close(&bench_export);
+    if (baseline_close(&bench_baseline)) exit_code = 1; // Regressions fail the run, so toolchain upgrades can be gated on it
+    perf_close(&bench_perf);
+    for (u64 i = 0; i < AIL_ARRLEN(bench_samples); i++) bench_samples_free(&bench_samples[i]);
 #endif
 
+    pool_deinit(&pool);
+    for (u32 i = 0; i < plugins_count; i++) plugin_close(&plugins[i]);
     u64 t1 = ail_bench_cpu_timer();
     f64 elapsed_ms   = ail_bench_cpu_elapsed_to_ms(t1 - t0);
     f64 second_in_ms = 1000.0f;
@@ -606,4 +3383,5 @@ int main(void)
 	printf("Total time for running entire program: ~");
     if (elapsed_ms > minute_in_ms) printf("%fmin\n", elapsed_ms/minute_in_ms);
     else printf("%fsec\n", elapsed_ms/second_in_ms);
+    return exit_code;
 }
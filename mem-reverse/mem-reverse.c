@@ -3,18 +3,45 @@
 #define AIL_BENCH_PROFILE
 #include "../util/ail/ail.h"       // For typedefs and some useful macros
 #include "../util/ail/ail_bench.h" // For benchmarking
+#include "../util/cpu.h"           // For runtime detection of SIMD extensions
+#include "../util/args.h"          // For command line options
+#include "../util/pool.h"          // For the worker threads of parallel/parallel_in_place
+#include "../util/bench.h"         // For exporting benchmark results as CSV/JSON
+#include "../util/pages.h"         // For backing buffers with huge pages
+#include "../util/uring.h"         // For the asynchronous I/O of the streaming file reversal
+#include "../util/prefetch.h"      // For the distances and hints of the prefetching routines
+#include "../util/plugin.h"        // For loading external reversal routines from shared objects
 #include <stdio.h>                 // For printf
-#include <xmmintrin.h>             // For SIMD instructions
-
-#if defined(_WIN32) || defined(__WIN32__)
-#include <Windows.h> // For VirtualAlloc
-#else
-#include <sys/mman.h> // For mmap
+#include <string.h>                // For strcmp
+#include <stdlib.h>                // For malloc, free, _byteswap_* (MSVC)
+#include <immintrin.h>             // For SIMD instructions
+#if defined(__linux__)
+#	include <unistd.h>                // For pread, pwrite, fdatasync
+#	include <fcntl.h>                 // For open, posix_fadvise
+#	include <errno.h>                 // For errno
 #endif
 
 #define ALL
-// #define BENCH_AS_CSV
-#define ITER_COUNT 10
+#define ITER_COUNT 10 // Minimum amount of measured calls per routine and buffer
+#define MAX_FUNC_COUNT 32
+#define MAX_PLUGIN_COUNT 8 // Amount of shared objects that can be loaded with -plugin
+#define THREAD_COUNT 0                // Amount of threads used by parallel/parallel_in_place (0 means one per logical CPU)
+#define PARALLEL_MIN_CHUNK AIL_KB(64) // parallel/parallel_in_place don't split buffers into chunks smaller than this
+#define SCALING_BUFFER_SIZE AIL_GB(1) // Size of the buffer that is used for measuring the scaling of the parallel routines
+#define ELEM_BUFFER_SIZE AIL_MB(64)   // Size of the buffer that is used for benchmarking the element-wise reversal routines
+#define ALIGN_STEP 4                  // Step between the src/dst offsets that are benchmarked with -alignment
+#define BUFFER_PAGES PAGES_4K         // Kind of pages backing all buffers (see util/pages.h)
+#define COMPARE_PAGES PAGES_2M        // Kind of huge pages that is compared against 4K pages with -compare-pages
+#define FILE_REVERSE_SIZE AIL_GB(1)   // Size of the file that is reversed with -file-reverse
+#define FILE_REVERSE_DIR "."          // Directory in which -file-reverse creates its files
+#define FILE_REVERSE_CHUNK AIL_MB(4)  // Size of the chunks that the file is streamed through memory in
+#define FILE_REVERSE_DEPTH 3          // Amount of chunks in flight when streaming a file (2 for double buffering, 3 for triple buffering)
+#define FILE_REVERSE_DIRECT 1         // Whether the streaming file reversal bypasses the page cache with O_DIRECT where possible
+#define REVERSE_MOVE_MAX_SIZE AIL_MB(256) // Largest size that the reversal between overlapping buffers is benchmarked with by -reverse-move
+#define PREFETCH_DISTANCE AIL_KB(1)   // Distance at which the *_prefetch routines prefetch, unless a tuned table is loaded
+#define PREFETCH_HINT PREFETCH_T0     // Locality hint of the *_prefetch routines (PREFETCH_T0 or PREFETCH_NTA), unless a tuned table is loaded
+#define PREFETCH_TABLE_PATH "mem-reverse-prefetch.txt" // Where -prefetch-tune stores the best distance and hint per stream and size class
+#define PREFETCH_TUNE_MAX_SIZE AIL_MB(256) // Largest size that -prefetch-tune measures
 
 #ifdef ALL
 #define TEST
@@ -24,34 +51,22 @@
 typedef struct {
 	u64 size;
 	u8 *data;
+	Page_Kind pages;
 } Buffer;
 
-static void* alloc(u64 size)
-{
-#if defined(_WIN32) || defined(__WIN32__)
-    return VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-#else
-    return mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
-#endif
-}
+static Page_Kind buffer_pages = BUFFER_PAGES;
 
 static Buffer get_buffer(u64 size)
 {
-	Buffer buf = {
-		.size = size,
-		.data = alloc(size),
-	};
+	Buffer buf = { .size = size };
+	buf.data = pages_alloc(size, buffer_pages, 0, &buf.pages);
 	AIL_ASSERT(buf.data != 0);
 	return buf;
 }
 
 static void free_buffer(Buffer buf)
 {
-#if defined(_WIN32) || defined(__WIN32__)
-    VirtualFree(buf.data, buf.size, MEM_DECOMMIT);
-#else
-    munmap(buf.data, buf.size);
-#endif
+	pages_free(buf.data, buf.size, buf.pages);
 }
 
 // @Note: Fills the buffer with a repeating pattern of increasing bytes between 0 and 255. This makes it very easy to see if the buffer was reversed correctly
@@ -63,14 +78,15 @@ static void fill_buffer(Buffer buf)
 	}
 }
 
-// Checks whether the buffer contains the reversed pattern of fill_buffer
-static b32 test_buffer(Buffer buf)
+// Checks whether the buffer contains the pattern of fill_buffer with the order of its elements reversed
+// Each element of `elem_size` bytes has to keep its internal byte order, so an elem_size of 1 checks for a plain byte reversal
+static b32 test_buffer(Buffer buf, u64 elem_size)
 {
-	u64 i = buf.size;
-	u8  x = 0;
-	while (i > 0) {
-		if (buf.data[--i] != x++) {
-			printf("\033[31mError at index %zd - Expected: %d, but received: %d\033[0m\n", i, x-1, buf.data[i]);
+	u64 n = buf.size / elem_size;
+	for (u64 i = 0; i < buf.size; i++) {
+		u8 expected = (u8)((n - i/elem_size - 1)*elem_size + i%elem_size);
+		if (buf.data[i] != expected) {
+			printf("\033[31mError at index %zd - Expected: %d, but received: %d\033[0m\n", i, expected, buf.data[i]);
 			return 0;
 		}
 	}
@@ -141,7 +157,7 @@ static void scalar_wide_in_place(Buffer buf)
 	AIL_BENCH_PROFILE_END(scalar_wide_in_place);
 }
 
-static void simd_shuffle(Buffer src, Buffer dst)
+CPU_TARGET("ssse3") static void simd_shuffle(Buffer src, Buffer dst)
 {
 	AIL_BENCH_PROFILE_START(simd_shuffle);
 	u64 n   = src.size / sizeof(__m128);
@@ -162,7 +178,7 @@ static void simd_shuffle(Buffer src, Buffer dst)
 	AIL_BENCH_PROFILE_END(simd_shuffle);
 }
 
-static void simd_shuffle_in_place(Buffer buf)
+CPU_TARGET("ssse3") static void simd_shuffle_in_place(Buffer buf)
 {
 	AIL_BENCH_PROFILE_START(simd_shuffle_in_place);
 	u64 n   = buf.size / (sizeof(__m128) * 2);
@@ -188,50 +204,1191 @@ static void simd_shuffle_in_place(Buffer buf)
 	AIL_BENCH_PROFILE_END(simd_shuffle_in_place);
 }
 
+// Reverses the bytes within each 128-bit lane with vpshufb and then reverses the order of the lanes with vpermq
+CPU_TARGET("avx2") static inline __m256i reverse_avx2(__m256i x)
+{
+	const __m256i mask = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+	                                      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	x = _mm256_shuffle_epi8(x, mask);           // Requires AVX2
+	return _mm256_permute4x64_epi64(x, 0x4e);   // Requires AVX2 - swaps the two 128-bit lanes
+}
+
+CPU_TARGET("avx512f,avx512bw") static inline __m512i reverse_avx512(__m512i x)
+{
+	const __m512i mask = _mm512_set4_epi32(0x00010203, 0x04050607, 0x08090a0b, 0x0c0d0e0f);
+	const __m512i lanes = _mm512_set_epi64(1, 0, 3, 2, 5, 4, 7, 6);
+	x = _mm512_shuffle_epi8(x, mask);           // Requires AVX-512BW
+	return _mm512_permutexvar_epi64(lanes, x);  // Requires AVX-512F - reverses the order of the four 128-bit lanes
+}
+
+// vpermb can move any byte to any position, so a single instruction suffices
+CPU_TARGET("avx512f,avx512vbmi") static inline __m512i reverse_avx512vbmi(__m512i x)
+{
+	const __m512i idx = _mm512_set_epi8( 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+	                                    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+	                                    32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+	                                    48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63);
+	return _mm512_permutexvar_epi8(idx, x);     // Requires AVX-512VBMI
+}
+
+// The wider kernels are all the same loops as simd_shuffle/simd_shuffle_in_place, only differing in the vector type and the reversal,
+// so they are generated from these macros. The unrolled versions keep 4 vectors in flight per iteration.
+#define REVERSE_KERNEL(name, T, load, store, reverse) \
+	static void name(Buffer src, Buffer dst) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		u64 n   = src.size / sizeof(T); \
+		u64 rem = src.size % sizeof(T); \
+		T *s = (T*)src.data; \
+		T *d = (T*)(dst.data + rem); \
+		for (u64 i = 0; i < n; i++) { \
+			store(&d[n - i - 1], reverse(load(&s[i]))); \
+		} \
+		for (u64 i = 0; i < rem; i++) { \
+			dst.data[i] = src.data[src.size - i - 1]; \
+		} \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+#define REVERSE_KERNEL_IN_PLACE(name, T, load, store, reverse) \
+	static void name(Buffer buf) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		u64 n   = buf.size / (sizeof(T) * 2); \
+		u64 rem = buf.size % (sizeof(T) * 2); \
+		T *start = (T*)buf.data; \
+		T *end   = (T*)&buf.data[buf.size]; \
+		for (u64 i = 0; i < n; i++) { \
+			T a = load(start + i); \
+			T b = load(end - i - 1); \
+			store(start + i,   reverse(b)); \
+			store(end - i - 1, reverse(a)); \
+		} \
+		for (u64 i = 0; i < rem/2; i++) { \
+			u8 tmp = buf.data[n*sizeof(T) + i]; \
+			buf.data[n*sizeof(T) + i] = buf.data[n*sizeof(T) + rem - i - 1]; \
+			buf.data[n*sizeof(T) + rem - i - 1] = tmp; \
+		} \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+#define REVERSE_KERNEL_UNROLLED(name, T, load, store, reverse) \
+	static void name(Buffer src, Buffer dst) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		u64 n   = src.size / sizeof(T); \
+		u64 rem = src.size % sizeof(T); \
+		T *s = (T*)src.data; \
+		T *d = (T*)(dst.data + rem); \
+		u64 i = 0; \
+		for (; i + 4 <= n; i += 4) { \
+			T a = load(&s[i + 0]); \
+			T b = load(&s[i + 1]); \
+			T c = load(&s[i + 2]); \
+			T e = load(&s[i + 3]); \
+			store(&d[n - i - 1], reverse(a)); \
+			store(&d[n - i - 2], reverse(b)); \
+			store(&d[n - i - 3], reverse(c)); \
+			store(&d[n - i - 4], reverse(e)); \
+		} \
+		for (; i < n; i++) { \
+			store(&d[n - i - 1], reverse(load(&s[i]))); \
+		} \
+		for (i = 0; i < rem; i++) { \
+			dst.data[i] = src.data[src.size - i - 1]; \
+		} \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+#define REVERSE_KERNEL_IN_PLACE_UNROLLED(name, T, load, store, reverse) \
+	static void name(Buffer buf) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		u64 n   = buf.size / (sizeof(T) * 2); \
+		u64 rem = buf.size % (sizeof(T) * 2); \
+		T *start = (T*)buf.data; \
+		T *end   = (T*)&buf.data[buf.size]; \
+		u64 i = 0; \
+		for (; i + 2 <= n; i += 2) { \
+			T a0 = load(start + i + 0); \
+			T a1 = load(start + i + 1); \
+			T b0 = load(end - i - 1); \
+			T b1 = load(end - i - 2); \
+			store(start + i + 0, reverse(b0)); \
+			store(start + i + 1, reverse(b1)); \
+			store(end - i - 1,   reverse(a0)); \
+			store(end - i - 2,   reverse(a1)); \
+		} \
+		for (; i < n; i++) { \
+			T a = load(start + i); \
+			T b = load(end - i - 1); \
+			store(start + i,   reverse(b)); \
+			store(end - i - 1, reverse(a)); \
+		} \
+		for (i = 0; i < rem/2; i++) { \
+			u8 tmp = buf.data[n*sizeof(T) + i]; \
+			buf.data[n*sizeof(T) + i] = buf.data[n*sizeof(T) + rem - i - 1]; \
+			buf.data[n*sizeof(T) + rem - i - 1] = tmp; \
+		} \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+#define AVX2_TARGET       CPU_TARGET("avx2")
+#define AVX512_TARGET     CPU_TARGET("avx512f,avx512bw")
+#define AVX512VBMI_TARGET CPU_TARGET("avx512f,avx512vbmi")
+AVX2_TARGET       REVERSE_KERNEL(simd_shuffle_avx2,                             __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX2_TARGET       REVERSE_KERNEL_IN_PLACE(simd_shuffle_avx2_in_place,           __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX2_TARGET       REVERSE_KERNEL_UNROLLED(simd_shuffle_avx2_unrolled,           __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX2_TARGET       REVERSE_KERNEL_IN_PLACE_UNROLLED(simd_shuffle_avx2_in_place_unrolled, __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX512_TARGET     REVERSE_KERNEL(simd_shuffle_avx512,                           __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+AVX512_TARGET     REVERSE_KERNEL_IN_PLACE(simd_shuffle_avx512_in_place,         __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+AVX512_TARGET     REVERSE_KERNEL_UNROLLED(simd_shuffle_avx512_unrolled,         __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+AVX512_TARGET     REVERSE_KERNEL_IN_PLACE_UNROLLED(simd_shuffle_avx512_in_place_unrolled, __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+AVX512VBMI_TARGET REVERSE_KERNEL(simd_permute_avx512vbmi,                       __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512vbmi)
+AVX512VBMI_TARGET REVERSE_KERNEL_IN_PLACE(simd_permute_avx512vbmi_in_place,     __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512vbmi)
+AVX512VBMI_TARGET REVERSE_KERNEL_UNROLLED(simd_permute_avx512vbmi_unrolled,     __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512vbmi)
+AVX512VBMI_TARGET REVERSE_KERNEL_IN_PLACE_UNROLLED(simd_permute_avx512vbmi_in_place_unrolled, __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512vbmi)
+
+// The prefetching routines reverse one cache line per iteration and prefetch the lines that lie the tuned distance ahead in the
+// direction of each of their streams, which is looked up per size class (see util/prefetch.h). Out of place, src is read forwards
+// while dst is written backwards. In place, both ends are read and written towards the middle.
+typedef enum {
+	PREFETCH_OUT_OF_PLACE,
+	PREFETCH_IN_PLACE,
+	PREFETCH_STREAM_COUNT,
+} Prefetch_Stream;
+static const char *prefetch_stream_names[PREFETCH_STREAM_COUNT] = { "out_of_place", "in_place" };
+static Prefetch_Table prefetch_table;
+
+#define REVERSE_KERNEL_PREFETCH(name, T, load, store, reverse) \
+	static void name(Buffer src, Buffer dst) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		Prefetch_Setting p = prefetch_get(&prefetch_table, PREFETCH_OUT_OF_PLACE, src.size); \
+		const u64 lanes = 64/sizeof(T); \
+		u64 n   = src.size / 64; \
+		u64 rem = src.size % 64; \
+		for (u64 i = 0; i < n; i++) { \
+			u8 *s = src.data + i*64; \
+			u8 *d = dst.data + src.size - (i + 1)*64; \
+			if (p.distance) { \
+				PREFETCH(s + p.distance, p.hint); \
+				PREFETCH((u64)d - p.distance, p.hint); \
+			} \
+			for (u64 k = 0; k < lanes; k++) { \
+				store((T*)d + lanes - k - 1, reverse(load((T*)s + k))); \
+			} \
+		} \
+		for (u64 i = 0; i < rem; i++) { \
+			dst.data[i] = src.data[src.size - i - 1]; \
+		} \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+#define REVERSE_KERNEL_IN_PLACE_PREFETCH(name, T, load, store, reverse) \
+	static void name(Buffer buf) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		Prefetch_Setting p = prefetch_get(&prefetch_table, PREFETCH_IN_PLACE, buf.size); \
+		const u64 lanes = 64/sizeof(T); \
+		u64 n   = buf.size / 128; \
+		u64 rem = buf.size % 128; \
+		for (u64 i = 0; i < n; i++) { \
+			u8 *front = buf.data + i*64; \
+			u8 *back  = buf.data + buf.size - (i + 1)*64; \
+			if (p.distance) { \
+				PREFETCH(front + p.distance, p.hint); \
+				PREFETCH((u64)back - p.distance, p.hint); \
+			} \
+			T a[64/sizeof(T)], b[64/sizeof(T)]; \
+			for (u64 k = 0; k < lanes; k++) { \
+				a[k] = load((T*)front + k); \
+				b[k] = load((T*)back + k); \
+			} \
+			for (u64 k = 0; k < lanes; k++) { \
+				store((T*)front + k, reverse(b[lanes - k - 1])); \
+				store((T*)back + k,  reverse(a[lanes - k - 1])); \
+			} \
+		} \
+		for (u64 i = 0; i < rem/2; i++) { \
+			u8 tmp = buf.data[n*64 + i]; \
+			buf.data[n*64 + i] = buf.data[n*64 + rem - i - 1]; \
+			buf.data[n*64 + rem - i - 1] = tmp; \
+		} \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+AVX2_TARGET   REVERSE_KERNEL_PREFETCH(simd_shuffle_avx2_prefetch,                   __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX2_TARGET   REVERSE_KERNEL_IN_PLACE_PREFETCH(simd_shuffle_avx2_in_place_prefetch, __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX512_TARGET REVERSE_KERNEL_PREFETCH(simd_shuffle_avx512_prefetch,                   __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+AVX512_TARGET REVERSE_KERNEL_IN_PLACE_PREFETCH(simd_shuffle_avx512_in_place_prefetch, __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+
+CPU_TARGET("ssse3") static inline __m128i reverse_sse(__m128i x)
+{
+	const __m128i mask = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	return _mm_shuffle_epi8(x, mask); // Requires SSSE3
+}
+
+// The profiler isn't thread-safe, so the worker threads of the parallel routines use these unprofiled procedures instead
+// reverse_chunk: Writes the `size` bytes of `src` in reversed order into `dst`
+// swap_chunks:   Writes the reversal of `front` into `back` and vice versa, which is what reversing a buffer in place
+//                does to a pair of chunks that are mirrored around the buffer's center
+#define REVERSE_CHUNK(name, T, load, store, reverse) \
+	static void name(u8 *dst, u8 *src, u64 size) \
+	{ \
+		u64 n   = size / sizeof(T); \
+		u64 rem = size % sizeof(T); \
+		T *s = (T*)src; \
+		T *d = (T*)(dst + rem); \
+		for (u64 i = 0; i < n; i++) { \
+			store(&d[n - i - 1], reverse(load(&s[i]))); \
+		} \
+		for (u64 i = 0; i < rem; i++) { \
+			dst[i] = src[size - i - 1]; \
+		} \
+	}
+
+#define SWAP_CHUNKS(name, T, load, store, reverse) \
+	static void name(u8 *front, u8 *back, u64 size) \
+	{ \
+		u64 n   = size / sizeof(T); \
+		T *start = (T*)front; \
+		T *end   = (T*)(back + size); \
+		for (u64 i = 0; i < n; i++) { \
+			T a = load(start + i); \
+			T b = load(end - i - 1); \
+			store(start + i,   reverse(b)); \
+			store(end - i - 1, reverse(a)); \
+		} \
+		for (u64 i = n*sizeof(T); i < size; i++) { \
+			u8 tmp = front[i]; \
+			front[i] = back[size - i - 1]; \
+			back[size - i - 1] = tmp; \
+		} \
+	}
+
+CPU_TARGET("ssse3") REVERSE_CHUNK(reverse_chunk_sse,    __m128i, _mm_loadu_si128,    _mm_storeu_si128,    reverse_sse)
+CPU_TARGET("ssse3") SWAP_CHUNKS(swap_chunks_sse,        __m128i, _mm_loadu_si128,    _mm_storeu_si128,    reverse_sse)
+AVX2_TARGET         REVERSE_CHUNK(reverse_chunk_avx2,   __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX2_TARGET         SWAP_CHUNKS(swap_chunks_avx2,       __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_avx2)
+AVX512_TARGET       REVERSE_CHUNK(reverse_chunk_avx512, __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+AVX512_TARGET       SWAP_CHUNKS(swap_chunks_avx512,     __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_avx512)
+
+static Pool pool;
+static u64  parallel_min_chunk = PARALLEL_MIN_CHUNK;
+static u32  parallel_thread_count; // Upper limit for the amount of threads, which allows measuring the scaling with a single pool
+static void (*reverse_chunk)(u8 *dst, u8 *src, u64 size)    = reverse_chunk_sse;
+static void (*swap_chunks)(u8 *front, u8 *back, u64 size)   = swap_chunks_sse;
+
+// Selects the widest chunk procedures that this CPU supports
+static void init_parallel(u32 thread_count, u64 min_chunk)
+{
+	pool_init(&pool, thread_count);
+	parallel_thread_count = pool.thread_count;
+	parallel_min_chunk    = AIL_MAX(1, min_chunk);
+	if (cpu_supports(CPU_AVX512F | CPU_AVX512BW)) {
+		reverse_chunk = reverse_chunk_avx512;
+		swap_chunks   = swap_chunks_avx512;
+	} else if (cpu_supports(CPU_AVX2)) {
+		reverse_chunk = reverse_chunk_avx2;
+		swap_chunks   = swap_chunks_avx2;
+	}
+}
+
+typedef struct {
+	Buffer src;
+	Buffer dst;
+	u64 chunk; // Size of each chunk, the last one might be smaller
+	u64 size;  // Amount of bytes that are split into chunks
+} Parallel_Reverse;
+
+static u32 parallel_task_count(u64 size)
+{
+	u64 n = size / parallel_min_chunk;
+	return (u32)AIL_MAX(1, AIL_MIN(n, parallel_thread_count));
+}
+
+// Chunks are aligned to cache lines, so no two threads write to the same cache line (as long as the buffers are aligned)
+static u64 parallel_chunk_size(u64 size, u32 count)
+{
+	return ((size + count - 1)/count + 63) & ~(u64)63;
+}
+
+static void parallel_task(void *arg, u32 idx, u32 count)
+{
+	(void)count;
+	Parallel_Reverse *r = arg;
+	u64 start = AIL_MIN(idx*r->chunk, r->size);
+	u64 end   = AIL_MIN(start + r->chunk, r->size);
+	// The chunk [start, end) of the source is the chunk [size - end, size - start) of the destination
+	reverse_chunk(r->dst.data + r->size - end, r->src.data + start, end - start);
+}
+
+static void parallel_in_place_task(void *arg, u32 idx, u32 count)
+{
+	(void)count;
+	Parallel_Reverse *r = arg;
+	u64 start = AIL_MIN(idx*r->chunk, r->size);
+	u64 end   = AIL_MIN(start + r->chunk, r->size);
+	// Each task owns the chunk [start, end) of the front half and its mirror image in the back half, so no locking is needed
+	swap_chunks(r->src.data + start, r->src.data + r->src.size - end, end - start);
+}
+
+// Splits the source into one chunk per thread, each of which is reversed into the mirrored position of the destination
+CPU_TARGET("ssse3") static void parallel(Buffer src, Buffer dst)
+{
+	AIL_BENCH_PROFILE_START(parallel);
+	u32 count = parallel_task_count(src.size);
+	Parallel_Reverse r = { .src = src, .dst = dst, .size = src.size, .chunk = parallel_chunk_size(src.size, count) };
+	pool_run(&pool, parallel_task, &r, count);
+	AIL_BENCH_PROFILE_END(parallel);
+}
+
+// Splits the front half of the buffer into one chunk per thread, each of which is swapped with its mirrored chunk in the back half
+// If the size is odd, the middle byte stays where it is
+CPU_TARGET("ssse3") static void parallel_in_place(Buffer buf)
+{
+	AIL_BENCH_PROFILE_START(parallel_in_place);
+	u64 half  = buf.size / 2;
+	u32 count = parallel_task_count(half);
+	Parallel_Reverse r = { .src = buf, .dst = buf, .size = half, .chunk = parallel_chunk_size(half, count) };
+	pool_run(&pool, parallel_in_place_task, &r, count);
+	AIL_BENCH_PROFILE_END(parallel_in_place);
+}
+
+// X(func, func_in_place, required CPU features)
 #define FUNCTIONS \
-	X(scalar, scalar_in_place) \
-	X(scalar_wide, scalar_wide_in_place) \
-	X(simd_shuffle, simd_shuffle_in_place)
+	X(scalar, scalar_in_place, 0) \
+	X(scalar_wide, scalar_wide_in_place, 0) \
+	X(simd_shuffle, simd_shuffle_in_place, CPU_SSSE3) \
+	X(simd_shuffle_avx2, simd_shuffle_avx2_in_place, CPU_AVX2) \
+	X(simd_shuffle_avx2_unrolled, simd_shuffle_avx2_in_place_unrolled, CPU_AVX2) \
+	X(simd_shuffle_avx2_prefetch, simd_shuffle_avx2_in_place_prefetch, CPU_AVX2) \
+	X(simd_shuffle_avx512, simd_shuffle_avx512_in_place, CPU_AVX512F | CPU_AVX512BW) \
+	X(simd_shuffle_avx512_unrolled, simd_shuffle_avx512_in_place_unrolled, CPU_AVX512F | CPU_AVX512BW) \
+	X(simd_shuffle_avx512_prefetch, simd_shuffle_avx512_in_place_prefetch, CPU_AVX512F | CPU_AVX512BW) \
+	X(simd_permute_avx512vbmi, simd_permute_avx512vbmi_in_place, CPU_AVX512F | CPU_AVX512VBMI) \
+	X(simd_permute_avx512vbmi_unrolled, simd_permute_avx512vbmi_in_place_unrolled, CPU_AVX512F | CPU_AVX512VBMI) \
+	X(parallel, parallel_in_place, CPU_SSSE3)
+
+// Reversing between partially overlapping buffers (i.e. when compacting a ring buffer), like memmove for copies
+// With dst = src + d, src consists of a head A of d bytes followed by the rest B. The result rev(B) rev(A) has rev(B) exactly where B already
+// is and rev(A) in the d bytes behind the end of src, which aren't part of src. So B is reversed in place and A is reversed into those d
+// bytes, neither of which overwrites any source byte that is still needed. dst = src - d is the same with the roles of both ends swapped.
+// Every byte is read and written once, without any scratch or staging buffer.
+#define REVERSE_MOVE(name, reverse_chunk, swap_chunks) \
+	static void name(Buffer src, Buffer dst) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		u64 size = src.size; \
+		u8 *s = src.data; \
+		u8 *d = dst.data; \
+		if (d >= s + size || s >= d + size) { \
+			reverse_chunk(d, s, size); \
+		} else { \
+			u64 shift = d >= s ? (u64)(d - s) : (u64)(s - d); \
+			u64 half  = (size - shift)/2; \
+			u8 *rest  = d >= s ? d : s; /* The part of src that is reversed in place */ \
+			if (d >= s) reverse_chunk(s + size, s, shift); \
+			else        reverse_chunk(d, s + size - shift, shift); \
+			swap_chunks(rest, rest + size - shift - half, half); \
+		} \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+REVERSE_MOVE(reverse_move_sse,    reverse_chunk_sse,    swap_chunks_sse)
+REVERSE_MOVE(reverse_move_avx2,   reverse_chunk_avx2,   swap_chunks_avx2)
+REVERSE_MOVE(reverse_move_avx512, reverse_chunk_avx512, swap_chunks_avx512)
+
+// The two-pass approaches that reverse_move replaces
+// reverse_move_scratch:  Reverses src into a freshly allocated scratch buffer and moves that into dst
+// reverse_move_memmove:  Reverses src in place and moves it into dst, which needs no allocation but still touches every byte twice
+static void reverse_move_scratch(Buffer src, Buffer dst)
+{
+	AIL_BENCH_PROFILE_START(reverse_move_scratch);
+	u8 *scratch = malloc(AIL_MAX(src.size, 1));
+	reverse_chunk(scratch, src.data, src.size);
+	memmove(dst.data, scratch, src.size);
+	free(scratch);
+	AIL_BENCH_PROFILE_END(reverse_move_scratch);
+}
+
+static void reverse_move_memmove(Buffer src, Buffer dst)
+{
+	AIL_BENCH_PROFILE_START(reverse_move_memmove);
+	u64 half = src.size/2;
+	swap_chunks(src.data, src.data + src.size - half, half);
+	memmove(dst.data, src.data, src.size);
+	AIL_BENCH_PROFILE_END(reverse_move_memmove);
+}
+
+// X(func, required CPU features)
+#define MOVE_FUNCTIONS \
+	X(reverse_move_sse, CPU_SSSE3) \
+	X(reverse_move_avx2, CPU_AVX2) \
+	X(reverse_move_avx512, CPU_AVX512F | CPU_AVX512BW) \
+	X(reverse_move_scratch, CPU_SSSE3) \
+	X(reverse_move_memmove, CPU_SSSE3)
+
+// Reversing arrays of elements that are larger than a byte (i.e. u16/u32/u64 or structs)
+// The order of the elements is reversed, but each element keeps its internal byte order
+
+// Generic fallback for any element size
+static inline void reverse_elems_scalar(u8 *dst, u8 *src, u64 size, u64 elem_size)
+{
+	u64 n = size / elem_size;
+	for (u64 i = 0; i < n; i++) {
+		memcpy(dst + (n - i - 1)*elem_size, src + i*elem_size, elem_size);
+	}
+}
+
+static inline void reverse_elems_scalar_in_place(u8 *buf, u64 size, u64 elem_size)
+{
+	u64 n = size / elem_size;
+	for (u64 i = 0; i < n/2; i++) {
+		u8 *a = buf + i*elem_size;
+		u8 *b = buf + (n - i - 1)*elem_size;
+		for (u64 j = 0; j < elem_size; j++) {
+			u8 tmp = a[j];
+			a[j] = b[j];
+			b[j] = tmp;
+		}
+	}
+}
+
+// Records of common sizes get their own instantiation of the generic loop, so that the compiler can replace the memcpy with plain moves
+static void reverse_records(u8 *dst, u8 *src, u64 size, u64 elem_size)
+{
+	switch (elem_size) {
+		case 12: reverse_elems_scalar(dst, src, size, 12); break;
+		case 24: reverse_elems_scalar(dst, src, size, 24); break;
+		case 48: reverse_elems_scalar(dst, src, size, 48); break;
+		default: reverse_elems_scalar(dst, src, size, elem_size); break;
+	}
+}
+
+static void reverse_records_in_place(u8 *buf, u64 size, u64 elem_size)
+{
+	switch (elem_size) {
+		case 12: reverse_elems_scalar_in_place(buf, size, 12); break;
+		case 24: reverse_elems_scalar_in_place(buf, size, 24); break;
+		case 48: reverse_elems_scalar_in_place(buf, size, 48); break;
+		default: reverse_elems_scalar_in_place(buf, size, elem_size); break;
+	}
+}
+
+// Elements that fit into a 128-bit lane an even amount of times can be reversed with a single shuffle per lane
+static b32 elem_size_fits_lane(u64 elem_size)
+{
+	return elem_size <= 16 && 16 % elem_size == 0;
+}
+
+// Shuffle mask reversing the order of the elements within a 128-bit lane
+CPU_TARGET("ssse3") static __m128i elem_mask_sse(u64 elem_size)
+{
+	u8 mask_vals[16];
+	for (u64 i = 0; i < 16; i++) mask_vals[i] = (u8)((16/elem_size - i/elem_size - 1)*elem_size + i%elem_size);
+	return _mm_loadu_si128((__m128i*)mask_vals); // Requires SSE2
+}
+AVX2_TARGET   static __m256i elem_mask_avx2(u64 elem_size)   { return _mm256_broadcastsi128_si256(elem_mask_sse(elem_size)); }
+AVX512_TARGET static __m512i elem_mask_avx512(u64 elem_size) { return _mm512_broadcast_i32x4(elem_mask_sse(elem_size)); }
+
+CPU_TARGET("ssse3") static inline __m128i reverse_elems_sse(__m128i x, __m128i mask)
+{
+	return _mm_shuffle_epi8(x, mask); // Requires SSSE3
+}
+
+AVX2_TARGET static inline __m256i reverse_elems_avx2(__m256i x, __m256i mask)
+{
+	return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(x, mask), 0x4e); // Requires AVX2
+}
+
+AVX512_TARGET static inline __m512i reverse_elems_avx512(__m512i x, __m512i mask)
+{
+	const __m512i lanes = _mm512_set_epi64(1, 0, 3, 2, 5, 4, 7, 6);
+	return _mm512_permutexvar_epi64(lanes, _mm512_shuffle_epi8(x, mask)); // Requires AVX-512F and AVX-512BW
+}
+
+// Same loops as REVERSE_KERNEL/REVERSE_KERNEL_IN_PLACE, but the remainder consists of whole elements, which is why it is reversed element-wise
+#define ELEM_REVERSE_CHUNK(name, T, load, store, reverse, make_mask) \
+	static void name(u8 *dst, u8 *src, u64 size, u64 elem_size) \
+	{ \
+		T mask  = make_mask(elem_size); \
+		u64 n   = size / sizeof(T); \
+		u64 rem = size % sizeof(T); \
+		T *s = (T*)src; \
+		T *d = (T*)(dst + rem); \
+		for (u64 i = 0; i < n; i++) { \
+			store(&d[n - i - 1], reverse(load(&s[i]), mask)); \
+		} \
+		reverse_elems_scalar(dst, src + n*sizeof(T), rem, elem_size); \
+	}
+
+#define ELEM_REVERSE_CHUNK_IN_PLACE(name, T, load, store, reverse, make_mask) \
+	static void name(u8 *buf, u64 size, u64 elem_size) \
+	{ \
+		T mask  = make_mask(elem_size); \
+		u64 n   = size / (sizeof(T) * 2); \
+		u64 rem = size % (sizeof(T) * 2); \
+		T *start = (T*)buf; \
+		T *end   = (T*)(buf + size); \
+		for (u64 i = 0; i < n; i++) { \
+			T a = load(start + i); \
+			T b = load(end - i - 1); \
+			store(start + i,   reverse(b, mask)); \
+			store(end - i - 1, reverse(a, mask)); \
+		} \
+		reverse_elems_scalar_in_place(buf + n*sizeof(T), rem, elem_size); \
+	}
+
+CPU_TARGET("ssse3") ELEM_REVERSE_CHUNK(reverse_elems_chunk_sse,                   __m128i, _mm_loadu_si128,    _mm_storeu_si128,    reverse_elems_sse,    elem_mask_sse)
+CPU_TARGET("ssse3") ELEM_REVERSE_CHUNK_IN_PLACE(reverse_elems_chunk_sse_in_place, __m128i, _mm_loadu_si128,    _mm_storeu_si128,    reverse_elems_sse,    elem_mask_sse)
+AVX2_TARGET         ELEM_REVERSE_CHUNK(reverse_elems_chunk_avx2,                  __m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_elems_avx2,   elem_mask_avx2)
+AVX2_TARGET         ELEM_REVERSE_CHUNK_IN_PLACE(reverse_elems_chunk_avx2_in_place,__m256i, _mm256_loadu_si256, _mm256_storeu_si256, reverse_elems_avx2,   elem_mask_avx2)
+AVX512_TARGET       ELEM_REVERSE_CHUNK(reverse_elems_chunk_avx512,                __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_elems_avx512, elem_mask_avx512)
+AVX512_TARGET       ELEM_REVERSE_CHUNK_IN_PLACE(reverse_elems_chunk_avx512_in_place, __m512i, _mm512_loadu_si512, _mm512_storeu_si512, reverse_elems_avx512, elem_mask_avx512)
+
+static void elem_scalar(Buffer src, Buffer dst, u64 elem_size)
+{
+	AIL_BENCH_PROFILE_START(elem_scalar);
+	reverse_elems_scalar(dst.data, src.data, src.size, elem_size);
+	AIL_BENCH_PROFILE_END(elem_scalar);
+}
 
+static void elem_scalar_in_place(Buffer buf, u64 elem_size)
+{
+	AIL_BENCH_PROFILE_START(elem_scalar_in_place);
+	reverse_elems_scalar_in_place(buf.data, buf.size, elem_size);
+	AIL_BENCH_PROFILE_END(elem_scalar_in_place);
+}
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#	define BSWAP16(x) _byteswap_ushort(x)
+#	define BSWAP32(x) _byteswap_ulong(x)
+#	define BSWAP64(x) _byteswap_uint64(x)
+#else
+#	define BSWAP16(x) __builtin_bswap16(x)
+#	define BSWAP32(x) __builtin_bswap32(x)
+#	define BSWAP64(x) __builtin_bswap64(x)
+#endif
+
+// Reverses all bytes and then restores the byte order within each element in a second pass
+// This is what has to be done without an element-aware reversal and is only included for comparison
+static void swap_elem_bytes(u8 *buf, u64 size, u64 elem_size)
+{
+	switch (elem_size) {
+		case 1: break;
+		case 2: for (u64 i = 0; i < size; i += 2) { u16 x; memcpy(&x, buf + i, 2); x = BSWAP16(x); memcpy(buf + i, &x, 2); } break;
+		case 4: for (u64 i = 0; i < size; i += 4) { u32 x; memcpy(&x, buf + i, 4); x = BSWAP32(x); memcpy(buf + i, &x, 4); } break;
+		case 8: for (u64 i = 0; i < size; i += 8) { u64 x; memcpy(&x, buf + i, 8); x = BSWAP64(x); memcpy(buf + i, &x, 8); } break;
+		default:
+			for (u64 i = 0; i < size; i += elem_size) {
+				for (u64 j = 0; j < elem_size/2; j++) {
+					u8 tmp = buf[i + j];
+					buf[i + j] = buf[i + elem_size - j - 1];
+					buf[i + elem_size - j - 1] = tmp;
+				}
+			}
+	}
+}
+
+CPU_TARGET("ssse3") static void elem_two_pass(Buffer src, Buffer dst, u64 elem_size)
+{
+	AIL_BENCH_PROFILE_START(elem_two_pass);
+	reverse_chunk(dst.data, src.data, src.size);
+	swap_elem_bytes(dst.data, dst.size, elem_size);
+	AIL_BENCH_PROFILE_END(elem_two_pass);
+}
+
+CPU_TARGET("ssse3") static void elem_two_pass_in_place(Buffer buf, u64 elem_size)
+{
+	AIL_BENCH_PROFILE_START(elem_two_pass_in_place);
+	swap_chunks(buf.data, buf.data + buf.size - buf.size/2, buf.size/2);
+	swap_elem_bytes(buf.data, buf.size, elem_size);
+	AIL_BENCH_PROFILE_END(elem_two_pass_in_place);
+}
+
+#define ELEM_KERNEL(name, chunk) \
+	static void name(Buffer src, Buffer dst, u64 elem_size) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		AIL_ASSERT(src.size % elem_size == 0); \
+		if (elem_size_fits_lane(elem_size)) chunk(dst.data, src.data, src.size, elem_size); \
+		else                                reverse_records(dst.data, src.data, src.size, elem_size); \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+#define ELEM_KERNEL_IN_PLACE(name, chunk) \
+	static void name(Buffer buf, u64 elem_size) \
+	{ \
+		AIL_BENCH_PROFILE_START(name); \
+		AIL_ASSERT(buf.size % elem_size == 0); \
+		if (elem_size_fits_lane(elem_size)) chunk(buf.data, buf.size, elem_size); \
+		else                                reverse_records_in_place(buf.data, buf.size, elem_size); \
+		AIL_BENCH_PROFILE_END(name); \
+	}
+
+CPU_TARGET("ssse3") ELEM_KERNEL(elem_simd,                          reverse_elems_chunk_sse)
+CPU_TARGET("ssse3") ELEM_KERNEL_IN_PLACE(elem_simd_in_place,        reverse_elems_chunk_sse_in_place)
+AVX2_TARGET         ELEM_KERNEL(elem_simd_avx2,                     reverse_elems_chunk_avx2)
+AVX2_TARGET         ELEM_KERNEL_IN_PLACE(elem_simd_avx2_in_place,   reverse_elems_chunk_avx2_in_place)
+AVX512_TARGET       ELEM_KERNEL(elem_simd_avx512,                   reverse_elems_chunk_avx512)
+AVX512_TARGET       ELEM_KERNEL_IN_PLACE(elem_simd_avx512_in_place, reverse_elems_chunk_avx512_in_place)
+
+// X(func, func_in_place, required CPU features)
+#define ELEM_FUNCTIONS \
+	X(elem_scalar, elem_scalar_in_place, 0) \
+	X(elem_two_pass, elem_two_pass_in_place, CPU_SSSE3) \
+	X(elem_simd, elem_simd_in_place, CPU_SSSE3) \
+	X(elem_simd_avx2, elem_simd_avx2_in_place, CPU_AVX2) \
+	X(elem_simd_avx512, elem_simd_avx512_in_place, CPU_AVX512F | CPU_AVX512BW)
+
+
+// Streaming reversal of files, which only need to fit onto the disk instead of into memory
+// The file is read in chunks from its end, each chunk is reversed with the widest SIMD kernel and written sequentially to the output.
+// Up to `depth` chunks are in flight with io_uring, so the disk keeps reading/writing the next chunks while the current one is reversed.
+
+#if defined(__linux__)
+// O_DIRECT is only defined with _GNU_SOURCE, which would have to be defined before the first include
+#ifndef O_DIRECT
+#	define O_DIRECT __O_DIRECT
+#endif
+#define STREAM_ALIGN 4096     // O_DIRECT requires buffers, offsets and sizes to be aligned to the logical block size
+#define STREAM_MAX_DEPTH 8
+
+typedef enum {
+	STREAM_COPY,             // Copies the file without reversing it, which measures the raw bandwidth of the same I/O pattern
+	STREAM_REVERSE,          // Reverses src into dst
+	STREAM_REVERSE_IN_PLACE, // Swaps the reversals of mirrored chunks of src
+} Stream_Mode;
+
+typedef struct {
+	Stream_Mode mode;
+	int src;
+	int dst;       // Ignored in place
+	u64 size;
+	u64 chunk;     // Multiple of elem_size
+	u64 elem_size;
+	u32 depth;
+	u8 *in;        // Two chunks per slot for reading and two chunks per slot for the reversals
+	u8 *out;
+} Stream;
+
+// A job consists of one or two segments of the source, each of which is written reversed to its mirrored position
+typedef struct {
+	u64 off[2];
+	u64 len[2];
+	u32 count;
+} Stream_Job;
+
+static u64 stream_job_count(const Stream *s)
+{
+	if (s->mode != STREAM_REVERSE_IN_PLACE) return (s->size + s->chunk - 1) / s->chunk;
+	return s->size / (2*s->chunk) + (s->size % (2*s->chunk) != 0);
+}
+
+static Stream_Job stream_job(const Stream *s, u64 k)
+{
+	Stream_Job job = { .count = 1 };
+	if (s->mode == STREAM_COPY) {
+		job.off[0] = k*s->chunk;
+		job.len[0] = AIL_MIN(s->chunk, s->size - job.off[0]);
+	} else if (s->mode == STREAM_REVERSE) {
+		u64 end = s->size - k*s->chunk;
+		job.len[0] = AIL_MIN(s->chunk, end);
+		job.off[0] = end - job.len[0];
+	} else if (k < s->size / (2*s->chunk)) {
+		job.count  = 2;
+		job.off[0] = k*s->chunk;
+		job.off[1] = s->size - (k + 1)*s->chunk;
+		job.len[0] = job.len[1] = s->chunk;
+	} else {
+		// The middle of the file, that is shorter than two chunks, is its own mirror image
+		job.off[0] = k*s->chunk;
+		job.len[0] = s->size - 2*k*s->chunk;
+	}
+	return job;
+}
+
+static u64 stream_write_offset(const Stream *s, Stream_Job job, u32 seg)
+{
+	return s->mode == STREAM_COPY ? job.off[seg] : s->size - job.off[seg] - job.len[seg];
+}
+
+static u8 *stream_in(const Stream *s, u32 slot, u32 seg)  { return s->in  + (2*slot + seg)*s->chunk; }
+static u8 *stream_out(const Stream *s, u32 slot, u32 seg) { return s->mode == STREAM_COPY ? stream_in(s, slot, seg) : s->out + (2*slot + seg)*s->chunk; }
+
+// Reverses the order of the elements of `src` into `dst` with the widest kernel this CPU supports
+CPU_TARGET("ssse3") static void reverse_file_chunk(u8 *dst, u8 *src, u64 size, u64 elem_size)
+{
+	if      (elem_size == 1)                              reverse_chunk(dst, src, size);
+	else if (!elem_size_fits_lane(elem_size))             reverse_records(dst, src, size, elem_size);
+	else if (cpu_supports(CPU_AVX512F | CPU_AVX512BW))    reverse_elems_chunk_avx512(dst, src, size, elem_size);
+	else if (cpu_supports(CPU_AVX2))                      reverse_elems_chunk_avx2(dst, src, size, elem_size);
+	else                                                  reverse_elems_chunk_sse(dst, src, size, elem_size);
+}
+
+CPU_TARGET("ssse3") static void reverse_file_chunk_in_place(u8 *buf, u64 size, u64 elem_size)
+{
+	if      (elem_size == 1)                              swap_chunks(buf, buf + size - size/2, size/2);
+	else if (!elem_size_fits_lane(elem_size))             reverse_records_in_place(buf, size, elem_size);
+	else if (cpu_supports(CPU_AVX512F | CPU_AVX512BW))    reverse_elems_chunk_avx512_in_place(buf, size, elem_size);
+	else if (cpu_supports(CPU_AVX2))                      reverse_elems_chunk_avx2_in_place(buf, size, elem_size);
+	else                                                  reverse_elems_chunk_sse_in_place(buf, size, elem_size);
+}
+
+static void stream_process(const Stream *s, Stream_Job job, u32 slot)
+{
+	if (s->mode == STREAM_COPY) return;
+	for (u32 seg = 0; seg < job.count; seg++) {
+		reverse_file_chunk(stream_out(s, slot, seg), stream_in(s, slot, seg), job.len[seg], s->elem_size);
+	}
+}
+
+static b32 stream_run_sync(const Stream *s)
+{
+	int dst = s->mode == STREAM_REVERSE_IN_PLACE ? s->src : s->dst;
+	for (u64 k = 0, count = stream_job_count(s); k < count; k++) {
+		Stream_Job job = stream_job(s, k);
+		for (u32 seg = 0; seg < job.count; seg++) {
+			if (pread(s->src, stream_in(s, 0, seg), job.len[seg], (off_t)job.off[seg]) != (ssize_t)job.len[seg]) return 0;
+		}
+		stream_process(s, job, 0);
+		for (u32 seg = 0; seg < job.count; seg++) {
+			if (pwrite(dst, stream_out(s, 0, seg), job.len[seg], (off_t)stream_write_offset(s, job, seg)) != (ssize_t)job.len[seg]) return 0;
+		}
+	}
+	return 1;
+}
 
-static u64 test_buffer_sizes[] = { 1, 15, 16, 17, 25, 31, 32, 33, 511, 512, 513, AIL_KB(1) + 15, AIL_KB(1) + 17 };
+// The user_data of a submission holds its length in the upper half, followed by its slot and a bit that marks writes
+static u64 stream_user_data(u32 slot, b32 is_write, u64 len)
+{
+	return (len << 32) | ((u64)slot << 1) | (is_write ? 1 : 0);
+}
+
+// A segment that was read or written only partially fails the stream, since it would be reversed or stored incompletely
+static b32 stream_wait_cqe(Uring *ring, struct io_uring_cqe *cqe)
+{
+	return uring_wait_cqe(ring, cqe) && cqe->res >= 0 && (u64)cqe->res == cqe->user_data >> 32;
+}
+
+// Jobs are processed in order, job k uses the buffers of slot k % depth
+// The reads of a job are submitted as soon as its slot's input buffers are free, which is after the previous job of the slot was
+// reversed (or after its writes completed when copying, since those are written directly from the input buffers)
+static b32 stream_run_uring(const Stream *s, Uring *ring)
+{
+	int dst    = s->mode == STREAM_REVERSE_IN_PLACE ? s->src : s->dst;
+	u64 count  = stream_job_count(s);
+	u64 next   = 0; // Next job whose reads haven't been submitted yet
+	u32 reads[STREAM_MAX_DEPTH]  = {0};
+	u32 writes[STREAM_MAX_DEPTH] = {0};
+	for (u64 k = 0; k < count; k++) {
+		u32 slot = k % s->depth;
+		for (;;) {
+			while (next < count && next < k + s->depth && (s->mode != STREAM_COPY || !writes[next % s->depth])) {
+				Stream_Job job = stream_job(s, next);
+				u32 next_slot  = next % s->depth;
+				for (u32 seg = 0; seg < job.count; seg++) {
+					uring_prep_rw(uring_get_sqe(ring), IORING_OP_READ, s->src, stream_in(s, next_slot, seg), (u32)job.len[seg], job.off[seg], stream_user_data(next_slot, 0, job.len[seg]));
+				}
+				reads[next_slot] = job.count;
+				next++;
+			}
+			if (next > k && !reads[slot] && !writes[slot]) break;
+			struct io_uring_cqe cqe;
+			if (!stream_wait_cqe(ring, &cqe)) return 0;
+			if (cqe.user_data & 1) writes[(u32)cqe.user_data >> 1]--;
+			else                   reads[(u32)cqe.user_data >> 1]--;
+		}
+		Stream_Job job = stream_job(s, k);
+		stream_process(s, job, slot);
+		for (u32 seg = 0; seg < job.count; seg++) {
+			uring_prep_rw(uring_get_sqe(ring), IORING_OP_WRITE, dst, stream_out(s, slot, seg), (u32)job.len[seg], stream_write_offset(s, job, seg), stream_user_data(slot, 1, job.len[seg]));
+		}
+		writes[slot] = job.count;
+		if (uring_submit(ring, 0) < 0) return 0;
+	}
+	for (u32 slot = 0; slot < s->depth; slot++) {
+		while (writes[slot]) {
+			struct io_uring_cqe cqe;
+			if (!stream_wait_cqe(ring, &cqe)) return 0;
+			writes[(u32)cqe.user_data >> 1]--;
+		}
+	}
+	return 1;
+}
+
+// Falls back to synchronous I/O if io_uring is unavailable, in which case the disk is idle while a chunk is reversed
+static b32 stream_run(const Stream *s)
+{
+	static b32 warned;
+	Uring ring;
+	if (s->depth < 2 || !uring_init(&ring, 4*s->depth)) {
+		if (s->depth >= 2 && !warned) {
+			warned = 1;
+			printf("\033[33mio_uring is unavailable, files are streamed with synchronous I/O instead\033[0m\n");
+		}
+		return stream_run_sync(s);
+	}
+	b32 ok = stream_run_uring(s, &ring);
+	uring_deinit(&ring);
+	return ok;
+}
+
+// Smallest multiple of both the element size and STREAM_ALIGN, which sizes and chunks of files opened with O_DIRECT have to be multiples of
+static u64 stream_unit(u64 elem_size)
+{
+	u64 a = STREAM_ALIGN, b = elem_size;
+	while (b) { u64 t = a % b; a = b; b = t; }
+	return STREAM_ALIGN / a * elem_size;
+}
+
+// Allocates the buffers of a stream, `chunk` is rounded down to a multiple of the element size
+// The size has to be a multiple of the element size as well
+static Stream stream_init(Stream_Mode mode, int src, int dst, u64 size, u64 chunk, u64 elem_size, u32 depth)
+{
+	Stream s = {
+		.mode = mode, .src = src, .dst = dst, .size = size, .elem_size = elem_size,
+		.chunk = AIL_MAX(elem_size, chunk - chunk % elem_size),
+		.depth = AIL_MIN(AIL_MAX(depth, 1), STREAM_MAX_DEPTH),
+	};
+	Page_Kind pages;
+	s.in  = pages_alloc(4*s.depth*s.chunk, PAGES_4K, 0, &pages);
+	s.out = s.in + 2*s.depth*s.chunk;
+	return s;
+}
+
+static void stream_deinit(Stream *s)
+{
+	pages_free(s->in, 4*s->depth*s->chunk, PAGES_4K);
+}
+#endif
+
+static u64 test_elem_sizes[]  = { 1, 2, 4, 8, 12, 16, 24, 48, 3, 5 };
+static u64 bench_elem_sizes[] = { 2, 4, 8, 12, 16, 24, 48 };
+
+static u64 test_buffer_sizes[] = { 1, 15, 16, 17, 25, 31, 32, 33, 511, 512, 513, AIL_KB(1) + 15, AIL_KB(1) + 17, 48*33, 48*100 + 24 };
 typedef Buffer BufferList[AIL_ARRLEN(test_buffer_sizes)][2];
 typedef void (FuncType)(Buffer src, Buffer dst);
 typedef void (FuncInPlaceType)(Buffer buf);
+typedef void (ElemFuncType)(Buffer src, Buffer dst, u64 elem_size);
+typedef void (ElemFuncInPlaceType)(Buffer buf, u64 elem_size);
+
+typedef struct Func {
+	char *name;
+	FuncType *func;
+	char *in_place_name;
+	FuncInPlaceType *func_in_place;
+	u32 features; // CPU_Feature flags that are required for running both functions
+} Func;
+#define X(func, func_in_place, features) { AIL_STRINGIFY(func), func, AIL_STRINGIFY(func_in_place), func_in_place, features },
+static Func funcs[MAX_FUNC_COUNT] = { FUNCTIONS };
+#undef X
+static u64 funcs_count;
 
-static void test(BufferList buffers, FuncType func, FuncInPlaceType func_in_place, char *func_name, char *func_in_place_name)
+typedef struct ElemFunc {
+	char *name;
+	ElemFuncType *func;
+	char *in_place_name;
+	ElemFuncInPlaceType *func_in_place;
+	u32 features;
+} ElemFunc;
+#define X(func, func_in_place, features) { AIL_STRINGIFY(func), func, AIL_STRINGIFY(func_in_place), func_in_place, features },
+static ElemFunc elem_funcs[MAX_FUNC_COUNT] = { ELEM_FUNCTIONS };
+#undef X
+static u64 elem_funcs_count;
+
+typedef struct MoveFunc {
+	char *name;
+	FuncType *func; // src and dst may overlap
+	u32 features;
+} MoveFunc;
+#define X(func, features) { AIL_STRINGIFY(func), func, features },
+static MoveFunc move_funcs[MAX_FUNC_COUNT] = { MOVE_FUNCTIONS };
+#undef X
+static u64 move_funcs_count;
+
+static b32 is_supported(char *name, char *in_place_name, u32 features)
+{
+	if (cpu_supports(features)) return 1;
+	char missing[64];
+	cpu_features_to_str(features & ~cpu_features(), missing, sizeof(missing));
+	printf("\033[33mSkipping %s and %s, since this CPU doesn't support %s\033[0m\n", name, in_place_name, missing);
+	return 0;
+}
+
+static u64 filter_supported_move_funcs(MoveFunc *funcs, u64 cap)
+{
+	u64 count = 0;
+	for (u64 i = 0; i < cap && funcs[i].name; i++) {
+		if (cpu_supports(funcs[i].features)) funcs[count++] = funcs[i];
+		else printf("\033[33mSkipping %s, since this CPU doesn't support all of its extensions\033[0m\n", funcs[i].name);
+	}
+	for (u64 i = count; i < cap; i++) funcs[i] = (MoveFunc){0};
+	return count;
+}
+
+// Removes all functions from the list that can't be run on this CPU and returns the amount of remaining functions
+static u64 filter_supported_funcs(Func *funcs, u64 cap)
+{
+	u64 count = 0;
+	for (u64 i = 0; i < cap && funcs[i].name; i++) {
+		if (is_supported(funcs[i].name, funcs[i].in_place_name, funcs[i].features)) funcs[count++] = funcs[i];
+	}
+	for (u64 i = count; i < cap; i++) funcs[i] = (Func){0};
+	return count;
+}
+
+static u64 filter_supported_elem_funcs(ElemFunc *funcs, u64 cap)
+{
+	u64 count = 0;
+	for (u64 i = 0; i < cap && funcs[i].name; i++) {
+		if (is_supported(funcs[i].name, funcs[i].in_place_name, funcs[i].features)) funcs[count++] = funcs[i];
+	}
+	for (u64 i = count; i < cap; i++) funcs[i] = (ElemFunc){0};
+	return count;
+}
+
+static Plugin plugins[MAX_PLUGIN_COUNT];
+static u32 plugins_count;
+
+// The profiler only reports routines with an anchor of their own, so plugin routines are called through these trampolines,
+// whose profiles are printed as plugin_<index> and plugin_in_place_<index> (load_plugins prints which routine got which index)
+#define MAX_PLUGIN_FUNC_COUNT 8
+static FuncType *plugin_funcs[MAX_PLUGIN_FUNC_COUNT];
+static FuncInPlaceType *plugin_funcs_in_place[MAX_PLUGIN_FUNC_COUNT];
+static u32 plugin_funcs_count;
+#define PLUGIN_TRAMPOLINES(k) \
+	static void plugin_##k(Buffer src, Buffer dst) \
+	{ \
+		AIL_BENCH_PROFILE_START(plugin_##k); \
+		plugin_funcs[k](src, dst); \
+		AIL_BENCH_PROFILE_END(plugin_##k); \
+	} \
+	static void plugin_in_place_##k(Buffer buf) \
+	{ \
+		AIL_BENCH_PROFILE_START(plugin_in_place_##k); \
+		plugin_funcs_in_place[k](buf); \
+		AIL_BENCH_PROFILE_END(plugin_in_place_##k); \
+	}
+PLUGIN_TRAMPOLINES(0) PLUGIN_TRAMPOLINES(1) PLUGIN_TRAMPOLINES(2) PLUGIN_TRAMPOLINES(3)
+PLUGIN_TRAMPOLINES(4) PLUGIN_TRAMPOLINES(5) PLUGIN_TRAMPOLINES(6) PLUGIN_TRAMPOLINES(7)
+static FuncType *plugin_trampolines[MAX_PLUGIN_FUNC_COUNT] = { plugin_0, plugin_1, plugin_2, plugin_3, plugin_4, plugin_5, plugin_6, plugin_7 };
+static FuncInPlaceType *plugin_trampolines_in_place[MAX_PLUGIN_FUNC_COUNT] = {
+	plugin_in_place_0, plugin_in_place_1, plugin_in_place_2, plugin_in_place_3, plugin_in_place_4, plugin_in_place_5, plugin_in_place_6, plugin_in_place_7,
+};
+
+// Loads the shared object of every `-plugin path:reverse/reverse_in_place,...` argument and appends each pair of routines to funcs
+// They are tested and benchmarked like the built-in ones, so they need to have the signatures of FuncType and FuncInPlaceType,
+// including the layout of Buffer
+static void load_plugins(int argc, char **argv)
+{
+	plugins_count = plugin_open_all(argc, argv, plugins, MAX_PLUGIN_COUNT);
+	for (u32 i = 0; i < plugins_count; i++) {
+		Plugin *p = &plugins[i];
+		for (u32 j = 0; j < p->symbol_count; j++) {
+			char *symbol = p->symbols[j];
+			char *in_place_symbol = strchr(symbol, '/');
+			if (!in_place_symbol) {
+				printf("\033[31mInvalid routines '%s' of the plugin '%s', expected reverse/reverse_in_place\033[0m\n", symbol, p->path);
+				continue;
+			}
+			*in_place_symbol++ = 0;
+			FuncType *func = (FuncType*)plugin_symbol(p, symbol);
+			FuncInPlaceType *func_in_place = (FuncInPlaceType*)plugin_symbol(p, in_place_symbol);
+			if (!func || !func_in_place) continue;
+			if (funcs_count == MAX_FUNC_COUNT || plugin_funcs_count == MAX_PLUGIN_FUNC_COUNT) {
+				printf("\033[33mSkipping %s and %s of the plugin '%s', since too many routines were loaded\033[0m\n", symbol, in_place_symbol, p->path);
+				continue;
+			}
+			u32 k = plugin_funcs_count++;
+			plugin_funcs[k] = func;
+			plugin_funcs_in_place[k] = func_in_place;
+			funcs[funcs_count++] = (Func){ plugin_name(p, symbol), plugin_trampolines[k], plugin_name(p, in_place_symbol), plugin_trampolines_in_place[k], 0 };
+			printf("Loaded %s and %s (profiled as plugin_%u and plugin_in_place_%u)\n", funcs[funcs_count - 1].name, funcs[funcs_count - 1].in_place_name, k, k);
+		}
+	}
+}
+
+static void test(BufferList buffers, Func func)
 {
 	for (u64 i = 0; i < AIL_ARRLEN(test_buffer_sizes); i++) {
 		Buffer buf = buffers[i][0];
 		Buffer dst = buffers[i][1];
 		fill_buffer(buf);
 		fill_buffer(dst);
-		func(buf, dst);
-			if (!test_buffer(dst)) {
-			printf("\033[31m%s failed test for buffer-size %zd :(\033[0m\n", func_name, test_buffer_sizes[i]);
+		func.func(buf, dst);
+			if (!test_buffer(dst, 1)) {
+			printf("\033[31m%s failed test for buffer-size %zd :(\033[0m\n", func.name, test_buffer_sizes[i]);
 			return;
 		}
 
 		fill_buffer(buf);
-		func_in_place(buf);
-		if (!test_buffer(buf)) {
-			printf("\033[31m%s failed test for buffer-size %zd :(\033[0m\n", func_in_place_name, test_buffer_sizes[i]);
+		func.func_in_place(buf);
+		if (!test_buffer(buf, 1)) {
+			printf("\033[31m%s failed test for buffer-size %zd :(\033[0m\n", func.in_place_name, test_buffer_sizes[i]);
 			return;
 		}
 	}
-	printf("\033[32m%s succeeded all tests :)\033[0m\n", func_name);
-	printf("\033[32m%s succeeded all tests :)\033[0m\n", func_in_place_name);
+	printf("\033[32m%s succeeded all tests :)\033[0m\n", func.name);
+	printf("\033[32m%s succeeded all tests :)\033[0m\n", func.in_place_name);
 }
 
+// Every buffer size is rounded down to a multiple of each element size
+static void test_elem(BufferList buffers, ElemFunc func)
+{
+	for (u64 k = 0; k < AIL_ARRLEN(test_elem_sizes); k++) {
+		u64 elem_size = test_elem_sizes[k];
+		for (u64 i = 0; i < AIL_ARRLEN(test_buffer_sizes); i++) {
+			u64 size = test_buffer_sizes[i] - test_buffer_sizes[i] % elem_size;
+			if (!size) continue;
+			Buffer buf = { .size = size, .data = buffers[i][0].data };
+			Buffer dst = { .size = size, .data = buffers[i][1].data };
+			fill_buffer(buf);
+			fill_buffer(dst);
+			func.func(buf, dst, elem_size);
+			if (!test_buffer(dst, elem_size)) {
+				printf("\033[31m%s failed test for buffer-size %zd and element-size %zd :(\033[0m\n", func.name, size, elem_size);
+				return;
+			}
+
+			fill_buffer(buf);
+			func.func_in_place(buf, elem_size);
+			if (!test_buffer(buf, elem_size)) {
+				printf("\033[31m%s failed test for buffer-size %zd and element-size %zd :(\033[0m\n", func.in_place_name, size, elem_size);
+				return;
+			}
+		}
+	}
+	printf("\033[32m%s succeeded all tests :)\033[0m\n", func.name);
+	printf("\033[32m%s succeeded all tests :)\033[0m\n", func.in_place_name);
+}
+
+// Overlaps of src and dst like mem-copy's test_inputs: `overlap_size` bytes are shared, with dst on the left or the right of src
+// An overlap of 0 means separate buffers and an overlap of the whole size means dst == src
 typedef struct {
-	u32 width;
-	u32 height;
-	u32 row;
-	u32 col;
-	char **func_names;
-	u64 *mem_sizes;
-	f64 *times_in_ms;
-} Table;
+	u64 size;
+	u64 overlap_size;
+	b32 overlap_left;
+} Move_Input;
+
+static void test_move(MoveFunc func)
+{
+	u64 sizes[] = { 0, 1, 2, 3, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, 511, 512, 513, AIL_KB(1) + 15, AIL_KB(4) + 17, 48*100 + 24 };
+	for (u64 i = 0; i < AIL_ARRLEN(sizes); i++) {
+		u64 size = sizes[i];
+		u64 overlaps[] = { 0, 1, 2, 15, 16, 17, 63, 64, 65, size/2, size/2 + 1, size - 64, size - 17, size - 16, size - 1, size };
+		for (u64 j = 0; j < AIL_ARRLEN(overlaps); j++) {
+			for (u32 left = 0; left < 2; left++) {
+				Move_Input in = { size, overlaps[j], left };
+				if (in.overlap_size > size || (size && in.overlap_size == 0 && left)) continue;
+				// Separate buffers are placed a gap apart, so that writes past the end of dst are detected as well
+				u64 shift = in.overlap_size ? size - in.overlap_size : size + 64;
+				Buffer region = get_buffer(size + shift + 64);
+				memset(region.data, 0xcc, region.size);
+				Buffer src = { .size = size, .data = region.data + (left ? shift : 0) };
+				Buffer dst = { .size = size, .data = region.data + (left ? 0 : shift) };
+				fill_buffer(src);
+				func.func(src, dst);
+				b32 ok = test_buffer(dst, 1) && region.data[size + shift] == 0xcc;
+				free_buffer(region);
+				if (!ok) {
+					printf("\033[31m%s failed test for buffer-size %zu (with %zu %s-overlapped bytes) :(\033[0m\n", func.name, in.size, in.overlap_size, in.overlap_left ? "left" : "right");
+					return;
+				}
+			}
+		}
+	}
+	printf("\033[32m%s succeeded all tests :)\033[0m\n", func.name);
+}
+
+// The regular test buffers are all smaller than parallel_min_chunk, so parallel and parallel_in_place would never split them.
+// They are therefore additionally tested with a small minimum chunk and at least PARALLEL_TEST_THREADS threads, on odd sizes
+// of one to several chunks per thread, so the last chunk is shorter than the others and the middle byte stays in place.
+#define PARALLEL_TEST_THREADS 4
+#define PARALLEL_TEST_CHUNK   256
+static void test_parallel(void)
+{
+	u32 thread_count = pool.thread_count;
+	u64 min_chunk    = parallel_min_chunk;
+	if (thread_count < PARALLEL_TEST_THREADS) {
+		pool_deinit(&pool);
+		pool_init(&pool, PARALLEL_TEST_THREADS);
+	}
+	parallel_thread_count = pool.thread_count;
+	parallel_min_chunk    = PARALLEL_TEST_CHUNK;
+
+	u64 chunk = PARALLEL_TEST_CHUNK, threads = pool.thread_count;
+	u64 sizes[] = { 2*chunk + 1, 2*threads*chunk - 1, 2*threads*chunk + 1, 3*threads*chunk + 13, 16*threads*chunk + 101 };
+	b32 passed = 1, in_place_passed = 1;
+	for (u64 i = 0; i < AIL_ARRLEN(sizes); i++) {
+		Buffer src = get_buffer(sizes[i]);
+		Buffer dst = get_buffer(sizes[i]);
+		fill_buffer(src);
+		fill_buffer(dst);
+		parallel(src, dst);
+		if (passed && !test_buffer(dst, 1)) {
+			printf("\033[31mparallel failed test for buffer-size %zu (with %zu threads) :(\033[0m\n", sizes[i], threads);
+			passed = 0;
+		}
+		parallel_in_place(src);
+		if (in_place_passed && !test_buffer(src, 1)) {
+			printf("\033[31mparallel_in_place failed test for buffer-size %zu (with %zu threads) :(\033[0m\n", sizes[i], threads);
+			in_place_passed = 0;
+		}
+		free_buffer(src);
+		free_buffer(dst);
+	}
+	if (passed)          printf("\033[32mparallel succeeded all tests with %zu threads :)\033[0m\n", threads);
+	if (in_place_passed) printf("\033[32mparallel_in_place succeeded all tests with %zu threads :)\033[0m\n", threads);
+
+	parallel_min_chunk = min_chunk;
+	if (thread_count < PARALLEL_TEST_THREADS) {
+		pool_deinit(&pool);
+		pool_init(&pool, thread_count);
+	}
+	parallel_thread_count = pool.thread_count;
+}
+
+#if defined(__linux__)
+// Streams the test buffers through files in chunks of a few elements, which covers every kind of job including the middle of the in-place reversal
+static void test_stream_reverse(BufferList buffers, const char *dir)
+{
+	char src_path[512], dst_path[512];
+	snprintf(src_path, sizeof(src_path), "%s/speedy-reverse-test-src.bin", dir);
+	snprintf(dst_path, sizeof(dst_path), "%s/speedy-reverse-test-dst.bin", dir);
+	int src = open(src_path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	int dst = open(dst_path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if (src < 0 || dst < 0) {
+		printf("\033[33mSkipping the tests of the streaming file reversal, since no files could be created in %s: %s\033[0m\n", dir, strerror(errno));
+	} else {
+		const char *names[] = { "stream_reverse", "stream_reverse_in_place" };
+		Stream_Mode modes[] = { STREAM_REVERSE, STREAM_REVERSE_IN_PLACE };
+		for (u32 m = 0; m < AIL_ARRLEN(modes); m++) {
+			b32 ok = 1;
+			for (u64 k = 0; ok && k < AIL_ARRLEN(test_elem_sizes); k++) {
+				u64 elem_size = test_elem_sizes[k];
+				for (u64 i = 0; ok && i < AIL_ARRLEN(test_buffer_sizes); i++) {
+					for (u32 depth = 1; ok && depth <= 3; depth += 2) {
+						Buffer buf = { .size = test_buffer_sizes[i] - test_buffer_sizes[i] % elem_size, .data = buffers[i][0].data };
+						if (!buf.size) continue;
+						fill_buffer(buf);
+						ok = !ftruncate(src, 0) && pwrite(src, buf.data, buf.size, 0) == (ssize_t)buf.size && !ftruncate(dst, (off_t)buf.size);
+						Stream stream = stream_init(modes[m], src, dst, buf.size, 5*elem_size, elem_size, depth);
+						ok = ok && stream_run(&stream) && pread(m ? src : dst, buf.data, buf.size, 0) == (ssize_t)buf.size && test_buffer(buf, elem_size);
+						stream_deinit(&stream);
+						if (!ok) printf("\033[31m%s failed test for file-size %zd, element-size %zd and depth %u :(\033[0m\n", names[m], buf.size, elem_size, depth);
+					}
+				}
+			}
+			if (ok) printf("\033[32m%s succeeded all tests :)\033[0m\n", names[m]);
+		}
+	}
+	if (src >= 0) { close(src); unlink(src_path); }
+	if (dst >= 0) { close(dst); unlink(dst_path); }
+}
+#endif
 
 void get_printable_mem_size(char *str, u64 mem_size)
 {
@@ -241,106 +1398,713 @@ void get_printable_mem_size(char *str, u64 mem_size)
 	else                            snprintf(str, 8, "%zdB", mem_size);
 }
 
-void print_table(Table table)
+static Bench_Driver  bench_driver;
+static Bench_Export  bench_export;
+static Bench_Samples bench_samples[2*MAX_FUNC_COUNT]; // Samples of func and func_in_place of each entry in the list of functions
+
+typedef struct {
+	Buffer buf;
+	Buffer cpy;
+	u64 elem_size;
+} Bench_Ctx;
+
+// The benchmark driver runs routines by index, the even indices are the functions and the odd indices the in-place functions of each entry
+static void bench_run_func(void *ctx, u64 idx)
 {
-	char mem_str[16];
-	if (!table.width) return;
-	printf("Memory Size,%s", table.func_names[0]);
-	for (u32 i = 1; i < table.width;  i++) printf(",%s", table.func_names[i]);
-	for (u32 i = 0; i < table.height; i++) {
-		get_printable_mem_size(mem_str, table.mem_sizes[i]);
-		printf("\n%s", mem_str);
-		for (u32 j = 0; j < table.width; j++) {
-			printf(",%f", table.times_in_ms[i*table.width + j]);
-		}
-	}
-	printf("\n");
+	Bench_Ctx *c = ctx;
+	if (idx & 1) funcs[idx/2].func_in_place(c->buf);
+	else         funcs[idx/2].func(c->buf, c->cpy);
 }
 
-int main(void)
+static void bench_run_elem_func(void *ctx, u64 idx)
 {
-	u64 t0 = ail_bench_cpu_timer();
-#ifdef TEST
-	Buffer buffers[AIL_ARRLEN(test_buffer_sizes)][2];
-	for (u64 i = 0; i < AIL_ARRLEN(test_buffer_sizes); i++) {
-		buffers[i][0] = get_buffer(test_buffer_sizes[i]);
-		buffers[i][1] = get_buffer(test_buffer_sizes[i]);
+	Bench_Ctx *c = ctx;
+	if (idx & 1) elem_funcs[idx/2].func_in_place(c->buf, c->elem_size);
+	else         elem_funcs[idx/2].func(c->buf, c->cpy, c->elem_size);
+}
+
+static void bench_run_parallel(void *ctx, u64 idx)
+{
+	Bench_Ctx *c = ctx;
+	if (idx & 1) parallel_in_place(c->buf);
+	else         parallel(c->buf, c->cpy);
+}
+
+// Reversing out-of-place touches twice as much memory as reversing in place, so the working set is given separately
+static void export_samples(char *name, char *params, Buffer buf, u64 working_set, Bench_Samples *samples)
+{
+	Bench_Key key = { .kernel = name, .params = params, .size = buf.size, .level = bench_level_names[bench_cache_level(working_set)], .pages = page_kind_names[buf.pages] };
+	bench_export_samples(&bench_export, key, samples);
+}
+
+// Fastest out-of-place ([0]) and in-place ([1]) function of a benchmark, by median time
+typedef struct {
+	char *name[2];
+	u64 median[2];
+} Fastest_Funcs;
+
+// Measures all functions in the list on the buffer and exports the results
+static Fastest_Funcs bench_funcs(Buffer buf, Buffer cpy)
+{
+	Bench_Ctx ctx = { buf, cpy, 0 };
+	bench_driver_run(&bench_driver, bench_run_func, &ctx, bench_samples, 2*funcs_count);
+	Fastest_Funcs fastest = { .median = { UINT64_MAX, UINT64_MAX } };
+	for (u64 j = 0; j < funcs_count; j++) {
+		for (u64 k = 0; k < 2; k++) {
+			u64 median = bench_stats(&bench_samples[2*j + k]).median;
+			if (median < fastest.median[k]) {
+				fastest.median[k] = median;
+				fastest.name[k]   = k ? funcs[j].in_place_name : funcs[j].name;
+			}
+		}
 	}
-	#define X(func, func_in_place) test(buffers, func, func_in_place, AIL_STRINGIFY(func), AIL_STRINGIFY(func_in_place));
-		FUNCTIONS
-	#undef X
-	for (u64 i = 0; i < AIL_ARRLEN(buffers); i++) {
-		free_buffer(buffers[i][0]);
-		free_buffer(buffers[i][1]);
+	for (u64 j = 0; j < funcs_count; j++) {
+		export_samples(funcs[j].name,          0, buf, 2*buf.size, &bench_samples[2*j + 0]);
+		export_samples(funcs[j].in_place_name, 0, buf,   buf.size, &bench_samples[2*j + 1]);
 	}
-#endif
-
-#ifdef BENCH
-#ifdef BENCH_AS_CSV
-	void *mem = alloc(AIL_KB(4));
-	Table table;
-	table.row = 0;
-	table.col = 0;
-	table.width  = 0;
-	table.height = 0;
-	table.func_names = mem;
-	for (u32 i = 0; i < AIL_BENCH_PROFILE_ANCHOR_COUNT; i++) {
-		AIL_Bench_Profile_Anchor anchor = ail_bench_global_anchors[i];
-		#define X(func, func_in_place) \
-				if (anchor.label && !strcmp(anchor.label, AIL_STRINGIFY(func)))          table.func_names[table.width++] = AIL_STRINGIFY(func); \
-				if (anchor.label && !strcmp(anchor.label, AIL_STRINGIFY(func_in_place))) table.func_names[table.width++] = AIL_STRINGIFY(func_in_place);
-			FUNCTIONS
-		#undef X
-	}
-	table.mem_sizes = (void*)&table.func_names[table.width];
-	for (u64 i = 128; i <= AIL_GB(2); i <<= 2) table.height++;
-	table.times_in_ms = (void*)&table.mem_sizes[table.height];
-	u64 cpu_freq = ail_bench_cpu_timer_freq();
-#endif
+	return fastest;
+}
 
+// Sweeps from 128B to 2GB in steps of powers of 4
+static void bench_powers_of_4(void)
+{
 	for (u64 buffer_size = 128; buffer_size <= AIL_GB(2); buffer_size <<= 2) {
-#ifdef BENCH_AS_CSV
-		table.col  = 0;
-		table.mem_sizes[table.row] = buffer_size;
-#endif
-
 		Buffer buf = get_buffer(buffer_size);
 		Buffer cpy = get_buffer(buffer_size);
 		fill_buffer(buf);
 		ail_bench_begin_profile();
-		for (u64 i = 0; i < ITER_COUNT; i++) {
-			#define X(func, func_in_place) { func(buf, cpy); func_in_place(buf); }
-				FUNCTIONS
-			#undef X
-		}
+		bench_funcs(buf, cpy);
 		ail_bench_end_profile();
 
-#ifdef BENCH_AS_CSV
-		for (u32 i = 0; i < AIL_BENCH_PROFILE_ANCHOR_COUNT; i++) {
-			AIL_Bench_Profile_Anchor anchor = ail_bench_global_anchors[i];
-			if (anchor.label && anchor.min_wo_children && anchor.hit_count) {
-				table.times_in_ms[table.row*table.width + table.col++] = ail_bench_cpu_elapsed_to_ms_fast(anchor.min_wo_children, cpu_freq);
+		char mem_size[12];
+		get_printable_mem_size(mem_size, buffer_size);
+		printf("Benchmark Results for Reversing %s of memory\n", mem_size);
+		ail_bench_print_profile(1, true);
+		printf("-----------\n");
+
+		free_buffer(buf);
+		free_buffer(cpy);
+	}
+}
+
+static u64 align_bench_sizes[] = { 256, AIL_KB(4), AIL_KB(64) };
+
+static void bench_run_out_of_place(void *ctx, u64 idx)
+{
+	Bench_Ctx *c = ctx;
+	funcs[idx].func(c->buf, c->cpy);
+}
+
+static void bench_run_in_place(void *ctx, u64 idx)
+{
+	Bench_Ctx *c = ctx;
+	funcs[idx].func_in_place(c->buf);
+}
+
+// Benchmarks the out-of-place routines with all combinations of the src and dst offsets from bench_alignment_offsets, and the
+// in-place routines with each of the offsets, printing a heat map of the median GB/s for each routine and size in align_bench_sizes
+static void bench_alignment(u64 step)
+{
+	u64 offsets[66];
+	u64 n = bench_alignment_offsets(offsets, AIL_ARRLEN(offsets), step);
+	f64 *gb_per_s = malloc(MAX_FUNC_COUNT*n*n*sizeof(*gb_per_s));
+	f64 *in_place_gb_per_s = malloc(MAX_FUNC_COUNT*n*sizeof(*in_place_gb_per_s));
+	u64 cpu_freq  = ail_bench_cpu_timer_freq();
+	u64 zero      = 0;
+	for (u64 i = 0; i < AIL_ARRLEN(align_bench_sizes); i++) {
+		u64 size = align_bench_sizes[i];
+		Buffer base_src = get_buffer(size + 2*4096);
+		Buffer base_dst = get_buffer(size + 2*4096);
+		for (u64 si = 0; si < n; si++) {
+			Buffer buf = { .size = size, .data = base_src.data + offsets[si] };
+			for (u64 di = 0; di < n; di++) {
+				Buffer cpy = { .size = size, .data = base_dst.data + offsets[di] };
+				fill_buffer(buf);
+				Bench_Ctx ctx = { buf, cpy, 0 };
+				bench_driver_run(&bench_driver, bench_run_out_of_place, &ctx, bench_samples, funcs_count);
+				for (u64 k = 0; k < funcs_count; k++) {
+					u64 median = bench_stats(&bench_samples[k]).median;
+					gb_per_s[(k*n + si)*n + di] = median ? (f64)size / (f64)median * (f64)cpu_freq / 1e9 : 0;
+					Bench_Key key = { .kernel = funcs[k].name, .size = size, .src_offset = offsets[si], .dst_offset = offsets[di],
+					                  .level = bench_level_names[bench_cache_level(2*size)], .pages = page_kind_names[base_src.pages] };
+					bench_export_samples(&bench_export, key, &bench_samples[k]);
+				}
+			}
+
+			fill_buffer(buf);
+			Bench_Ctx ctx = { buf, buf, 0 };
+			bench_driver_run(&bench_driver, bench_run_in_place, &ctx, bench_samples, funcs_count);
+			for (u64 k = 0; k < funcs_count; k++) {
+				u64 median = bench_stats(&bench_samples[k]).median;
+				in_place_gb_per_s[k*n + si] = median ? (f64)size / (f64)median * (f64)cpu_freq / 1e9 : 0;
+				Bench_Key key = { .kernel = funcs[k].in_place_name, .size = size, .src_offset = offsets[si], .dst_offset = offsets[si],
+				                  .level = bench_level_names[bench_cache_level(size)], .pages = page_kind_names[base_src.pages] };
+				bench_export_samples(&bench_export, key, &bench_samples[k]);
 			}
 		}
-		AIL_ASSERT(table.col == table.width);
-		table.row++;
-#endif
+		free_buffer(base_src);
+		free_buffer(base_dst);
+
+		for (u64 k = 0; k < funcs_count; k++) {
+			printf("%s of %zu bytes in GB/s:\n", funcs[k].name, size);
+			bench_print_heat_map("src", offsets, n, "dst", offsets, n, &gb_per_s[k*n*n]);
+			printf("%s of %zu bytes in GB/s:\n", funcs[k].in_place_name, size);
+			bench_print_heat_map("buf", offsets, n, "", &zero, 1, &in_place_gb_per_s[k*n]);
+		}
+		printf("-----------\n");
+	}
+	free(gb_per_s);
+	free(in_place_gb_per_s);
+}
+
+// Buffers of the same size for each kind of pages that bench_compare_pages compares
+typedef struct {
+	Buffer buf[2]; // Backed by 4K pages and by huge pages
+	Buffer cpy[2];
+} Pages_Ctx;
+
+// Indices [0, 2*funcs_count) run on the buffers with 4K pages, the following ones on those with huge pages
+static void bench_run_pages(void *ctx, u64 idx)
+{
+	Pages_Ctx *c = ctx;
+	u64 k = idx / (2*funcs_count);
+	Bench_Ctx run_ctx = { c->buf[k], c->cpy[k], 0 };
+	bench_run_func(&run_ctx, idx % (2*funcs_count));
+}
+
+// Benchmarks every routine on buffers backed by 4K pages and by huge pages of the given kind and prints their median bandwidths side by side
+// Both kinds are measured in the same run of the driver, so four buffers are alive at once and the sweep stops at 1GB
+static void bench_compare_pages(Page_Kind huge)
+{
+	static f64 gb_per_s[4*MAX_FUNC_COUNT];
+	static Bench_Samples samples[4*MAX_FUNC_COUNT];
+	u64 cpu_freq = ail_bench_cpu_timer_freq();
+	Page_Kind prev_pages = buffer_pages;
+	printf("Comparing 4K pages against %s pages\n", page_kind_names[huge]);
+	for (u64 buffer_size = 128; buffer_size <= AIL_GB(1); buffer_size <<= 2) {
+		Pages_Ctx ctx;
+		for (u32 k = 0; k < 2; k++) {
+			buffer_pages = k ? huge : PAGES_4K;
+			ctx.buf[k]   = get_buffer(buffer_size);
+			ctx.cpy[k]   = get_buffer(buffer_size);
+			fill_buffer(ctx.buf[k]);
+		}
+		u64 count = 2*funcs_count;
+		bench_driver_run(&bench_driver, bench_run_pages, &ctx, samples, 2*count);
+		for (u64 i = 0; i < 2*count; i++) {
+			u64 median  = bench_stats(&samples[i]).median;
+			gb_per_s[i] = median ? (f64)buffer_size / (f64)median * (f64)cpu_freq / 1e9 : 0;
+		}
 
 		char mem_size[12];
 		get_printable_mem_size(mem_size, buffer_size);
-		printf("Benchmark Results for Reversing %s of memory\n", mem_size);
+		printf("Reversing %s (GB/s by median time):\n", mem_size);
+		printf("  %-42s %10s %10s %8s\n", "routine", "4K", page_kind_names[ctx.buf[1].pages], "change");
+		for (u64 i = 0; i < count; i++) {
+			f64 small = gb_per_s[i], large = gb_per_s[count + i];
+			char *name = i & 1 ? funcs[i/2].in_place_name : funcs[i/2].name;
+			printf("  %-42s %10.2f %10.2f %+7.1f%%\n", name, small, large, small ? (large/small - 1)*100 : 0);
+		}
+		printf("-----------\n");
+
+		for (u32 k = 0; k < 2; k++) {
+			for (u64 i = 0; i < count; i++) {
+				export_samples(i & 1 ? funcs[i/2].in_place_name : funcs[i/2].name, 0, ctx.buf[k], i & 1 ? buffer_size : 2*buffer_size, &samples[k*count + i]);
+			}
+			free_buffer(ctx.buf[k]);
+			free_buffer(ctx.cpy[k]);
+		}
+	}
+	for (u64 i = 0; i < AIL_ARRLEN(samples); i++) bench_samples_free(&samples[i]);
+	buffer_pages = prev_pages;
+}
+
+// Sweeps over sizes that are concentrated around the capacities of the host's caches, where the rankings of the routines change
+// The out-of-place routines fill a cache at half the size at which the in-place routines fill it, so both get their own points
+static void bench_cache_sweep(void)
+{
+	CPU_Cache_Info cache = cpu_cache_info();
+	char l1_str[12], l2_str[12], l3_str[12];
+	get_printable_mem_size(l1_str, cache.l1d);
+	get_printable_mem_size(l2_str, cache.l2);
+	get_printable_mem_size(l3_str, cache.l3);
+	printf("Cache-aware sweep for L1d: %s, L2: %s, L3: %s\n", l1_str, l2_str, l3_str);
+
+	static u64 sizes[128];
+	static Fastest_Funcs fastest[128];
+	u64 count = bench_cache_sweep_sizes(sizes, 0,     AIL_ARRLEN(sizes), 128, AIL_GB(2), 2.0);
+	count     = bench_cache_sweep_sizes(sizes, count, AIL_ARRLEN(sizes), 128, AIL_GB(2), 1.0);
+	for (u64 i = 0; i < count; i++) {
+		Buffer buf = get_buffer(sizes[i]);
+		Buffer cpy = get_buffer(sizes[i]);
+		fill_buffer(buf);
+		ail_bench_begin_profile();
+		fastest[i] = bench_funcs(buf, cpy);
+		ail_bench_end_profile();
+
+		printf("Benchmark Results for Reversing %zu bytes (working set fits in %s out-of-place and in %s in place)\n", sizes[i],
+		       bench_level_names[bench_cache_level(2*sizes[i])], bench_level_names[bench_cache_level(sizes[i])]);
 		ail_bench_print_profile(1, true);
 		printf("-----------\n");
 
 		free_buffer(buf);
 		free_buffer(cpy);
 	}
-	AIL_BENCH_END_OF_COMPILATION_UNIT();
-#ifdef BENCH_AS_CSV
-	AIL_ASSERT(table.row == table.height);
-	print_table(table);
+
+	u64 cpu_freq = ail_bench_cpu_timer_freq();
+	printf("Fastest routines per size (by median time):\n");
+	printf("%12s | %-5s %-34s %8s | %-5s %-42s %8s\n", "size", "level", "out-of-place", "GB/s", "level", "in place", "GB/s");
+	for (u64 i = 0; i < count; i++) {
+		printf("%12zu | %-5s %-34s %8.2f | %-5s %-42s %8.2f\n", sizes[i],
+		       bench_level_names[bench_cache_level(2*sizes[i])], fastest[i].name[0], (f64)sizes[i] / (f64)fastest[i].median[0] * (f64)cpu_freq / 1e9,
+		       bench_level_names[bench_cache_level(sizes[i])],   fastest[i].name[1], (f64)sizes[i] / (f64)fastest[i].median[1] * (f64)cpu_freq / 1e9);
+	}
+	printf("-----------\n");
+}
+
+// Benchmarks the element-wise reversal routines once per element size, since the profiler can't distinguish between them otherwise
+static void bench_elem_reverse(u64 size)
+{
+	for (u64 k = 0; k < AIL_ARRLEN(bench_elem_sizes); k++) {
+		u64 elem_size = bench_elem_sizes[k];
+		Buffer buf = get_buffer(size - size % elem_size);
+		Buffer cpy = get_buffer(size - size % elem_size);
+		fill_buffer(buf);
+		ail_bench_begin_profile();
+		Bench_Ctx ctx = { buf, cpy, elem_size };
+		bench_driver_run(&bench_driver, bench_run_elem_func, &ctx, bench_samples, 2*elem_funcs_count);
+		ail_bench_end_profile();
+
+		char params[32];
+		snprintf(params, sizeof(params), "elem_size=%zu", elem_size);
+		for (u64 j = 0; j < elem_funcs_count; j++) {
+			export_samples(elem_funcs[j].name,          params, buf, 2*buf.size, &bench_samples[2*j + 0]);
+			export_samples(elem_funcs[j].in_place_name, params, buf,   buf.size, &bench_samples[2*j + 1]);
+		}
+
+		char mem_size[12];
+		get_printable_mem_size(mem_size, buf.size);
+		printf("Benchmark Results for Reversing %s of memory in %zd-byte elements\n", mem_size, elem_size);
+		ail_bench_print_profile(1, true);
+		printf("-----------\n");
+
+		free_buffer(buf);
+		free_buffer(cpy);
+	}
+}
+
+// Measures parallel/parallel_in_place with 1, 2, 4, ... threads up to the size of the pool
+// The profiler is reset by every benchmark, so the timings are taken directly from the CPU's timer
+static void bench_thread_scaling(u64 size)
+{
+	if (!cpu_supports(CPU_SSSE3)) return;
+	Buffer buf = get_buffer(size);
+	Buffer cpy = get_buffer(size);
+	fill_buffer(buf);
+	fill_buffer(cpy);
+	char mem_size[12];
+	get_printable_mem_size(mem_size, size);
+	printf("Thread scaling for reversing %s of memory (fastest run)\n", mem_size);
+	printf("  threads | parallel: ms     GB/s  speedup | parallel_in_place: ms     GB/s  speedup\n");
+	u32 max_threads = pool.thread_count;
+	f64 base[2] = {0};
+	for (u32 threads = 1; threads <= max_threads; threads = threads < max_threads && threads*2 > max_threads ? max_threads : threads*2) {
+		parallel_thread_count = threads;
+		char params[32];
+		snprintf(params, sizeof(params), "threads=%u", threads);
+		f64 ms[2];
+		Bench_Ctx ctx = { buf, cpy, 0 };
+		bench_driver_run(&bench_driver, bench_run_parallel, &ctx, bench_samples, 2);
+		for (u32 k = 0; k < 2; k++) {
+			Bench_Samples *samples = &bench_samples[k];
+			ms[k] = ail_bench_cpu_elapsed_to_ms(bench_stats(samples).min);
+			if (threads == 1) base[k] = ms[k];
+			export_samples(k ? "parallel_in_place" : "parallel", params, buf, k ? size : 2*size, samples);
+		}
+		printf("  %7u | %12.3f %8.2f %7.2fx | %21.3f %8.2f %7.2fx\n", threads,
+		       ms[0], (f64)size/(ms[0]*1e6), base[0]/ms[0],
+		       ms[1], (f64)size/(ms[1]*1e6), base[1]/ms[1]);
+		if (threads == max_threads) break;
+	}
+	parallel_thread_count = max_threads;
+	printf("-----------\n");
+	free_buffer(buf);
+	free_buffer(cpy);
+}
+
+typedef struct {
+	Buffer buf;
+	Buffer cpy;
+	Func func;
+	Prefetch_Setting *candidates;
+} Prefetch_Ctx;
+
+// Indices [0, count) run the out-of-place routine and [count, 2*count) the in-place routine, each with candidate idx % count
+static void bench_run_prefetch(void *ctx, u64 idx)
+{
+	Prefetch_Ctx *c = ctx;
+	u64 count  = 2*AIL_ARRLEN(prefetch_distances) - 1;
+	u32 stream = idx < count ? PREFETCH_OUT_OF_PLACE : PREFETCH_IN_PLACE;
+	prefetch_table.settings[stream][size_class(c->buf.size)] = c->candidates[idx % count];
+	if (stream == PREFETCH_IN_PLACE) c->func.func_in_place(c->buf);
+	else                             c->func.func(c->buf, c->cpy);
+}
+
+// Measures the widest prefetching routines with every candidate distance and hint on powers of 4 from 4KB to `max_size`, one size per
+// band of size classes, and stores the fastest setting of each stream and band in `path`
+static void bench_prefetch_tune(u64 max_size, const char *path)
+{
+	Func func = { "simd_shuffle_avx2_prefetch", simd_shuffle_avx2_prefetch, "simd_shuffle_avx2_in_place_prefetch", simd_shuffle_avx2_in_place_prefetch, CPU_AVX2 };
+	if (cpu_supports(CPU_AVX512F | CPU_AVX512BW)) {
+		func = (Func){ "simd_shuffle_avx512_prefetch", simd_shuffle_avx512_prefetch, "simd_shuffle_avx512_in_place_prefetch", simd_shuffle_avx512_in_place_prefetch, CPU_AVX512F | CPU_AVX512BW };
+	} else if (!cpu_supports(CPU_AVX2)) {
+		printf("\033[33mSkipping the tuning of the prefetch distances, since this CPU doesn't support AVX2\033[0m\n");
+		return;
+	}
+	Prefetch_Setting candidates[2*AIL_ARRLEN(prefetch_distances)];
+	u32 count = prefetch_candidates(candidates);
+	b32 tuned[PREFETCH_STREAM_COUNT][SIZE_CLASS_COUNT] = {0};
+	u64 cpu_freq = ail_bench_cpu_timer_freq();
+
+	printf("Tuning the prefetch distance of %s and %s (GB/s by median time without prefetching and with the best setting)\n", func.name, func.in_place_name);
+	printf("%8s | %-28s | %-28s |\n", "", prefetch_stream_names[0], prefetch_stream_names[1]);
+	printf("%8s | %8s %8s %-10s | %8s %8s %-10s |\n", "size", "none", "best", "setting", "none", "best", "setting");
+	for (u64 size = AIL_KB(4); size <= max_size; size <<= 2) {
+		Prefetch_Ctx ctx = { get_buffer(size), get_buffer(size), func, candidates };
+		fill_buffer(ctx.buf);
+		bench_driver_run(&bench_driver, bench_run_prefetch, &ctx, bench_samples, 2*count);
+
+		char mem_size[12];
+		get_printable_mem_size(mem_size, size);
+		printf("%8s |", mem_size);
+		for (u32 k = 0; k < PREFETCH_STREAM_COUNT; k++) {
+			Bench_Samples *samples = &bench_samples[k*count];
+			Prefetch_Setting best = candidates[bench_fastest(samples, count)];
+			u32 c = size_class(size);
+			prefetch_table.settings[k][c] = best;
+			tuned[k][c] = 1;
+
+			char setting[16];
+			snprintf(setting, sizeof(setting), "%zu %s", best.distance, best.distance ? prefetch_hint_names[best.hint] : "");
+			printf(" %8.2f %8.2f %-10s |", (f64)size / (f64)bench_stats(&samples[0]).median * (f64)cpu_freq / 1e9,
+			       (f64)size / (f64)bench_stats(&samples[bench_fastest(samples, count)]).median * (f64)cpu_freq / 1e9, setting);
+		}
+		printf("\n");
+		// Exporting prints the warnings of unreliable results, so it happens after the row was printed
+		for (u32 i = 0; i < 2*count; i++) {
+			char params[48];
+			snprintf(params, sizeof(params), "distance=%zu,hint=%s", candidates[i % count].distance, prefetch_hint_names[candidates[i % count].hint]);
+			export_samples(i < count ? func.name : func.in_place_name, params, ctx.buf, i < count ? 2*size : size, &bench_samples[i]);
+		}
+		free_buffer(ctx.buf);
+		free_buffer(ctx.cpy);
+	}
+	printf("-----------\n");
+	for (u32 k = 0; k < PREFETCH_STREAM_COUNT; k++) prefetch_table_spread(&prefetch_table, k, tuned[k]);
+	if (prefetch_table_save(&prefetch_table, path)) printf("Saved prefetch distances to %s\n", path);
+	else printf("\033[31mFailed to save prefetch distances to %s\033[0m\n", path);
+}
+
+typedef struct {
+	Buffer src;
+	Buffer dst;
+} Move_Ctx;
+
+static void bench_run_move(void *ctx, u64 idx)
+{
+	Move_Ctx *c = ctx;
+	move_funcs[idx].func(c->src, c->dst);
+}
+
+// Benchmarks reversing between overlapping buffers from 128B to `max_size` with dst shifted by half the size and by a single cache line
+// (both to the right), and prints the median GB/s of each routine as well as the speedup of the fastest one-pass reverse_move over the
+// scratch buffer approach
+static void bench_reverse_move(u64 max_size)
+{
+	u64 cpu_freq = ail_bench_cpu_timer_freq();
+	const char *shift_names[] = { "size/2", "64B" };
+	printf("Benchmark Results for reversing between overlapping buffers (median GB/s)\n");
+	printf("%8s %7s |", "size", "shift");
+	for (u64 i = 0; i < move_funcs_count; i++) printf(" %20s", move_funcs[i].name);
+	printf(" | %8s\n", "speedup");
+	for (u64 size = 128; size <= max_size; size <<= 2) {
+		for (u32 k = 0; k < AIL_ARRLEN(shift_names); k++) {
+			u64 shift = k ? 64 : size/2;
+			Buffer region = get_buffer(size + shift);
+			Move_Ctx ctx = { { .size = size, .data = region.data, .pages = region.pages }, { .size = size, .data = region.data + shift, .pages = region.pages } };
+			fill_buffer(ctx.src);
+			bench_driver_run(&bench_driver, bench_run_move, &ctx, bench_samples, move_funcs_count);
+
+			char mem_size[12];
+			get_printable_mem_size(mem_size, size);
+			printf("%8s %7s |", mem_size, shift_names[k]);
+			u64 fastest = UINT64_MAX, scratch = 0;
+			char params[32];
+			snprintf(params, sizeof(params), "shift=%zu", shift);
+			for (u64 i = 0; i < move_funcs_count; i++) {
+				u64 median = bench_stats(&bench_samples[i]).median;
+				if (!strncmp(move_funcs[i].name, "reverse_move_scratch", 20)) scratch = median;
+				else if (strncmp(move_funcs[i].name, "reverse_move_memmove", 20)) fastest = AIL_MIN(fastest, median);
+				printf(" %20.2f", median ? (f64)size / (f64)median * (f64)cpu_freq / 1e9 : 0);
+				export_samples(move_funcs[i].name, params, ctx.src, size + shift, &bench_samples[i]);
+			}
+			printf(" | %7.2fx\n", scratch && fastest != UINT64_MAX ? (f64)scratch / (f64)fastest : 0);
+			free_buffer(region);
+		}
+	}
+	printf("-----------\n");
+}
+
+#if defined(__linux__)
+// The pattern's period of 251 bytes doesn't divide any power of 2, so chunks that end up at wrong offsets are detected
+static u8 file_pattern(u64 i) { return (u8)(i % 251); }
+
+typedef struct {
+	Stream streams[3]; // STREAM_COPY, STREAM_REVERSE and STREAM_REVERSE_IN_PLACE
+	int src;           // Buffered descriptors for mmap and for dropping the files from the page cache
+	int dst;
+	int in_place;
+	u64 size;
+	u64 elem_size;
+	u32 flips;         // Amount of times the in-place file was reversed
+	u32 failures[5];   // Calls of each variant that failed, whose times don't measure a complete reversal
+} File_Reverse_Ctx;
+
+static const char *file_reverse_names[] = { "stream_copy", "stream_reverse", "stream_reverse_in_place", "mmap_reverse", "mmap_reverse_in_place" };
+
+// The mmap variants rely on the page cache for reading ahead and writing back, which is what the streaming variants are compared against
+static b32 file_reverse_mmap(File_Reverse_Ctx *c, b32 in_place)
+{
+	u8 *s = mmap(0, c->size, PROT_READ|PROT_WRITE*in_place, MAP_SHARED, in_place ? c->in_place : c->src, 0);
+	u8 *d = in_place ? s : mmap(0, c->size, PROT_READ|PROT_WRITE, MAP_SHARED, c->dst, 0);
+	b32 ok = s != MAP_FAILED && d != MAP_FAILED;
+	if (ok) {
+		if (in_place) reverse_file_chunk_in_place(s, c->size, c->elem_size);
+		else          reverse_file_chunk(d, s, c->size, c->elem_size);
+		ok = !msync(d, c->size, MS_SYNC);
+	}
+	if (s != MAP_FAILED) munmap(s, c->size);
+	if (!in_place && d != MAP_FAILED) munmap(d, c->size);
+	return ok;
+}
+
+// Every call starts with the files evicted from the page cache and ends once the output reached the disk
+static void bench_run_file_reverse(void *ctx, u64 idx)
+{
+	File_Reverse_Ctx *c = ctx;
+	posix_fadvise(c->src,      0, 0, POSIX_FADV_DONTNEED);
+	posix_fadvise(c->dst,      0, 0, POSIX_FADV_DONTNEED);
+	posix_fadvise(c->in_place, 0, 0, POSIX_FADV_DONTNEED);
+	b32 ok;
+	if (idx < AIL_ARRLEN(c->streams)) {
+		Stream *s = &c->streams[idx];
+		ok = stream_run(s) && !fdatasync(s->mode == STREAM_REVERSE_IN_PLACE ? s->src : s->dst);
+	} else {
+		ok = file_reverse_mmap(c, idx == 4);
+	}
+	if (idx == 2 || idx == 4) c->flips++;
+	if (!ok) c->failures[idx]++;
+}
+
+// Checks a few blocks spread over the output of the variant `idx`
+static b32 file_reverse_check(File_Reverse_Ctx *c, u64 idx)
+{
+	int fd = (idx == 2 || idx == 4) ? c->in_place : c->dst;
+	b32 reversed = idx == 2 || idx == 4 ? c->flips % 2 : idx != 0;
+	u64 n = c->size / c->elem_size;
+	u8 block[256];
+	for (u64 k = 0; k <= 16; k++) {
+		u64 off = AIL_MIN(k*(c->size/16), c->size - AIL_MIN(sizeof(block), c->size));
+		u64 len = AIL_MIN(sizeof(block), c->size);
+		if (pread(fd, block, len, (off_t)off) != (ssize_t)len) return 0;
+		for (u64 i = off; i < off + len; i++) {
+			u64 j = reversed ? (n - i/c->elem_size - 1)*c->elem_size + i%c->elem_size : i;
+			if (block[i - off] != file_pattern(j)) return 0;
+		}
+	}
+	return 1;
+}
+
+// Reverses a file in `dir` by streaming it through memory, out of place and in place, and compares the sustained throughput
+// against copying the file with the same I/O pattern (the raw bandwidth of the disk) and against reversing the mapped file
+static void bench_file_reverse(u64 size, const char *dir, u64 chunk, u32 depth, u64 elem_size, b32 direct)
+{
+	if (!cpu_supports(CPU_SSSE3)) return;
+	elem_size = AIL_MAX(elem_size, 1);
+	// Sizes and offsets only have to be multiples of the block size with O_DIRECT, but are rounded regardless for comparable results
+	u64 unit = stream_unit(elem_size);
+	size  = AIL_MAX(unit, size - size % unit);
+	chunk = AIL_MAX(unit, chunk - chunk % unit);
+	char src_path[512], dst_path[512], in_place_path[512];
+	snprintf(src_path,      sizeof(src_path),      "%s/speedy-reverse-src.bin",      dir);
+	snprintf(dst_path,      sizeof(dst_path),      "%s/speedy-reverse-dst.bin",      dir);
+	snprintf(in_place_path, sizeof(in_place_path), "%s/speedy-reverse-in-place.bin", dir);
+
+	File_Reverse_Ctx ctx = { .size = size, .elem_size = elem_size };
+	ctx.src      = open(src_path,      O_RDWR|O_CREAT|O_TRUNC, 0644);
+	ctx.dst      = open(dst_path,      O_RDWR|O_CREAT|O_TRUNC, 0644);
+	ctx.in_place = open(in_place_path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	b32 created = ctx.src >= 0 && ctx.dst >= 0 && ctx.in_place >= 0 && !ftruncate(ctx.dst, (off_t)size);
+	Page_Kind pages;
+	u8 *pattern = pages_alloc(chunk, PAGES_4K, 0, &pages);
+	for (u64 off = 0; created && off < size; off += chunk) {
+		u64 len = AIL_MIN(chunk, size - off);
+		for (u64 i = 0; i < len; i++) pattern[i] = file_pattern(off + i);
+		created = pwrite(ctx.src, pattern, len, (off_t)off) == (ssize_t)len && pwrite(ctx.in_place, pattern, len, (off_t)off) == (ssize_t)len;
+	}
+	pages_free(pattern, chunk, PAGES_4K);
+	if (!created) {
+		printf("\033[31mCould not create the files for reversing a file in %s: %s\033[0m\n", dir, strerror(errno));
+	} else {
+		fdatasync(ctx.src);
+		fdatasync(ctx.in_place);
+		// The streams read and write through separate descriptors, which bypass the page cache if the file system supports O_DIRECT
+		int flags = direct ? O_DIRECT : 0;
+		int src_direct      = open(src_path,      O_RDONLY|flags);
+		int dst_direct      = open(dst_path,      O_WRONLY|flags);
+		int in_place_direct = open(in_place_path, O_RDWR|flags);
+		if (direct && (src_direct < 0 || dst_direct < 0 || in_place_direct < 0)) {
+			printf("\033[33mThe file system of %s doesn't support O_DIRECT, the files are streamed through the page cache instead\033[0m\n", dir);
+			direct = 0;
+			if (src_direct      >= 0) close(src_direct);
+			if (dst_direct      >= 0) close(dst_direct);
+			if (in_place_direct >= 0) close(in_place_direct);
+			src_direct      = open(src_path,      O_RDONLY);
+			dst_direct      = open(dst_path,      O_WRONLY);
+			in_place_direct = open(in_place_path, O_RDWR);
+		}
+		ctx.streams[0] = stream_init(STREAM_COPY,             src_direct,      dst_direct, size, chunk, elem_size, depth);
+		ctx.streams[1] = stream_init(STREAM_REVERSE,          src_direct,      dst_direct, size, chunk, elem_size, depth);
+		ctx.streams[2] = stream_init(STREAM_REVERSE_IN_PLACE, in_place_direct, -1,         size, chunk, elem_size, depth);
+
+		// Each variant is run and checked once before benchmarking
+		b32 ok = 1;
+		for (u64 i = 0; i < AIL_ARRLEN(file_reverse_names); i++) {
+			bench_run_file_reverse(&ctx, i);
+			if (ctx.failures[i] || !file_reverse_check(&ctx, i)) {
+				printf("\033[31m%s failed to reverse the file in %s :(\033[0m\n", file_reverse_names[i], dir);
+				ok = 0;
+			}
+		}
+		memset(ctx.failures, 0, sizeof(ctx.failures));
+		if (ok) {
+			// Each call streams the whole file, so fewer calls are needed than for buffers in memory
+			Bench_Driver driver = bench_driver;
+			driver.warmup_count = AIL_MIN(driver.warmup_count, 1);
+			driver.min_reps     = AIL_MIN(driver.min_reps, 3);
+			bench_driver_run(&driver, bench_run_file_reverse, &ctx, bench_samples, AIL_ARRLEN(file_reverse_names));
+
+			char mem_size[12], chunk_size[12], params[64];
+			get_printable_mem_size(mem_size, size);
+			get_printable_mem_size(chunk_size, ctx.streams[0].chunk);
+			snprintf(params, sizeof(params), "elem_size=%zu,depth=%u,direct=%d", elem_size, ctx.streams[0].depth, direct);
+			u64 cpu_freq = ail_bench_cpu_timer_freq();
+			f64 raw_gbs  = 0;
+			printf("Reversing a file of %s in %zu-byte elements in %s (%s chunks, %u in flight%s)\n", mem_size, elem_size, dir, chunk_size,
+			       ctx.streams[0].depth, direct ? ", O_DIRECT" : "");
+			printf("  %-24s %10s %8s %10s\n", "variant", "median ms", "GB/s", "% of copy");
+			for (u64 i = 0; i < AIL_ARRLEN(file_reverse_names); i++) {
+				// A call that failed or an output that is wrong after benchmarking means the times don't measure complete reversals
+				// The variants share their output files, so each one is run once more right before its output is checked
+				bench_run_file_reverse(&ctx, i);
+				if (ctx.failures[i] || !file_reverse_check(&ctx, i)) {
+					printf("\033[31m  %-24s failed %u times or produced a wrong file while benchmarking, so its times are invalid :(\033[0m\n",
+					       file_reverse_names[i], ctx.failures[i]);
+					bench_samples_reset(&bench_samples[i]);
+					continue;
+				}
+				u64 median = bench_stats(&bench_samples[i]).median;
+				f64 gbs    = (f64)size / (f64)median * (f64)cpu_freq / 1e9;
+				if (i == 0) raw_gbs = gbs;
+				printf("  %-24s %10.2f %8.2f %9.1f%%\n", file_reverse_names[i], ail_bench_cpu_elapsed_to_ms(median), gbs, raw_gbs ? gbs / raw_gbs * 100 : 0);
+				Bench_Key key = { .kernel = file_reverse_names[i], .params = params, .size = size };
+				bench_export_samples(&bench_export, key, &bench_samples[i]);
+			}
+			printf("-----------\n");
+		}
+		for (u32 i = 0; i < AIL_ARRLEN(ctx.streams); i++) stream_deinit(&ctx.streams[i]);
+		close(src_direct);
+		close(dst_direct);
+		close(in_place_direct);
+	}
+	if (ctx.src      >= 0) { close(ctx.src);      unlink(src_path); }
+	if (ctx.dst      >= 0) { close(ctx.dst);      unlink(dst_path); }
+	if (ctx.in_place >= 0) { close(ctx.in_place); unlink(in_place_path); }
+}
 #endif
+
+int main(int argc, char **argv)
+{
+	u64 t0 = ail_bench_cpu_timer();
+#ifdef BENCH
+	// Without the baseline, the run couldn't be judged, so it stops before testing or measuring anything
+	if (!bench_baseline_from_args(argc, argv)) return 1;
+#endif
+	funcs_count      = filter_supported_funcs(funcs, AIL_ARRLEN(funcs));
+	elem_funcs_count = filter_supported_elem_funcs(elem_funcs, AIL_ARRLEN(elem_funcs));
+	move_funcs_count = filter_supported_move_funcs(move_funcs, AIL_ARRLEN(move_funcs));
+	load_plugins(argc, argv);
+	init_parallel((u32)args_get_u64(argc, argv, "-threads", THREAD_COUNT), args_get_u64(argc, argv, "-parallel-min-chunk", PARALLEL_MIN_CHUNK));
+	printf("parallel/parallel_in_place use up to %u threads\n", pool.thread_count);
+	buffer_pages = page_kind_from_str(args_get(argc, argv, "-pages", 0), BUFFER_PAGES);
+	if (buffer_pages != PAGES_4K) printf("Buffers are backed by %s pages\n", page_kind_names[buffer_pages]);
+	prefetch_table_init(&prefetch_table, prefetch_stream_names, PREFETCH_STREAM_COUNT, (Prefetch_Setting){ PREFETCH_DISTANCE, PREFETCH_HINT });
+	const char *prefetch_table_path = args_get(argc, argv, "-prefetch-table", PREFETCH_TABLE_PATH);
+	if (prefetch_table_load(&prefetch_table, prefetch_table_path)) printf("Loaded prefetch distances from %s\n", prefetch_table_path);
+#ifdef TEST
+	Buffer buffers[AIL_ARRLEN(test_buffer_sizes)][2];
+	for (u64 i = 0; i < AIL_ARRLEN(test_buffer_sizes); i++) {
+		buffers[i][0] = get_buffer(test_buffer_sizes[i]);
+		buffers[i][1] = get_buffer(test_buffer_sizes[i]);
+	}
+	for (u64 i = 0; i < funcs_count; i++) {
+		test(buffers, funcs[i]);
+	}
+	for (u64 i = 0; i < elem_funcs_count; i++) {
+		test_elem(buffers, elem_funcs[i]);
+	}
+	for (u64 i = 0; i < move_funcs_count; i++) {
+		test_move(move_funcs[i]);
+	}
+	if (cpu_supports(CPU_SSSE3)) test_parallel();
+#if defined(__linux__)
+	if (cpu_supports(CPU_SSSE3)) test_stream_reverse(buffers, args_get(argc, argv, "-file-dir", FILE_REVERSE_DIR));
+#endif
+	for (u64 i = 0; i < AIL_ARRLEN(buffers); i++) {
+		free_buffer(buffers[i][0]);
+		free_buffer(buffers[i][1]);
+	}
+#endif
+
+	int exit_code = 0; // Set if the benchmark results regressed against the baseline
+#ifdef BENCH
+	bench_driver = bench_driver_from_args(argc, argv, ITER_COUNT);
+	const char *export_path = args_get(argc, argv, "-export", 0);
+	if (bench_export_open(&bench_export, export_path)) printf("Exporting benchmark results to %s\n", export_path);
+	if      (args_has(argc, argv, "-cache-sweep"))   bench_cache_sweep();
+	else if (args_has(argc, argv, "-alignment"))     bench_alignment(args_get_u64(argc, argv, "-align-step", ALIGN_STEP));
+	else if (args_has(argc, argv, "-prefetch-tune")) bench_prefetch_tune(args_get_u64(argc, argv, "-prefetch-max-size", PREFETCH_TUNE_MAX_SIZE), prefetch_table_path);
+	else if (args_has(argc, argv, "-reverse-move"))  bench_reverse_move(args_get_u64(argc, argv, "-move-max-size", REVERSE_MOVE_MAX_SIZE));
+	else if (args_has(argc, argv, "-compare-pages")) bench_compare_pages(page_kind_from_str(args_get(argc, argv, "-huge-pages", 0), COMPARE_PAGES));
+#if defined(__linux__)
+	else if (args_has(argc, argv, "-file-reverse")) {
+		bench_file_reverse(args_get_u64(argc, argv, "-file-size", FILE_REVERSE_SIZE), args_get(argc, argv, "-file-dir", FILE_REVERSE_DIR),
+		                   args_get_u64(argc, argv, "-file-chunk", FILE_REVERSE_CHUNK), (u32)args_get_u64(argc, argv, "-file-depth", FILE_REVERSE_DEPTH),
+		                   args_get_u64(argc, argv, "-file-elem-size", 1), FILE_REVERSE_DIRECT && !args_has(argc, argv, "-file-buffered"));
+	}
+#endif
+	else                                             bench_powers_of_4();
+	AIL_BENCH_END_OF_COMPILATION_UNIT();
+	bench_elem_reverse(args_get_u64(argc, argv, "-elem-buffer-size", ELEM_BUFFER_SIZE));
+	bench_thread_scaling(args_get_u64(argc, argv, "-scaling-size", SCALING_BUFFER_SIZE));
+	bench_export_close(&bench_export);
+	if (baseline_close(&bench_baseline)) exit_code = 1; // Regressions fail the run, so toolchain upgrades can be gated on it
+	perf_close(&bench_perf);
+	for (u64 i = 0; i < AIL_ARRLEN(bench_samples); i++) bench_samples_free(&bench_samples[i]);
 #endif
+	pool_deinit(&pool);
+	for (u32 i = 0; i < plugins_count; i++) plugin_close(&plugins[i]);
 	u64 t1 = ail_bench_cpu_timer();
 	printf("Total time for running entire program: ~%fm\n", ail_bench_cpu_elapsed_to_ms(t1 - t0)/60000);
+	return exit_code;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+// Minimal command line parsing
+//
+// Options are given as `-name value`, flags simply as `-name`. Unknown arguments are ignored,
+// so each feature of a program can look up its own options without a central list of them.
+
+#ifndef SPEEDY_ARGS_H_
+#define SPEEDY_ARGS_H_
+
+#include "ail/ail.h"
+#include <stdlib.h> // For strtoull, strtod
+#include <string.h> // For strcmp
+
+static b32 args_has(int argc, char **argv, const char *name)
+{
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], name)) return 1;
+    }
+    return 0;
+}
+
+static const char *args_get(int argc, char **argv, const char *name, const char *fallback)
+{
+    for (int i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], name)) return argv[i + 1];
+    }
+    return fallback;
+}
+
+// Parses an unsigned integer with an optional K/M/G suffix (i.e. `-threads 8` or `-file-size 4G`)
+static u64 args_get_u64(int argc, char **argv, const char *name, u64 fallback)
+{
+    const char *str = args_get(argc, argv, name, 0);
+    if (!str) return fallback;
+    char *end;
+    u64 x = strtoull(str, &end, 0);
+    if      (*end == 'K' || *end == 'k') x <<= 10;
+    else if (*end == 'M' || *end == 'm') x <<= 20;
+    else if (*end == 'G' || *end == 'g') x <<= 30;
+    return x;
+}
+
+static f64 args_get_f64(int argc, char **argv, const char *name, f64 fallback)
+{
+    const char *str = args_get(argc, argv, name, 0);
+    return str ? strtod(str, 0) : fallback;
+}
+
+#endif // SPEEDY_ARGS_H_
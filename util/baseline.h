@@ -0,0 +1,202 @@
+// Baselines of benchmark results and the comparison of later runs against them
+//
+// Changing the compiler, its flags or the hardware can make single kernels slower without it showing up
+// anywhere but in a wall of numbers. A baseline stores the median time of every measured configuration
+// (kernel, params, size, overlap, offsets and pages) of a run, together with the 95% confidence interval
+// of the median, as text with one line per configuration. Times are stored in nanoseconds, so that baselines
+// remain comparable between hosts with different timer frequencies.
+//
+// When comparing, each result is matched with the baseline entry of the same configuration (configurations
+// that are measured more than once per run are matched in order). A result only counts as a regression or
+// improvement if its median differs from the baseline's by more than the tolerance AND the confidence
+// intervals of both medians don't overlap, so differences that are within the noise of either run aren't
+// reported. The confidence interval of the median is distribution-free (the order statistics around the
+// median, whose ranks follow from the binomial distribution), so outliers of noisy hosts don't widen it much.
+//
+// The confidence intervals only capture the noise within a run, while a host whose CPU runs at a different
+// frequency makes all results of a run slower or faster alike. The time of a fixed compute-bound loop is
+// therefore stored with the baseline, and the comparison warns if it changed by more than the allowed drift.
+
+#ifndef SPEEDY_BASELINE_H_
+#define SPEEDY_BASELINE_H_
+
+#include "ail/ail.h"
+#include <stdio.h>  // For fopen, fprintf, sscanf
+#include <stdlib.h> // For realloc, free
+#include <string.h> // For strcmp, snprintf
+#include <math.h>   // For sqrt, floor, ceil, fabs
+
+typedef struct Baseline_Entry {
+    char kernel[96]; // As long as the names of plugin routines (see Plugin.names)
+    char params[96]; // "-" if the configuration has no params
+    char pages[8];   // "-" if the kind of pages is unknown
+    u64 size;
+    u64 overlap;
+    u64 src_offset;
+    u64 dst_offset;
+    f64 median_ns;
+    f64 lo_ns;       // 95% confidence interval of the median
+    f64 hi_ns;
+    i64 match;       // Results of this run: index of the baseline entry they were compared against, -1 if there was none
+                     // Baseline entries: 1 once a result of this run was compared against them, 0 otherwise
+} Baseline_Entry;
+
+typedef struct Baseline {
+    b32 active;
+    f64 tolerance;            // Relative change of the median that is tolerated
+    f64 max_freq_drift;       // Relative change of the frequency probe above which the runs aren't considered comparable
+    f64 probe_ns;             // Time of the frequency probe in this run and in the baseline (0 if it wasn't stored)
+    f64 base_probe_ns;
+    const char *save_path;    // Where the results of this run are stored on close, may be 0
+    Baseline_Entry *base;     // Entries of the baseline that is compared against
+    u64 base_count;
+    Baseline_Entry *run;      // Results of this run
+    u64 run_count;
+    u64 run_cap;
+} Baseline;
+
+// Writes the bounds of the 95% confidence interval of the median of `n` sorted samples into lo and hi (as ranks)
+static void baseline_median_ci(u64 n, u64 *lo, u64 *hi)
+{
+    f64 half = 1.96*sqrt((f64)n)/2;
+    f64 l = floor((f64)n/2 - half), h = ceil((f64)n/2 + half);
+    *lo = l < 0 ? 0 : (u64)l;
+    *hi = AIL_MIN(n - 1, (u64)h);
+}
+
+static b32 baseline_same_config(const Baseline_Entry *a, const Baseline_Entry *b)
+{
+    return a->size == b->size && a->overlap == b->overlap && a->src_offset == b->src_offset && a->dst_offset == b->dst_offset &&
+           !strcmp(a->kernel, b->kernel) && !strcmp(a->params, b->params) && !strcmp(a->pages, b->pages);
+}
+
+// Lines starting with '#' and malformed lines are skipped
+static b32 baseline_load(Baseline *b, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    char line[512];
+    u64 cap = 0;
+    while (fgets(line, sizeof(line), f)) {
+        Baseline_Entry e = {0};
+        unsigned long long size, overlap, src_offset, dst_offset;
+        if (sscanf(line, "# probe_ns %lf", &b->base_probe_ns) == 1) continue;
+        if (line[0] == '#' || sscanf(line, "%95s %95s %7s %llu %llu %llu %llu %lf %lf %lf", e.kernel, e.params, e.pages,
+                                     &size, &overlap, &src_offset, &dst_offset, &e.median_ns, &e.lo_ns, &e.hi_ns) != 10) continue;
+        e.size = size; e.overlap = overlap; e.src_offset = src_offset; e.dst_offset = dst_offset;
+        if (b->base_count == cap) {
+            cap = AIL_MAX(256, 2*cap);
+            b->base = realloc(b->base, cap*sizeof(*b->base));
+        }
+        b->base[b->base_count++] = e;
+    }
+    fclose(f);
+    return 1;
+}
+
+// Compares all results against the baseline at compare_path (if it isn't 0) and stores them at save_path on close (if it isn't 0)
+// probe_ns is the time of a fixed compute-bound loop on this host, which is compared against the one of the baseline
+// Returns false if the baseline couldn't be read, in which case nothing is compared
+static b32 baseline_open(Baseline *b, const char *compare_path, const char *save_path, f64 tolerance, f64 max_freq_drift, f64 probe_ns)
+{
+    *b = (Baseline){ .tolerance = tolerance, .max_freq_drift = max_freq_drift, .probe_ns = probe_ns, .save_path = save_path };
+    if (compare_path && !baseline_load(b, compare_path)) {
+        printf("\033[31mCould not read the baseline '%s'\033[0m\n", compare_path);
+        return 0;
+    }
+    b->active = compare_path || save_path;
+    return 1;
+}
+
+// Adds the result of a configuration, with the median time and the bounds of its confidence interval in nanoseconds
+static void baseline_add(Baseline *b, const char *kernel, const char *params, const char *pages,
+                         u64 size, u64 overlap, u64 src_offset, u64 dst_offset, f64 median_ns, f64 lo_ns, f64 hi_ns)
+{
+    if (!b->active) return;
+    Baseline_Entry e = {
+        .size = size, .overlap = overlap, .src_offset = src_offset, .dst_offset = dst_offset,
+        .median_ns = median_ns, .lo_ns = lo_ns, .hi_ns = hi_ns, .match = -1,
+    };
+    snprintf(e.kernel, sizeof(e.kernel), "%s", kernel);
+    snprintf(e.params, sizeof(e.params), "%s", params && *params ? params : "-");
+    snprintf(e.pages,  sizeof(e.pages),  "%s", pages  && *pages  ? pages  : "-");
+    // Whitespace would split the fields of the stored line
+    for (char *c = e.params; *c; c++) if (*c == ' ') *c = '_';
+    for (u64 i = 0; i < b->base_count; i++) {
+        if (!b->base[i].match && baseline_same_config(&b->base[i], &e)) {
+            b->base[i].match = 1;
+            e.match = (i64)i;
+            break;
+        }
+    }
+    if (b->run_count == b->run_cap) {
+        b->run_cap = AIL_MAX(256, 2*b->run_cap);
+        b->run = realloc(b->run, b->run_cap*sizeof(*b->run));
+    }
+    b->run[b->run_count++] = e;
+}
+
+// -1 for a regression, 1 for an improvement, 0 if the difference is within the tolerance or the noise
+static i32 baseline_verdict(const Baseline *b, const Baseline_Entry *base, const Baseline_Entry *now)
+{
+    if (now->median_ns > base->median_ns*(1 + b->tolerance) && now->lo_ns > base->hi_ns) return -1;
+    if (now->median_ns < base->median_ns*(1 - b->tolerance) && now->hi_ns < base->lo_ns) return 1;
+    return 0;
+}
+
+static b32 baseline_save(const Baseline *b, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    fprintf(f, "# baseline: <kernel> <params> <pages> <size> <overlap> <src offset> <dst offset> <median ns> <95%% CI of the median: low ns> <high ns>\n");
+    fprintf(f, "# probe_ns %.3f\n", b->probe_ns);
+    for (u64 i = 0; i < b->run_count; i++) {
+        const Baseline_Entry *e = &b->run[i];
+        fprintf(f, "%s %s %s %llu %llu %llu %llu %.3f %.3f %.3f\n", e->kernel, e->params, e->pages, (unsigned long long)e->size,
+                (unsigned long long)e->overlap, (unsigned long long)e->src_offset, (unsigned long long)e->dst_offset, e->median_ns, e->lo_ns, e->hi_ns);
+    }
+    fclose(f);
+    return 1;
+}
+
+// Prints the regressions and improvements against the baseline, stores the results if requested and frees the baseline
+// Returns the amount of regressions
+static u64 baseline_close(Baseline *b)
+{
+    u64 regressions = 0;
+    if (b->base_count) {
+        u64 improvements = 0, unchanged = 0, missing = 0;
+        printf("Comparison against the baseline (median time, tolerance %.1f%%)\n", b->tolerance*100);
+        if (b->base_probe_ns && b->probe_ns && fabs(b->probe_ns/b->base_probe_ns - 1) > b->max_freq_drift) {
+            printf("\033[33mWarning: The CPU ran %.1f%% %s than during the baseline, so all results may be shifted alike\033[0m\n",
+                   fabs(b->base_probe_ns/b->probe_ns - 1)*100, b->probe_ns < b->base_probe_ns ? "faster" : "slower");
+        }
+        for (u64 i = 0; i < b->run_count; i++) {
+            const Baseline_Entry *now = &b->run[i];
+            if (now->match < 0) { missing++; continue; }
+            const Baseline_Entry *base = &b->base[now->match];
+            i32 verdict = baseline_verdict(b, base, now);
+            if (!verdict) { unchanged++; continue; }
+            if (verdict < 0) regressions++;
+            else             improvements++;
+            printf("%s  %-9s %-32s %-24s %10zu bytes", verdict < 0 ? "\033[31m" : "\033[32m", verdict < 0 ? "regressed" : "improved", now->kernel, now->params, now->size);
+            if (now->overlap) printf(" (%zu overlapped)", now->overlap);
+            printf(": %10.1fns -> %10.1fns (%+.1f%%)\033[0m\n", base->median_ns, now->median_ns, (now->median_ns/base->median_ns - 1)*100);
+        }
+        u64 unmeasured = 0;
+        for (u64 i = 0; i < b->base_count; i++) unmeasured += !b->base[i].match;
+        printf("%zu regressions, %zu improvements, %zu unchanged, %zu without a baseline entry, %zu baseline entries that weren't measured\n",
+               regressions, improvements, unchanged, missing, unmeasured);
+        printf("-----------\n");
+    }
+    if (b->save_path) {
+        if (baseline_save(b, b->save_path)) printf("Saved the baseline of %zu results to %s\n", b->run_count, b->save_path);
+        else printf("\033[31mFailed to save the baseline to %s\033[0m\n", b->save_path);
+    }
+    free(b->base);
+    free(b->run);
+    *b = (Baseline){0};
+    return regressions;
+}
+
+#endif // SPEEDY_BASELINE_H_
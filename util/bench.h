@@ -0,0 +1,528 @@
+// Per-call timing samples and a machine-readable export of their statistics
+//
+// The ail profiler only keeps the total and minimum time of each anchor, which isn't enough for
+// distribution statistics. Both programs therefore additionally time each call of a benchmarked
+// routine with `ail_bench_cpu_timer` and collect the samples here. After a configuration (routine,
+// size, overlap, alignment) was measured, its statistics can be written as a row of a CSV or JSON
+// file, so results of different hosts can be compared without copying them from the terminal.
+//
+// `bench_driver_run` measures a set of routines on the same configuration: After a few warm-up
+// calls, the routines are called in a new random order each round until the 95% confidence
+// interval of each routine's mean is tight enough or the time budget is used up. Results with a
+// high variance, and configurations during which the CPU's frequency changed, are flagged.
+//
+// With `-perf` (or `-perf-events list`), a group of hardware performance counters (see util/perf.h)
+// is read around each measured call as well. The counters are summed per routine and configuration,
+// printed per call next to its median time and bandwidth and added to the export.
+//
+// With `-baseline path` and `-save-baseline path`, all results are additionally compared against a
+// stored baseline or stored as a new one (see util/baseline.h).
+
+#ifndef SPEEDY_BENCH_H_
+#define SPEEDY_BENCH_H_
+
+#include "ail/ail.h"
+#include "ail/ail_bench.h"
+#include "args.h"
+#include "cpu.h"
+#include "perf.h"
+#include "baseline.h"
+#include <stdio.h>  // For fopen, fprintf
+#include <stdlib.h> // For realloc, qsort, rand
+#include <string.h> // For strlen, strcmp, memcpy
+#include <math.h>   // For sqrt
+
+// Defaults of the benchmark driver, each of them can be overwritten on the command line
+#ifndef BENCH_WARMUP_COUNT
+#   define BENCH_WARMUP_COUNT 2     // -warmup: Calls of each routine before measuring
+#endif
+#ifndef BENCH_MAX_REPS
+#   define BENCH_MAX_REPS 10000     // -max-reps: Upper limit of measured calls per routine
+#endif
+#ifndef BENCH_TARGET_CI
+#   define BENCH_TARGET_CI 0.01     // -target-ci: Relative half-width of the 95% confidence interval at which a routine is done
+#endif
+#ifndef BENCH_TIME_BUDGET_MS
+#   define BENCH_TIME_BUDGET_MS 200 // -budget-ms: Time after which measuring a configuration is stopped, once all routines reached their minimum amount of calls
+#endif
+#ifndef BENCH_MAX_SPREAD
+#   define BENCH_MAX_SPREAD 0.25    // -max-spread: Results whose 90th percentile exceeds the median by more than this fraction are flagged as noisy
+#endif
+#ifndef BENCH_BASELINE_TOLERANCE
+#   define BENCH_BASELINE_TOLERANCE 0.1 // -baseline-tolerance: Relative change of the median time that isn't reported as a regression or improvement
+#endif
+#ifndef BENCH_MAX_FREQ_DRIFT
+#   define BENCH_MAX_FREQ_DRIFT 0.05 // -max-freq-drift: Relative change of the CPU's frequency above which a configuration is flagged
+#endif
+
+typedef enum Bench_Flag {
+    BENCH_FLAG_HIGH_VARIANCE = 1 << 0,
+    BENCH_FLAG_NOT_CONVERGED = 1 << 1, // The time budget or maximum amount of calls was used up before the confidence interval was tight enough
+    BENCH_FLAG_FREQ_CHANGE   = 1 << 2,
+} Bench_Flag;
+
+typedef struct Bench_Samples {
+    u64 *data; // Elapsed CPU timer cycles of each call
+    u64  count;
+    u64  cap;
+    f64  sum;    // Running sums for computing the confidence interval without going over all samples
+    f64  sum_sq;
+    u32  flags;  // Bench_Flag
+    u64  counters[PERF_MAX_EVENTS]; // Sums of the performance counters in bench_perf over all calls
+} Bench_Samples;
+
+static Perf_Group bench_perf; // Counters that are read around each measured call, disabled if its count is 0
+static Baseline bench_baseline; // Collects all results for comparing them against a baseline or storing them as one, disabled unless active
+
+static void bench_samples_add(Bench_Samples *samples, u64 cycles)
+{
+    if (samples->count == samples->cap) {
+        samples->cap  = samples->cap ? 2*samples->cap : 64;
+        samples->data = realloc(samples->data, samples->cap*sizeof(*samples->data));
+    }
+    samples->data[samples->count++] = cycles;
+    samples->sum    += (f64)cycles;
+    samples->sum_sq += (f64)cycles*(f64)cycles;
+}
+
+// Half-width of the 95% confidence interval of the mean relative to the mean
+static f64 bench_samples_ci(Bench_Samples *samples)
+{
+    u64 n = samples->count;
+    if (n < 2 || !samples->sum) return INFINITY;
+    f64 mean = samples->sum / (f64)n;
+    f64 var  = (samples->sum_sq - samples->sum*mean) / (f64)(n - 1);
+    return 1.96*sqrt(AIL_MAX(var, 0)) / sqrt((f64)n) / mean;
+}
+
+// Times a single call and adds its duration to the samples
+#define BENCH_TIME(samples, call) do { \
+        u64 bench_start_ = ail_bench_cpu_timer(); \
+        call; \
+        bench_samples_add((samples), ail_bench_cpu_timer() - bench_start_); \
+    } while (0)
+
+// Same as BENCH_TIME, but additionally adds the change of the performance counters to the samples
+// The counters are read outside of the timed region, so that the read syscalls don't affect the time
+#define BENCH_TIME_COUNTERS(samples, call) do { \
+        u64 bench_before_[PERF_MAX_EVENTS], bench_after_[PERF_MAX_EVENTS]; \
+        b32 bench_read_ = perf_read(&bench_perf, bench_before_); \
+        BENCH_TIME(samples, call); \
+        if (bench_read_ && perf_read(&bench_perf, bench_after_)) { \
+            for (u32 bench_i_ = 0; bench_i_ < bench_perf.count; bench_i_++) (samples)->counters[bench_i_] += bench_after_[bench_i_] - bench_before_[bench_i_]; \
+        } \
+    } while (0)
+
+static void bench_samples_reset(Bench_Samples *samples)
+{
+    samples->count  = 0;
+    samples->sum    = 0;
+    samples->sum_sq = 0;
+    samples->flags  = 0;
+    memset(samples->counters, 0, sizeof(samples->counters));
+}
+
+static void bench_samples_free(Bench_Samples *samples)
+{
+    free(samples->data);
+    *samples = (Bench_Samples){0};
+}
+
+// Identifies the measured configuration, fields that don't apply to a benchmark are left at 0
+typedef struct Bench_Key {
+    const char *kernel;
+    const char *params; // Free-form description of further parameters (i.e. "elem_size=12"), may be 0
+    u64 size;
+    u64 overlap;
+    u64 src_offset;     // Offset of the source from the start of a 4K page
+    u64 dst_offset;     // Offset of the destination from the start of a 4K page
+    const char *level;  // Smallest cache level that fits the working set (see bench_cache_level), may be 0
+    const char *pages;  // Kind of pages backing the buffers (see page_kind_names), may be 0
+} Bench_Key;
+
+typedef struct Bench_Stats {
+    u64 hits;
+    u64 min;    // All times are in CPU timer cycles
+    u64 median;
+    f64 mean;
+    u64 p90;
+    u64 p99;
+    f64 ci;     // Relative half-width of the 95% confidence interval of the mean
+    u32 flags;  // Bench_Flag
+    f64 counters[PERF_MAX_EVENTS]; // Mean of each counter in bench_perf per call
+} Bench_Stats;
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+    u64 x = *(const u64*)a, y = *(const u64*)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the samples in place
+static Bench_Stats bench_stats(Bench_Samples *samples)
+{
+    Bench_Stats stats = { .hits = samples->count, .flags = samples->flags };
+    u64 n = samples->count;
+    if (!n) return stats;
+    if (n >= 2) stats.ci = bench_samples_ci(samples);
+    qsort(samples->data, n, sizeof(*samples->data), bench_cmp_u64);
+    f64 sum = 0;
+    for (u64 i = 0; i < n; i++) sum += (f64)samples->data[i];
+    stats.min    = samples->data[0];
+    stats.median = samples->data[n/2];
+    stats.mean   = sum / (f64)n;
+    // Nearest-rank percentiles
+    stats.p90    = samples->data[AIL_MIN(n - 1, (n*90 + 99)/100 - 1)];
+    stats.p99    = samples->data[AIL_MIN(n - 1, (n*99 + 99)/100 - 1)];
+    for (u32 i = 0; i < bench_perf.count; i++) stats.counters[i] = (f64)samples->counters[i] / (f64)n;
+    return stats;
+}
+
+// Writes the names of all flags into str, separated by '|'
+static void bench_flags_to_str(u32 flags, char *str, u64 str_size)
+{
+    static const char *names[] = { "high_variance", "not_converged", "freq_change" };
+    u64 len = 0;
+    str[0]  = 0;
+    for (u32 i = 0; i < AIL_ARRLEN(names) && len < str_size; i++) {
+        if (flags & (1u << i)) len += snprintf(str + len, str_size - len, "%s%s", len ? "|" : "", names[i]);
+    }
+}
+
+typedef void (*Bench_Run)(void *ctx, u64 idx); // Calls the routine with the given index once
+
+typedef struct Bench_Driver {
+    u64 warmup_count;
+    u64 min_reps;
+    u64 max_reps;
+    f64 target_ci;
+    f64 budget_ms;
+    f64 max_spread;
+    f64 max_freq_drift;
+} Bench_Driver;
+
+static Bench_Driver bench_driver_from_args(int argc, char **argv, u64 min_reps)
+{
+    Bench_Driver d = {
+        .warmup_count   = args_get_u64(argc, argv, "-warmup",         BENCH_WARMUP_COUNT),
+        .min_reps       = args_get_u64(argc, argv, "-min-reps",       min_reps),
+        .max_reps       = args_get_u64(argc, argv, "-max-reps",       BENCH_MAX_REPS),
+        .target_ci      = args_get_f64(argc, argv, "-target-ci",      BENCH_TARGET_CI),
+        .budget_ms      = args_get_f64(argc, argv, "-budget-ms",      BENCH_TIME_BUDGET_MS),
+        .max_spread     = args_get_f64(argc, argv, "-max-spread",     BENCH_MAX_SPREAD),
+        .max_freq_drift = args_get_f64(argc, argv, "-max-freq-drift", BENCH_MAX_FREQ_DRIFT),
+    };
+    d.min_reps = AIL_MAX(d.min_reps, 2);
+    d.max_reps = AIL_MAX(d.max_reps, d.min_reps);
+    if (args_has(argc, argv, "-perf") || args_has(argc, argv, "-perf-events")) {
+        const char *events = args_get(argc, argv, "-perf-events", PERF_DEFAULT_EVENTS);
+        if (perf_open(&bench_perf, events)) {
+            printf("Reading performance counters around each measured call:");
+            for (u32 i = 0; i < bench_perf.count; i++) printf(" %s", bench_perf.names[i]);
+            printf("\n");
+        } else {
+            printf("\033[33mNo performance counters are available, benchmarking without them\033[0m\n");
+        }
+    }
+    return d;
+}
+
+// Times a fixed chain of dependent multiplications with the CPU timer
+// The timer runs at a constant rate on modern CPUs, while the chain's speed depends on the core's
+// current frequency, so comparing two measurements reveals frequency changes inbetween them
+static u64 bench_spin_cycles(void)
+{
+    static volatile u64 sink;
+    u64 best = UINT64_MAX;
+    for (u32 k = 0; k < 3; k++) {
+        u64 x = sink | 1;
+        u64 start = ail_bench_cpu_timer();
+        for (u32 i = 0; i < 20000; i++) x = x*6364136223846793005ull + 1442695040888963407ull;
+        u64 elapsed = ail_bench_cpu_timer() - start;
+        sink = x;
+        best = AIL_MIN(best, elapsed);
+    }
+    return best;
+}
+
+static b32 bench_driver_is_done(const Bench_Driver *d, Bench_Samples *samples)
+{
+    if (samples->count < d->min_reps)  return 0;
+    if (samples->count >= d->max_reps) return 1;
+    return bench_samples_ci(samples) <= d->target_ci;
+}
+
+// Measures `count` routines, adding the samples of routine i to samples[i]
+// The profiler's anchors are restored after the warm-up calls, so they only contain the measured calls
+static void bench_driver_run(const Bench_Driver *d, Bench_Run run, void *ctx, Bench_Samples *samples, u64 count)
+{
+    static AIL_Bench_Profile_Anchor saved_anchors[AIL_BENCH_PROFILE_ANCHOR_COUNT];
+    memcpy(saved_anchors, ail_bench_global_anchors, sizeof(saved_anchors));
+    for (u64 k = 0; k < d->warmup_count; k++) {
+        for (u64 i = 0; i < count; i++) run(ctx, i);
+    }
+    memcpy(ail_bench_global_anchors, saved_anchors, sizeof(saved_anchors));
+
+    u64 *order  = malloc(count*sizeof(*order));
+    u64 spin0   = bench_spin_cycles();
+    u64 budget  = (u64)(d->budget_ms / 1000.0 * (f64)ail_bench_cpu_timer_freq());
+    u64 start   = ail_bench_cpu_timer();
+    for (;;) {
+        u64 pending = 0;
+        b32 min_reached = 1;
+        for (u64 i = 0; i < count; i++) {
+            if (!bench_driver_is_done(d, &samples[i])) order[pending++] = i;
+            if (samples[i].count < d->min_reps) min_reached = 0;
+        }
+        if (!pending || (min_reached && ail_bench_cpu_timer() - start > budget)) break;
+        // Randomizing the order each round prevents routines from always running on caches that were warmed up by the same predecessor
+        for (u64 i = pending - 1; i > 0; i--) {
+            u64 j = (u64)rand() % (i + 1);
+            u64 tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+        }
+        for (u64 i = 0; i < pending; i++) {
+            if (bench_perf.count) BENCH_TIME_COUNTERS(&samples[order[i]], run(ctx, order[i]));
+            else                  BENCH_TIME(&samples[order[i]], run(ctx, order[i]));
+        }
+    }
+    u64 spin1 = bench_spin_cycles();
+    free(order);
+
+    f64 drift = (f64)spin1/(f64)spin0 - 1;
+    for (u64 i = 0; i < count; i++) {
+        Bench_Samples *s = &samples[i];
+        if (drift > d->max_freq_drift || -drift > d->max_freq_drift) s->flags |= BENCH_FLAG_FREQ_CHANGE;
+        if (s->count < d->max_reps && bench_samples_ci(s) > d->target_ci) s->flags |= BENCH_FLAG_NOT_CONVERGED;
+        Bench_Stats stats = bench_stats(s);
+        if ((f64)stats.p90 > (f64)stats.median*(1 + d->max_spread)) s->flags |= BENCH_FLAG_HIGH_VARIANCE;
+    }
+}
+
+typedef enum Bench_Format {
+    BENCH_FORMAT_CSV,
+    BENCH_FORMAT_JSON,
+} Bench_Format;
+
+typedef struct Bench_Export {
+    FILE *file; // 0 if exporting is disabled
+    Bench_Format format;
+    u64 rows;
+    u64 cpu_freq;
+} Bench_Export;
+
+// Opens the export file, the format is JSON if the path ends in ".json" and CSV otherwise
+// Exporting stays disabled if path is 0 or the file can't be opened
+static b32 bench_export_open(Bench_Export *export, const char *path)
+{
+    *export = (Bench_Export){0};
+    if (!path) return 0;
+    export->file = fopen(path, "w");
+    if (!export->file) {
+        printf("\033[31mCould not open '%s' for exporting the benchmark results\033[0m\n", path);
+        return 0;
+    }
+    u64 len = strlen(path);
+    export->format   = len >= 5 && !strcmp(path + len - 5, ".json") ? BENCH_FORMAT_JSON : BENCH_FORMAT_CSV;
+    export->cpu_freq = ail_bench_cpu_timer_freq();
+    if (export->format == BENCH_FORMAT_CSV) {
+        fprintf(export->file, "kernel,params,size,overlap,src_offset,dst_offset,level,pages,hits,min_cycles,median_cycles,mean_cycles,p90_cycles,p99_cycles,ci95,bytes_per_cycle,gb_per_s,flags,counters\n");
+    } else {
+        fprintf(export->file, "[");
+    }
+    return 1;
+}
+
+// Writes the mean of each counter per call into str, formatted as "name=value" pairs separated by `sep`
+// JSON strings are quoted by passing `quote`
+static void bench_counters_to_str(const Bench_Stats *stats, const char *sep, const char *quote, char *str, u64 str_size)
+{
+    u64 len = 0;
+    str[0]  = 0;
+    for (u32 i = 0; i < bench_perf.count && len < str_size; i++) {
+        len += snprintf(str + len, str_size - len, "%s%s%s%s%s%.1f", i ? sep : "", quote, bench_perf.names[i], quote, *quote ? ": " : "=", stats->counters[i]);
+    }
+}
+
+static void bench_export_row(Bench_Export *export, Bench_Key key, Bench_Stats stats)
+{
+    if (!export->file || !stats.hits) return;
+    char flags[64];
+    bench_flags_to_str(stats.flags, flags, sizeof(flags));
+    char counters[PERF_MAX_EVENTS*48];
+    // Bandwidth is derived from the fastest run, matching the Min column of the profiler's output
+    f64 bytes_per_cycle = stats.min ? (f64)key.size / (f64)stats.min : 0;
+    f64 gb_per_s        = bytes_per_cycle * (f64)export->cpu_freq / 1e9;
+    const char *params  = key.params ? key.params : "";
+    const char *level   = key.level  ? key.level  : "";
+    const char *pages   = key.pages  ? key.pages  : "";
+    if (export->format == BENCH_FORMAT_CSV) {
+        bench_counters_to_str(&stats, ";", "", counters, sizeof(counters));
+        fprintf(export->file, "%s,%s,%zu,%zu,%zu,%zu,%s,%s,%zu,%zu,%zu,%.1f,%zu,%zu,%.4f,%.4f,%.4f,%s,%s\n",
+                key.kernel, params, key.size, key.overlap, key.src_offset, key.dst_offset, level, pages,
+                stats.hits, stats.min, stats.median, stats.mean, stats.p90, stats.p99, stats.ci, bytes_per_cycle, gb_per_s, flags, counters);
+    } else {
+        bench_counters_to_str(&stats, ", ", "\"", counters, sizeof(counters));
+        fprintf(export->file, "%s\n  {\"kernel\": \"%s\", \"params\": \"%s\", \"size\": %zu, \"overlap\": %zu, \"src_offset\": %zu, \"dst_offset\": %zu, \"level\": \"%s\", \"pages\": \"%s\", "
+                "\"hits\": %zu, \"min_cycles\": %zu, \"median_cycles\": %zu, \"mean_cycles\": %.1f, \"p90_cycles\": %zu, \"p99_cycles\": %zu, "
+                "\"ci95\": %.4f, \"bytes_per_cycle\": %.4f, \"gb_per_s\": %.4f, \"flags\": \"%s\", \"counters\": {%s}}",
+                export->rows ? "," : "", key.kernel, params, key.size, key.overlap, key.src_offset, key.dst_offset, level, pages,
+                stats.hits, stats.min, stats.median, stats.mean, stats.p90, stats.p99, stats.ci, bytes_per_cycle, gb_per_s, flags, counters);
+    }
+    export->rows++;
+}
+
+// Prints the median time and bandwidth of the routine next to the mean of each performance counter per call
+static void bench_print_counters(Bench_Key key, Bench_Stats stats)
+{
+    f64 gb_per_s = stats.median ? (f64)key.size / (f64)stats.median * (f64)ail_bench_cpu_timer_freq() / 1e9 : 0;
+    char name[64];
+    snprintf(name, sizeof(name), "%s%s%s", key.kernel, key.params ? " " : "", key.params ? key.params : "");
+    printf("  %-40s %10zu cycles %8.2f GB/s |", name, stats.median, gb_per_s);
+    for (u32 i = 0; i < bench_perf.count; i++) printf(" %s: %.1f", bench_perf.names[i], stats.counters[i]);
+    printf("\n");
+}
+
+// Computes the statistics of the samples, warns about unreliable results, exports them and resets the samples for the next configuration
+// If performance counters are enabled, their means per call are printed as well
+static void bench_export_samples(Bench_Export *export, Bench_Key key, Bench_Samples *samples)
+{
+    Bench_Stats stats = bench_stats(samples);
+    if (bench_perf.count && stats.hits) bench_print_counters(key, stats);
+    if (stats.flags & (BENCH_FLAG_HIGH_VARIANCE | BENCH_FLAG_FREQ_CHANGE)) {
+        char flags[64];
+        bench_flags_to_str(stats.flags, flags, sizeof(flags));
+        printf("\033[33mWarning: Results of %s%s%s for %zu bytes are unreliable (%s)\033[0m\n", key.kernel, key.params ? " " : "", key.params ? key.params : "", key.size, flags);
+    }
+    bench_export_row(export, key, stats);
+    if (bench_baseline.active && stats.hits) {
+        // bench_stats sorted the samples, so the bounds of the median's confidence interval can be read off by rank
+        u64 lo, hi;
+        baseline_median_ci(stats.hits, &lo, &hi);
+        f64 ns_per_cycle = 1e9 / (f64)ail_bench_cpu_timer_freq();
+        baseline_add(&bench_baseline, key.kernel, key.params, key.pages, key.size, key.overlap, key.src_offset, key.dst_offset,
+                     (f64)stats.median*ns_per_cycle, (f64)samples->data[lo]*ns_per_cycle, (f64)samples->data[hi]*ns_per_cycle);
+    }
+    bench_samples_reset(samples);
+}
+
+// -baseline path compares all results against a stored baseline, -save-baseline path stores them as a new one (both can be combined)
+// Returns false if the baseline to compare against couldn't be read
+static b32 bench_baseline_from_args(int argc, char **argv)
+{
+    const char *compare_path = args_get(argc, argv, "-baseline", 0);
+    const char *save_path    = args_get(argc, argv, "-save-baseline", 0);
+    if (!compare_path && !save_path) return 1;
+    // The best of a few runs of the probe is least affected by interrupts
+    u64 probe = UINT64_MAX;
+    for (u32 i = 0; i < 16; i++) probe = AIL_MIN(probe, bench_spin_cycles());
+    f64 probe_ns = (f64)probe * 1e9 / (f64)ail_bench_cpu_timer_freq();
+    f64 tolerance      = args_get_f64(argc, argv, "-baseline-tolerance", BENCH_BASELINE_TOLERANCE);
+    f64 max_freq_drift = args_get_f64(argc, argv, "-max-freq-drift",     BENCH_MAX_FREQ_DRIFT);
+    if (!baseline_open(&bench_baseline, compare_path, save_path, tolerance, max_freq_drift, probe_ns)) return 0;
+    if (bench_baseline.base_count) printf("Comparing the benchmark results against the %zu results of the baseline %s\n", bench_baseline.base_count, compare_path);
+    return 1;
+}
+
+static void bench_export_close(Bench_Export *export)
+{
+    if (!export->file) return;
+    if (export->format == BENCH_FORMAT_JSON) fprintf(export->file, "\n]\n");
+    fclose(export->file);
+    export->file = 0;
+}
+
+typedef enum Bench_Level {
+    BENCH_LEVEL_L1,
+    BENCH_LEVEL_L2,
+    BENCH_LEVEL_L3,
+    BENCH_LEVEL_DRAM,
+    BENCH_LEVEL_COUNT,
+} Bench_Level;
+
+static const char *bench_level_names[BENCH_LEVEL_COUNT] = { "L1", "L2", "L3", "DRAM" };
+
+// Returns the smallest level of the memory hierarchy that can hold the working set
+static Bench_Level bench_cache_level(u64 working_set)
+{
+    CPU_Cache_Info cache = cpu_cache_info();
+    if (working_set <= cache.l1d) return BENCH_LEVEL_L1;
+    if (working_set <= cache.l2)  return BENCH_LEVEL_L2;
+    if (working_set <= cache.l3)  return BENCH_LEVEL_L3;
+    return BENCH_LEVEL_DRAM;
+}
+
+// Adds sample points for a cache-aware sweep over [min, max] to the `count` sizes that are already in the list
+// Besides every power of 4, points are placed densely around the size at which the working set
+// (`working_set_per_byte` times the buffer size) exactly fills each cache level, both below (fits) and above (spills)
+// The list is kept sorted and free of duplicates, the new count is returned
+static u64 bench_cache_sweep_sizes(u64 *sizes, u64 count, u64 cap, u64 min, u64 max, f64 working_set_per_byte)
+{
+    // In 16ths of the cache size
+    static const u64 around[] = { 8, 12, 14, 15, 16, 17, 18, 20, 24, 32 };
+    CPU_Cache_Info cache = cpu_cache_info();
+    u64 caches[] = { cache.l1d, cache.l2, cache.l3 };
+    for (u64 size = min; size <= max && count < cap; size <<= 2) sizes[count++] = size;
+    for (u64 i = 0; i < AIL_ARRLEN(caches); i++) {
+        if (!caches[i]) continue;
+        u64 boundary = (u64)((f64)caches[i] / working_set_per_byte);
+        for (u64 j = 0; j < AIL_ARRLEN(around) && count < cap; j++) {
+            // Sizes are rounded to cache lines, so that all points are similarly aligned
+            u64 size = (boundary*around[j]/16) & ~(u64)63;
+            if (size >= min && size <= max) sizes[count++] = size;
+        }
+    }
+    qsort(sizes, count, sizeof(*sizes), bench_cmp_u64);
+    u64 unique = 0;
+    for (u64 i = 0; i < count; i++) {
+        if (!unique || sizes[unique - 1] != sizes[i]) sizes[unique++] = sizes[i];
+    }
+    return unique;
+}
+
+// Returns the index of the routine with the lowest median time
+static u64 bench_fastest(Bench_Samples *samples, u64 count)
+{
+    u64 best = 0, best_median = UINT64_MAX;
+    for (u64 i = 0; i < count; i++) {
+        Bench_Stats stats = bench_stats(&samples[i]);
+        if (stats.hits && stats.median < best_median) {
+            best = i;
+            best_median = stats.median;
+        }
+    }
+    return best;
+}
+
+// Fills offsets with every multiple of `step` below 64 and two offsets shortly before the end of a 4K page,
+// so that accesses at the start of the buffer cross a page boundary; returns the amount of offsets
+static u64 bench_alignment_offsets(u64 *offsets, u64 cap, u64 step)
+{
+    u64 count = 0;
+    step = AIL_MAX(step, 1);
+    for (u64 off = 0; off < 64 && count < cap; off += step) offsets[count++] = off;
+    if (count < cap) offsets[count++] = 4096 - 32;
+    if (count < cap) offsets[count++] = 4096 - 1;
+    return count;
+}
+
+// Prints a table of `gb_per_s[row*col_count + col]`, colored by the relation of each value to the table's maximum
+static void bench_print_heat_map(const char *row_label, const u64 *row_offsets, u64 row_count,
+                                 const char *col_label, const u64 *col_offsets, u64 col_count, const f64 *gb_per_s)
+{
+    f64 max = 0;
+    for (u64 i = 0; i < row_count*col_count; i++) max = AIL_MAX(max, gb_per_s[i]);
+    printf("  %s \\ %s", row_label, col_label);
+    for (u64 c = 0; c < col_count; c++) printf(" %6zu", col_offsets[c]);
+    printf("\n");
+    for (u64 r = 0; r < row_count; r++) {
+        printf("  %*zu", (int)(strlen(row_label) + strlen(col_label) + 3), row_offsets[r]);
+        for (u64 c = 0; c < col_count; c++) {
+            f64 x = gb_per_s[r*col_count + c];
+            const char *color = x >= 0.9*max ? "\033[32m" : x >= 0.7*max ? "\033[33m" : "\033[31m";
+            printf(" %s%6.1f\033[0m", color, x);
+        }
+        printf("\n");
+    }
+}
+
+#endif // SPEEDY_BENCH_H_
@@ -0,0 +1,212 @@
+// Runtime detection of x86-64 CPU features
+//
+// Both programs are compiled once and should run on any x86-64 host. Routines that require
+// instruction set extensions beyond the baseline are compiled with `CPU_TARGET` and are only
+// called if `cpu_supports` confirms that both the CPU and the OS (via XGETBV) support them.
+
+#ifndef SPEEDY_CPU_H_
+#define SPEEDY_CPU_H_
+
+#include "ail/ail.h"
+#include <stdio.h>  // For snprintf, fopen
+#include <string.h> // For strncmp
+#include <stdlib.h> // For strtoull
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <intrin.h> // For __cpuidex, _xgetbv
+#   define CPU_TARGET(isa)
+#else
+#   include <cpuid.h>  // For __cpuid_count
+#   define CPU_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+typedef enum CPU_Feature {
+    CPU_SSE2       = 1 << 0,
+    CPU_SSSE3      = 1 << 1,
+    CPU_SSE42      = 1 << 2,
+    CPU_AVX        = 1 << 3,
+    CPU_AVX2       = 1 << 4,
+    CPU_AVX512F    = 1 << 5,
+    CPU_AVX512BW   = 1 << 6,
+    CPU_AVX512VBMI = 1 << 7,
+    CPU_FEATURE_COUNT = 8,
+} CPU_Feature;
+
+static const char *cpu_feature_names[CPU_FEATURE_COUNT] = {
+    "SSE2", "SSSE3", "SSE4.2", "AVX", "AVX2", "AVX-512F", "AVX-512BW", "AVX-512VBMI",
+};
+
+static void cpu_cpuid(u32 leaf, u32 subleaf, u32 regs[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 cpu_xgetbv(u32 idx)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(idx);
+#else
+    u32 lo, hi;
+    __asm__ volatile ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (idx));
+    return ((u64)hi << 32) | lo;
+#endif
+}
+
+// Returns a bitmask of CPU_Feature flags; the result is cached after the first call
+static u32 cpu_features(void)
+{
+    static b32 detected;
+    static u32 features;
+    if (detected) return features;
+    detected = 1;
+
+    u32 r[4];
+    cpu_cpuid(0, 0, r);
+    u32 max_leaf = r[0];
+    cpu_cpuid(1, 0, r);
+    u32 ecx1 = r[2], edx1 = r[3];
+    if (edx1 & (1u << 26)) features |= CPU_SSE2;
+    if (ecx1 & (1u <<  9)) features |= CPU_SSSE3;
+    if (ecx1 & (1u << 20)) features |= CPU_SSE42;
+
+    // The OS has to save the YMM/ZMM registers on context switches, otherwise AVX can't be used even if the CPU supports it
+    b32 os_avx = 0, os_avx512 = 0;
+    if (ecx1 & (1u << 27)) {
+        u64 xcr0  = cpu_xgetbv(0);
+        os_avx    = (xcr0 & 0x06) == 0x06;
+        os_avx512 = (xcr0 & 0xe6) == 0xe6;
+    }
+    if (os_avx && (ecx1 & (1u << 28))) features |= CPU_AVX;
+    if (max_leaf >= 7) {
+        cpu_cpuid(7, 0, r);
+        u32 ebx7 = r[1], ecx7 = r[2];
+        if (os_avx    && (ebx7 & (1u <<  5))) features |= CPU_AVX2;
+        if (os_avx512 && (ebx7 & (1u << 16))) features |= CPU_AVX512F;
+        if (os_avx512 && (ebx7 & (1u << 30))) features |= CPU_AVX512BW;
+        if (os_avx512 && (ecx7 & (1u <<  1))) features |= CPU_AVX512VBMI;
+    }
+    return features;
+}
+
+static b32 cpu_supports(u32 required)
+{
+    return (cpu_features() & required) == required;
+}
+
+// Writes a comma-separated list of the names of all features in `features` into `str`
+static void cpu_features_to_str(u32 features, char *str, u64 str_size)
+{
+    u64 len = 0;
+    str[0]  = 0;
+    for (u32 i = 0; i < CPU_FEATURE_COUNT && len < str_size; i++) {
+        if (features & (1u << i)) len += snprintf(str + len, str_size - len, "%s%s", len ? ", " : "", cpu_feature_names[i]);
+    }
+}
+
+typedef struct CPU_Cache_Info {
+    u64 line_size;
+    u64 l1d; // Sizes in bytes per core (L1/L2) or per package (L3), 0 if there is no such cache
+    u64 l2;
+    u64 l3;
+} CPU_Cache_Info;
+
+static void cpu_cache_info_set(CPU_Cache_Info *info, u32 level, u64 size)
+{
+    switch (level) {
+        case 1: info->l1d = size; break;
+        case 2: info->l2  = size; break;
+        case 3: info->l3  = size; break;
+        default: break; // L4 caches are rare enough to be ignored
+    }
+}
+
+#if defined(__linux__)
+// Reads the cache sizes from sysfs, returns false if they aren't available
+static b32 cpu_cache_info_sysfs(CPU_Cache_Info *info)
+{
+    b32 found = 0;
+    for (u32 idx = 0; idx < 8; idx++) {
+        char path[96], type[32] = {0}, size_str[32] = {0};
+        u32 level = 0;
+        u64 line  = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/level", idx);
+        FILE *f = fopen(path, "r");
+        if (!f) break;
+        b32 ok = fscanf(f, "%u", &level) == 1;
+        fclose(f);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/type", idx);
+        if ((f = fopen(path, "r"))) { ok &= fscanf(f, "%31s", type) == 1; fclose(f); }
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/size", idx);
+        if ((f = fopen(path, "r"))) { ok &= fscanf(f, "%31s", size_str) == 1; fclose(f); }
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/coherency_line_size", idx);
+        if ((f = fopen(path, "r"))) { if (fscanf(f, "%lu", &line) == 1) info->line_size = line; fclose(f); }
+        if (!ok || !strncmp(type, "Instruction", 11)) continue;
+
+        char *unit;
+        u64 size = strtoull(size_str, &unit, 10);
+        if      (*unit == 'K') size <<= 10;
+        else if (*unit == 'M') size <<= 20;
+        else if (*unit == 'G') size <<= 30;
+        cpu_cache_info_set(info, level, size);
+        found = 1;
+    }
+    return found;
+}
+#endif
+
+// Uses the deterministic cache parameters leaf of CPUID (leaf 4 on Intel, 0x8000001D on AMD)
+static b32 cpu_cache_info_cpuid(CPU_Cache_Info *info)
+{
+    u32 r[4];
+    cpu_cpuid(0, 0, r);
+    b32 is_amd = r[1] == 0x68747541; // "Auth" of "AuthenticAMD"
+    u32 leaf   = is_amd ? 0x8000001D : 4;
+    if (is_amd) {
+        cpu_cpuid(0x80000000, 0, r);
+        if (r[0] < leaf) return 0;
+    } else if (r[0] < leaf) return 0;
+
+    b32 found = 0;
+    for (u32 sub = 0; sub < 16; sub++) {
+        cpu_cpuid(leaf, sub, r);
+        u32 type = r[0] & 0x1f;
+        if (!type) break;
+        if (type == 2) continue; // Instruction cache
+        u32 level = (r[0] >> 5) & 0x7;
+        u64 ways  = ((r[1] >> 22) & 0x3ff) + 1;
+        u64 parts = ((r[1] >> 12) & 0x3ff) + 1;
+        u64 line  = ( r[1]        & 0xfff) + 1;
+        u64 sets  = (u64)r[2] + 1;
+        info->line_size = line;
+        cpu_cache_info_set(info, level, ways*parts*line*sets);
+        found = 1;
+    }
+    return found;
+}
+
+// Returns the sizes of the data caches of the first CPU core; the result is cached after the first call
+static CPU_Cache_Info cpu_cache_info(void)
+{
+    static b32 detected;
+    static CPU_Cache_Info info;
+    if (detected) return info;
+    detected = 1;
+#if defined(__linux__)
+    if (cpu_cache_info_sysfs(&info)) return info;
+#endif
+    if (!cpu_cache_info_cpuid(&info)) info.line_size = 64;
+    return info;
+}
+
+// Size of the largest cache level, which is the working set size beyond which copies become DRAM-bound
+static inline u64 cpu_last_level_cache_size(void)
+{
+    CPU_Cache_Info info = cpu_cache_info();
+    return info.l3 ? info.l3 : info.l2 ? info.l2 : info.l1d;
+}
+
+#endif // SPEEDY_CPU_H_
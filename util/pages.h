@@ -0,0 +1,150 @@
+// Page-size aware allocation of benchmark buffers
+//
+// Large buffers backed by regular 4K pages need one TLB entry per 4K, so kernels that walk
+// hundreds of megabytes spend a noticeable part of their time on TLB misses and page walks.
+// Production allocators often back their arenas with huge pages instead, which is mirrored here:
+// `pages_alloc` maps a buffer with explicit 2M/1G huge pages (`MAP_HUGETLB`), with transparent
+// huge pages (`madvise(MADV_HUGEPAGE)`) or with regular pages.
+//
+// Explicit huge pages only exist if they were reserved beforehand (i.e. via /proc/sys/vm/nr_hugepages),
+// so each kind falls back to the next smaller one (1G -> 2M -> THP -> 4K) and reports which kind was used.
+//
+// Anonymous memory is only backed by physical pages once it's touched for the first time, so the first
+// routine writing a fresh buffer also pays for its page faults. Passing `populate` prefaults the whole
+// mapping (`MAP_POPULATE`) instead.
+
+#ifndef SPEEDY_PAGES_H_
+#define SPEEDY_PAGES_H_
+
+#include "ail/ail.h"
+#include <stdio.h>  // For printf, fopen, fgets
+#include <string.h> // For strcmp, strstr
+
+#if defined(_WIN32) || defined(__WIN32__)
+#   include <Windows.h>  // For VirtualAlloc
+#else
+#   include <sys/mman.h> // For mmap, madvise
+#endif
+
+typedef enum Page_Kind {
+    PAGES_4K,
+    PAGES_THP, // Transparent huge pages, the kernel backs 2M-aligned regions with huge pages where it can
+    PAGES_2M,
+    PAGES_1G,
+    PAGES_COUNT,
+} Page_Kind;
+
+static const char *page_kind_names[PAGES_COUNT] = { "4K", "THP", "2M", "1G" };
+
+// Parses the name of a page kind case-insensitively, returns `fallback` for unknown names
+static Page_Kind page_kind_from_str(const char *str, Page_Kind fallback)
+{
+    if (!str) return fallback;
+    for (u32 i = 0; i < PAGES_COUNT; i++) {
+        const char *a = str, *b = page_kind_names[i];
+        while (*a && *b && (*a | 0x20) == (*b | 0x20)) { a++; b++; }
+        if (!*a && !*b) return (Page_Kind)i;
+    }
+    printf("\033[33mUnknown page size '%s', using %s pages instead\033[0m\n", str, page_kind_names[fallback]);
+    return fallback;
+}
+
+// Alignment and granularity of a mapping of the given kind
+static u64 page_kind_size(Page_Kind kind)
+{
+    switch (kind) {
+        case PAGES_THP:
+        case PAGES_2M: return AIL_MB(2);
+        case PAGES_1G: return AIL_GB(1);
+        default:       return AIL_KB(4);
+    }
+}
+
+#if !defined(_WIN32) && !defined(__WIN32__)
+#ifndef MAP_HUGE_SHIFT
+#   define MAP_HUGE_SHIFT 26
+#endif
+
+// THP can be disabled system-wide, in which case madvise succeeds without having any effect
+static b32 pages_thp_enabled(void)
+{
+    static int enabled = -1;
+    if (enabled < 0) {
+        char line[128] = {0};
+        FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        enabled = f && fgets(line, sizeof(line), f) && !strstr(line, "[never]");
+        if (f) fclose(f);
+    }
+    return enabled;
+}
+
+static void *pages_map(u64 size, Page_Kind kind, b32 populate)
+{
+    int flags = MAP_PRIVATE|MAP_ANONYMOUS;
+    if (populate && kind != PAGES_THP) flags |= MAP_POPULATE;
+    if (kind == PAGES_2M) flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+    if (kind == PAGES_1G) flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+    if (kind != PAGES_THP) {
+        void *p = mmap(0, size, PROT_READ|PROT_WRITE, flags, -1, 0);
+        return p == MAP_FAILED ? 0 : p;
+    }
+    if (!pages_thp_enabled()) return 0;
+    // Huge pages can only back 2M-aligned regions, so the mapping is over-allocated and trimmed to an aligned start
+    u64 align = page_kind_size(PAGES_THP);
+    u8 *p = mmap(0, size + align, PROT_READ|PROT_WRITE, flags, -1, 0);
+    if (p == MAP_FAILED) return 0;
+    u8 *start = (u8*)(((u64)p + align - 1) & ~(align - 1));
+    if (start > p) munmap(p, start - p);
+    munmap(start + size, p + align - start);
+    madvise(start, size, MADV_HUGEPAGE);
+    // Populating the mapping before the madvise would back it with 4K pages, so it's touched afterwards instead
+    if (populate) {
+        for (u64 i = 0; i < size; i += AIL_KB(4)) start[i] = 0;
+    }
+    return start;
+}
+#endif
+
+// Maps `size` bytes backed by pages of the given kind or the next smaller kind that is available
+// The kind that was actually used is written to `used` and needs to be passed to pages_free
+// If `populate` is set, all pages are faulted in before returning (not supported on Windows)
+static void *pages_alloc(u64 size, Page_Kind kind, b32 populate, Page_Kind *used)
+{
+    static b32 warned[PAGES_COUNT];
+    size = AIL_MAX(size, 1);
+    for (i32 k = kind; k >= PAGES_4K; k--) {
+        u64 granularity = page_kind_size((Page_Kind)k);
+        u64 mapped_size = (size + granularity - 1) & ~(granularity - 1);
+#if defined(_WIN32) || defined(__WIN32__)
+        // Large pages require the SeLockMemoryPrivilege on Windows, so only regular pages are used there
+        (void)populate;
+        void *p = k == PAGES_4K ? VirtualAlloc(0, mapped_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE) : 0;
+#else
+        void *p = pages_map(mapped_size, (Page_Kind)k, populate);
+#endif
+        if (p) {
+            *used = (Page_Kind)k;
+            return p;
+        }
+        if (k != PAGES_4K && !warned[k]) {
+            warned[k] = 1;
+            printf("\033[33m%s pages are unavailable, falling back to %s pages\033[0m\n", page_kind_names[k], page_kind_names[k - 1]);
+        }
+    }
+    *used = PAGES_4K;
+    return 0;
+}
+
+static void pages_free(void *p, u64 size, Page_Kind used)
+{
+    if (!p) return;
+#if defined(_WIN32) || defined(__WIN32__)
+    (void)size; (void)used;
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    u64 granularity = page_kind_size(used);
+    munmap(p, (AIL_MAX(size, 1) + granularity - 1) & ~(granularity - 1));
+#endif
+}
+
+#endif // SPEEDY_PAGES_H_
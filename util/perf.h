@@ -0,0 +1,149 @@
+// Hardware performance counters via Linux' perf_event_open
+//
+// A group of up to PERF_MAX_EVENTS counters is opened for the calling thread and read around each
+// benchmarked call, so that differences between routines can be attributed to cache/TLB misses,
+// retired instructions etc. The events are given as a comma-separated list of the names in
+// `perf_event_specs` or as `raw:0x<config>` for model-specific events (i.e. `raw:0x0203` for
+// LD_BLOCKS.STORE_FORWARD on recent Intel CPUs).
+//
+// Counters are frequently unavailable (other OSs, containers, a restrictive perf_event_paranoid),
+// so every failure only disables the affected events after printing why.
+
+#ifndef SPEEDY_PERF_H_
+#define SPEEDY_PERF_H_
+
+#include "ail/ail.h"
+#include <stdio.h>  // For printf, snprintf
+#include <string.h> // For strncmp, strlen, memcpy
+#include <stdlib.h> // For strtoull
+
+#if defined(__linux__)
+#   include <errno.h>            // For errno
+#   include <unistd.h>           // For syscall, read, close
+#   include <sys/ioctl.h>        // For ioctl
+#   include <sys/syscall.h>      // For SYS_perf_event_open
+#   include <linux/perf_event.h> // For perf_event_attr
+#endif
+
+#define PERF_MAX_EVENTS 8
+#define PERF_DEFAULT_EVENTS "cycles,instructions,l1d-misses,llc-misses,dtlb-misses"
+
+typedef struct Perf_Group {
+    u32  count; // 0 if no counters could be opened
+    int  fds[PERF_MAX_EVENTS];
+    char names[PERF_MAX_EVENTS][24];
+} Perf_Group;
+
+#if defined(__linux__)
+#define PERF_CACHE(cache, op, result) ((cache) | ((op) << 8) | ((result) << 16))
+
+typedef struct Perf_Event_Spec {
+    const char *name;
+    u32 type;
+    u64 config;
+} Perf_Event_Spec;
+
+static const Perf_Event_Spec perf_event_specs[] = {
+    { "cycles",            PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",      PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch-misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "stalls-frontend",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND },
+    { "stalls-backend",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND },
+    { "l1d-loads",         PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_L1D,  PERF_COUNT_HW_CACHE_OP_READ,  PERF_COUNT_HW_CACHE_RESULT_ACCESS) },
+    { "l1d-misses",        PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_L1D,  PERF_COUNT_HW_CACHE_OP_READ,  PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "llc-misses",        PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_LL,   PERF_COUNT_HW_CACHE_OP_READ,  PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "llc-store-misses",  PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_LL,   PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "dtlb-misses",       PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,  PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "dtlb-store-misses", PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_WRITE, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    { "page-faults",       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+// Parses a single event of the list, returns false if it is unknown
+static b32 perf_parse_event(const char *name, u64 len, Perf_Event_Spec *spec)
+{
+    if (len > 4 && !strncmp(name, "raw:", 4)) {
+        spec->type   = PERF_TYPE_RAW;
+        spec->config = strtoull(name + 4, 0, 0);
+        return 1;
+    }
+    for (u32 i = 0; i < AIL_ARRLEN(perf_event_specs); i++) {
+        if (strlen(perf_event_specs[i].name) == len && !strncmp(perf_event_specs[i].name, name, len)) {
+            *spec = perf_event_specs[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int perf_open_event(Perf_Event_Spec spec, int group_fd)
+{
+    struct perf_event_attr attr = {0};
+    attr.size           = sizeof(attr);
+    attr.type           = spec.type;
+    attr.config         = spec.config;
+    attr.disabled       = group_fd == -1;
+    attr.exclude_kernel = 1; // Allows counting with a perf_event_paranoid of up to 2
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+// Opens the comma-separated list of events as one group, returns false if none of them are available
+static b32 perf_open(Perf_Group *group, const char *events)
+{
+    *group = (Perf_Group){0};
+#if defined(__linux__)
+    const char *s = events;
+    while (*s && group->count < PERF_MAX_EVENTS) {
+        u64 len = strcspn(s, ",");
+        Perf_Event_Spec spec;
+        if (!perf_parse_event(s, len, &spec)) {
+            printf("\033[33mIgnoring unknown performance counter '%.*s'\033[0m\n", (int)len, s);
+        } else {
+            int fd = perf_open_event(spec, group->count ? group->fds[0] : -1);
+            if (fd < 0) {
+                printf("\033[33mPerformance counter '%.*s' is unavailable: %s\033[0m\n", (int)len, s, strerror(errno));
+            } else {
+                group->fds[group->count] = fd;
+                snprintf(group->names[group->count], sizeof(group->names[0]), "%.*s", (int)len, s);
+                group->count++;
+            }
+        }
+        s += len + (s[len] == ',');
+    }
+    if (group->count) {
+        ioctl(group->fds[0], PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+        ioctl(group->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    (void)events;
+    printf("\033[33mPerformance counters are only supported on Linux\033[0m\n");
+#endif
+    return group->count > 0;
+}
+
+// Reads the current values of all counters, returns false if they couldn't be read
+static b32 perf_read(Perf_Group *group, u64 *values)
+{
+#if defined(__linux__)
+    if (!group->count) return 0;
+    u64 buf[1 + PERF_MAX_EVENTS];
+    if (read(group->fds[0], buf, sizeof(buf)) < (ssize_t)((1 + group->count)*sizeof(u64))) return 0;
+    memcpy(values, &buf[1], group->count*sizeof(u64));
+    return 1;
+#else
+    (void)group; (void)values;
+    return 0;
+#endif
+}
+
+static void perf_close(Perf_Group *group)
+{
+#if defined(__linux__)
+    for (u32 i = 0; i < group->count; i++) close(group->fds[i]);
+#endif
+    *group = (Perf_Group){0};
+}
+
+#endif // SPEEDY_PERF_H_
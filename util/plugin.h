@@ -0,0 +1,126 @@
+// Loading external routines from shared objects
+//
+// Comparing other implementations (an in-house memcpy, another libc build, a vendor library) against the
+// built-in routines shouldn't require pasting their code into the programs. Instead, a shared object is
+// loaded at runtime with `-plugin path:symbol,symbol,...` (the option can be repeated), and each symbol is
+// resolved with dlsym (GetProcAddress on Windows). What a symbol is, is up to the program (i.e. `copy=name`
+// or `move=name` in mem-copy), which appends the routines to its lists, so they are tested and benchmarked
+// in the same process, on the same buffers and by the same driver as the built-in ones.
+//
+// The routines are called through the programs' function pointer types without any checks, so they need to
+// have exactly that signature. Libraries stay loaded until `plugin_close` is called.
+
+#ifndef SPEEDY_PLUGIN_H_
+#define SPEEDY_PLUGIN_H_
+
+#include "ail/ail.h"
+#include <stdio.h>  // For printf, snprintf
+#include <string.h> // For strrchr, strchr, strcmp
+
+#if defined(_WIN32) || defined(__WIN32__)
+#   include <Windows.h> // For LoadLibraryA, GetProcAddress, FreeLibrary
+#else
+#   include <dlfcn.h>   // For dlopen, dlsym, dlclose (link with -ldl on glibc older than 2.34)
+#endif
+
+#define PLUGIN_MAX_SYMBOLS 32
+
+typedef struct Plugin {
+    void *handle;
+    char  spec[512];  // Copy of the spec that path and symbols point into
+    char *path;
+    const char *file; // File name of the path, which identifies the plugin in the names of its routines
+    char *symbols[PLUGIN_MAX_SYMBOLS];
+    u32   symbol_count;
+    char  names[PLUGIN_MAX_SYMBOLS][96]; // Names of the routines, see plugin_name
+    u32   name_count;
+} Plugin;
+
+// Parses `path:symbol,symbol,...` and loads the library at path
+// The path is split off at the last ':', so Windows paths with a drive letter work as well
+static b32 plugin_open(Plugin *p, const char *spec)
+{
+    *p = (Plugin){0};
+    snprintf(p->spec, sizeof(p->spec), "%s", spec);
+    char *colon = strrchr(p->spec, ':');
+    if (!colon || colon == p->spec || !colon[1]) {
+        printf("\033[31mInvalid plugin '%s', expected path:symbol,symbol,...\033[0m\n", spec);
+        return 0;
+    }
+    *colon  = 0;
+    p->path = p->spec;
+    for (char *s = colon + 1; s && *s && p->symbol_count < PLUGIN_MAX_SYMBOLS;) {
+        char *comma = strchr(s, ',');
+        if (comma) *comma = 0;
+        if (*s) p->symbols[p->symbol_count++] = s;
+        s = comma ? comma + 1 : 0;
+    }
+    p->file = p->path;
+    for (const char *c = p->path; *c; c++) {
+        if (*c == '/' || *c == '\\') p->file = c + 1;
+    }
+#if defined(_WIN32) || defined(__WIN32__)
+    p->handle = (void*)LoadLibraryA(p->path);
+    if (!p->handle) printf("\033[31mCould not load the plugin '%s' (error %lu)\033[0m\n", p->path, GetLastError());
+#else
+    p->handle = dlopen(p->path, RTLD_NOW | RTLD_LOCAL);
+    // Without a slash, dlopen only searches the library path, so the working directory is tried afterwards
+    if (!p->handle && !strchr(p->path, '/')) {
+        char path[sizeof(p->spec) + 2];
+        snprintf(path, sizeof(path), "./%s", p->path);
+        p->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    }
+    if (!p->handle) printf("\033[31mCould not load the plugin '%s' (%s)\033[0m\n", p->path, dlerror());
+#endif
+    return p->handle != 0;
+}
+
+// Returns the address of the symbol or 0 if the library doesn't export it
+static void *plugin_symbol(Plugin *p, const char *symbol)
+{
+#if defined(_WIN32) || defined(__WIN32__)
+    void *addr = (void*)GetProcAddress((HMODULE)p->handle, symbol);
+#else
+    void *addr = dlsym(p->handle, symbol);
+#endif
+    if (!addr) printf("\033[31mThe plugin '%s' doesn't export '%s'\033[0m\n", p->path, symbol);
+    return addr;
+}
+
+// Name of a routine of the plugin, formatted as `symbol@file` to tell it apart from built-in routines of the same name
+// The string is stored in the plugin and stays valid as long as the plugin does
+static char *plugin_name(Plugin *p, const char *symbol)
+{
+    AIL_ASSERT(p->name_count < PLUGIN_MAX_SYMBOLS);
+    char *name = p->names[p->name_count++];
+    snprintf(name, sizeof(p->names[0]), "%s@%s", symbol, p->file);
+    return name;
+}
+
+// Opens the plugin of every `-plugin spec` argument, returns the amount of plugins that were loaded
+static u32 plugin_open_all(int argc, char **argv, Plugin *plugins, u32 cap)
+{
+    u32 count = 0;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "-plugin")) continue;
+        if (count == cap) {
+            printf("\033[33mSkipping the plugin '%s', since at most %u plugins can be loaded\033[0m\n", argv[i + 1], cap);
+            continue;
+        }
+        if (plugin_open(&plugins[count], argv[i + 1])) count++;
+    }
+    return count;
+}
+
+static void plugin_close(Plugin *p)
+{
+    if (!p->handle) return;
+#if defined(_WIN32) || defined(__WIN32__)
+    FreeLibrary((HMODULE)p->handle);
+#else
+    dlclose(p->handle);
+#endif
+    p->handle = 0;
+}
+
+#endif // SPEEDY_PLUGIN_H_
@@ -0,0 +1,196 @@
+// Persistent pool of pinned worker threads
+//
+// The pool is created once and reused for every call of `pool_run`, so splitting work across
+// threads only costs waking up the workers instead of creating new threads each time.
+// `pool_run` executes `task(arg, idx, count)` for every idx in [0, count), distributing the
+// tasks over the workers and the calling thread, and returns once all tasks are finished.
+//
+// Note: The ail profiler isn't thread-safe, so tasks must not call profiled functions.
+
+#ifndef SPEEDY_POOL_H_
+#define SPEEDY_POOL_H_
+
+#include "ail/ail.h"
+#include <stdlib.h> // For calloc, free
+
+#if defined(_WIN32) || defined(__WIN32__)
+#   include <Windows.h> // For CreateThread, SRWLOCK, CONDITION_VARIABLE
+#else
+#   include <pthread.h>     // For pthread_create, pthread_mutex_t, pthread_cond_t
+#   include <unistd.h>      // For sysconf, syscall
+#   include <sys/syscall.h> // For SYS_sched_setaffinity
+#endif
+
+typedef void (*Pool_Task)(void *arg, u32 idx, u32 count);
+
+typedef struct Pool Pool;
+typedef struct Pool_Worker {
+    Pool *pool;
+    u32   cpu;
+} Pool_Worker;
+
+struct Pool {
+    u32 thread_count; // Includes the thread calling pool_run
+    Pool_Worker *workers;
+#if defined(_WIN32) || defined(__WIN32__)
+    HANDLE *threads;
+    SRWLOCK lock;
+    CONDITION_VARIABLE start_cond;
+    CONDITION_VARIABLE done_cond;
+#else
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t  start_cond;
+    pthread_cond_t  done_cond;
+#endif
+    // All of the following are protected by lock
+    u64 generation; // Incremented for every call of pool_run, so workers know when there is new work
+    Pool_Task task;
+    void *arg;
+    u32 task_count;
+    u32 next_task;
+    u32 pending;    // Amount of tasks that were not finished yet
+    b32 quit;
+};
+
+static u32 pool_cpu_count(void)
+{
+#if defined(_WIN32) || defined(__WIN32__)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (u32)n : 1;
+#endif
+}
+
+#if defined(_WIN32) || defined(__WIN32__)
+#   define POOL_LOCK(p)        AcquireSRWLockExclusive(&(p)->lock)
+#   define POOL_UNLOCK(p)      ReleaseSRWLockExclusive(&(p)->lock)
+#   define POOL_WAIT(p, cond)  SleepConditionVariableSRW(&(p)->cond, &(p)->lock, INFINITE, 0)
+#   define POOL_SIGNAL(p, c)   WakeConditionVariable(&(p)->c)
+#   define POOL_BROADCAST(p, c) WakeAllConditionVariable(&(p)->c)
+#else
+#   define POOL_LOCK(p)        pthread_mutex_lock(&(p)->lock)
+#   define POOL_UNLOCK(p)      pthread_mutex_unlock(&(p)->lock)
+#   define POOL_WAIT(p, cond)  pthread_cond_wait(&(p)->cond, &(p)->lock)
+#   define POOL_SIGNAL(p, c)   pthread_cond_signal(&(p)->c)
+#   define POOL_BROADCAST(p, c) pthread_cond_broadcast(&(p)->c)
+#endif
+
+// Runs tasks of the current generation until none are left, must be called with the lock held
+static void pool_work_locked(Pool *pool)
+{
+    while (pool->next_task < pool->task_count) {
+        u32 idx = pool->next_task++;
+        POOL_UNLOCK(pool);
+        pool->task(pool->arg, idx, pool->task_count);
+        POOL_LOCK(pool);
+        if (!--pool->pending) POOL_SIGNAL(pool, done_cond);
+    }
+}
+
+static void pool_pin_current_thread(u32 cpu)
+{
+#if defined(_WIN32) || defined(__WIN32__)
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (cpu % (8*sizeof(DWORD_PTR))));
+#elif defined(__linux__)
+    // The raw syscall avoids depending on _GNU_SOURCE being defined before the first include for cpu_set_t
+    u64 mask[16] = {0};
+    cpu %= 64*AIL_ARRLEN(mask);
+    mask[cpu / 64] |= 1ull << (cpu % 64);
+    syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+#else
+    (void)cpu; // Pinning is not supported on this platform
+#endif
+}
+
+#if defined(_WIN32) || defined(__WIN32__)
+static DWORD WINAPI pool_worker_main(void *arg)
+#else
+static void *pool_worker_main(void *arg)
+#endif
+{
+    Pool_Worker *worker = arg;
+    Pool *pool = worker->pool;
+    pool_pin_current_thread(worker->cpu);
+    u64 seen = 0;
+    POOL_LOCK(pool);
+    for (;;) {
+        while (pool->generation == seen && !pool->quit) POOL_WAIT(pool, start_cond);
+        if (pool->quit) break;
+        seen = pool->generation;
+        pool_work_locked(pool);
+    }
+    POOL_UNLOCK(pool);
+    return 0;
+}
+
+// Starts thread_count-1 worker threads, pinned to the CPUs 1 to thread_count-1
+// If thread_count is 0, one thread per logical CPU is used
+static void pool_init(Pool *pool, u32 thread_count)
+{
+    *pool = (Pool){0};
+    if (!thread_count) thread_count = pool_cpu_count();
+    pool->thread_count = thread_count;
+    pool->workers = calloc(thread_count, sizeof(*pool->workers));
+    pool->threads = calloc(thread_count, sizeof(*pool->threads));
+#if defined(_WIN32) || defined(__WIN32__)
+    InitializeSRWLock(&pool->lock);
+    InitializeConditionVariable(&pool->start_cond);
+    InitializeConditionVariable(&pool->done_cond);
+#else
+    pthread_mutex_init(&pool->lock, 0);
+    pthread_cond_init(&pool->start_cond, 0);
+    pthread_cond_init(&pool->done_cond, 0);
+#endif
+    for (u32 i = 1; i < thread_count; i++) {
+        pool->workers[i] = (Pool_Worker){ .pool = pool, .cpu = i };
+#if defined(_WIN32) || defined(__WIN32__)
+        pool->threads[i] = CreateThread(0, 0, pool_worker_main, &pool->workers[i], 0, 0);
+#else
+        pthread_create(&pool->threads[i], 0, pool_worker_main, &pool->workers[i]);
+#endif
+    }
+}
+
+static void pool_run(Pool *pool, Pool_Task task, void *arg, u32 count)
+{
+    if (count <= 1 || pool->thread_count <= 1) {
+        for (u32 i = 0; i < count; i++) task(arg, i, count);
+        return;
+    }
+    POOL_LOCK(pool);
+    pool->task       = task;
+    pool->arg        = arg;
+    pool->task_count = count;
+    pool->next_task  = 0;
+    pool->pending    = count;
+    pool->generation++;
+    POOL_BROADCAST(pool, start_cond);
+    pool_work_locked(pool);
+    while (pool->pending) POOL_WAIT(pool, done_cond);
+    POOL_UNLOCK(pool);
+}
+
+static void pool_deinit(Pool *pool)
+{
+    POOL_LOCK(pool);
+    pool->quit = 1;
+    POOL_BROADCAST(pool, start_cond);
+    POOL_UNLOCK(pool);
+    for (u32 i = 1; i < pool->thread_count; i++) {
+#if defined(_WIN32) || defined(__WIN32__)
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], 0);
+#endif
+    }
+    free(pool->workers);
+    free(pool->threads);
+    *pool = (Pool){0};
+}
+
+#endif // SPEEDY_POOL_H_
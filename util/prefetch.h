@@ -0,0 +1,129 @@
+// Software prefetching with a tunable distance and locality hint
+//
+// The hardware prefetchers of most CPUs follow ascending streams early and reliably, but detect descending
+// streams later (or not at all) and only track a limited amount of streams at once. Kernels that walk memory
+// backwards or from both ends towards the middle can issue explicit prefetches instead, which only pay off
+// with the right distance: Too short and the line isn't there in time, too long and it was evicted again
+// before being used. The best distance depends on the host and on the size of the buffer (cached or DRAM-bound),
+// so it's looked up per stream and size class from a `Prefetch_Table`, which `-prefetch-tune` fills by
+// measuring all candidates in `prefetch_distances` with both hints and stores as text.
+//
+// T0 prefetches into all levels of the cache, NTA minimizes the pollution of the caches by the prefetched
+// lines (on most Intel CPUs, they are only put into the L1 and a single way of the L3).
+
+#ifndef SPEEDY_PREFETCH_H_
+#define SPEEDY_PREFETCH_H_
+
+#include "ail/ail.h"
+#include "size_class.h" // For the size classes that settings are looked up by
+#include <stdio.h>     // For fopen, fprintf, sscanf
+#include <string.h>    // For strcmp
+#include <immintrin.h> // For _mm_prefetch
+
+typedef enum Prefetch_Hint {
+    PREFETCH_T0,
+    PREFETCH_NTA,
+    PREFETCH_HINT_COUNT,
+} Prefetch_Hint;
+
+static const char *prefetch_hint_names[PREFETCH_HINT_COUNT] = { "T0", "NTA" };
+
+typedef struct Prefetch_Setting {
+    u64 distance; // Bytes ahead of the current position in the direction of the stream, 0 disables prefetching
+    Prefetch_Hint hint;
+} Prefetch_Setting;
+
+// Distances that are tried by the tuning sweeps, 0 measures the kernels without prefetching
+static const u64 prefetch_distances[] = { 0, 64, 128, 256, 512, AIL_KB(1), AIL_KB(2), AIL_KB(4), AIL_KB(8) };
+
+#define PREFETCH_MAX_STREAMS 4
+
+typedef struct Prefetch_Table {
+    u32 stream_count;
+    const char **stream_names; // Identify the streams in the stored table
+    Prefetch_Setting settings[PREFETCH_MAX_STREAMS][SIZE_CLASS_COUNT]; // Indexed by size_class
+} Prefetch_Table;
+
+// The hint has to be a compile-time constant of _mm_prefetch, so both versions are spelled out
+#define PREFETCH(p, hint) do { \
+        if ((hint) == PREFETCH_NTA) _mm_prefetch((const char*)(p), _MM_HINT_NTA); \
+        else                        _mm_prefetch((const char*)(p), _MM_HINT_T0); \
+    } while (0)
+
+static inline Prefetch_Setting prefetch_get(const Prefetch_Table *table, u32 stream, u64 size)
+{
+    return table->settings[stream][size_class(size)];
+}
+
+static void prefetch_table_init(Prefetch_Table *table, const char **stream_names, u32 stream_count, Prefetch_Setting setting)
+{
+    AIL_ASSERT(stream_count <= PREFETCH_MAX_STREAMS);
+    table->stream_count = stream_count;
+    table->stream_names = stream_names;
+    for (u32 s = 0; s < stream_count; s++) {
+        for (u32 c = 0; c < SIZE_CLASS_COUNT; c++) table->settings[s][c] = setting;
+    }
+}
+
+// Writes all candidate settings of a tuning sweep into `out` (which needs room for 2*AIL_ARRLEN(prefetch_distances)) and returns their amount
+static u32 prefetch_candidates(Prefetch_Setting *out)
+{
+    u32 count = 0;
+    for (u32 i = 0; i < AIL_ARRLEN(prefetch_distances); i++) {
+        for (u32 h = 0; h < (prefetch_distances[i] ? PREFETCH_HINT_COUNT : 1); h++) {
+            out[count++] = (Prefetch_Setting){ prefetch_distances[i], (Prefetch_Hint)h };
+        }
+    }
+    return count;
+}
+
+// Classes that weren't `tuned` take the setting of the closest tuned class of the same stream (preferring the smaller one on ties)
+static void prefetch_table_spread(Prefetch_Table *table, u32 stream, const b32 *tuned)
+{
+    for (u32 c = 0; c < SIZE_CLASS_COUNT; c++) {
+        if (tuned[c]) continue;
+        for (u32 dist = 1; dist < SIZE_CLASS_COUNT; dist++) {
+            if (c >= dist && tuned[c - dist]) { table->settings[stream][c] = table->settings[stream][c - dist]; break; }
+            if (c + dist < SIZE_CLASS_COUNT && tuned[c + dist]) { table->settings[stream][c] = table->settings[stream][c + dist]; break; }
+        }
+    }
+}
+
+// The table is stored as text, with one line per stream and size class: `<stream> <size class> <distance> <hint>`
+static b32 prefetch_table_save(const Prefetch_Table *table, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    fprintf(f, "# prefetch table: <stream> <size class> <distance in bytes> <T0|NTA>, size class c contains sizes in [2^(c-1), 2^c)\n");
+    for (u32 s = 0; s < table->stream_count; s++) {
+        for (u32 c = 0; c < SIZE_CLASS_COUNT; c++) {
+            Prefetch_Setting p = table->settings[s][c];
+            fprintf(f, "%s %u %llu %s\n", table->stream_names[s], c, (unsigned long long)p.distance, prefetch_hint_names[p.hint]);
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+// Lines naming unknown streams or hints are skipped, classes that the file doesn't mention keep their setting
+static b32 prefetch_table_load(Prefetch_Table *table, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    char line[256], stream[64], hint[16];
+    unsigned long long distance;
+    u32 c;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%63s %u %llu %15s", stream, &c, &distance, hint) != 4 || c >= SIZE_CLASS_COUNT) continue;
+        for (u32 s = 0; s < table->stream_count; s++) {
+            if (strcmp(table->stream_names[s], stream)) continue;
+            for (u32 h = 0; h < PREFETCH_HINT_COUNT; h++) {
+                if (!strcmp(prefetch_hint_names[h], hint)) table->settings[s][c] = (Prefetch_Setting){ distance, (Prefetch_Hint)h };
+            }
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+#endif // SPEEDY_PREFETCH_H_
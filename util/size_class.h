@@ -0,0 +1,29 @@
+// Size classes of copies and buffers
+//
+// Tables that pick a routine or a setting per size (the dispatch table of mem-copy, the prefetch tables)
+// are indexed by size class, so that they share the same boundaries between classes.
+// Size classes group sizes by their highest set bit: class c contains all sizes in [2^(c-1), 2^c).
+// Size 0 shares class 1 with size 1, which keeps the lookup free of branches.
+
+#ifndef SPEEDY_SIZE_CLASS_H_
+#define SPEEDY_SIZE_CLASS_H_
+
+#include "ail/ail.h"
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <intrin.h> // For _BitScanReverse64
+#endif
+
+#define SIZE_CLASS_COUNT 65
+
+static inline u32 size_class(u64 size)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanReverse64(&idx, size | 1);
+    return idx + 1;
+#else
+    return 64 - __builtin_clzll(size | 1);
+#endif
+}
+
+#endif // SPEEDY_SIZE_CLASS_H_
@@ -0,0 +1,159 @@
+// Minimal io_uring wrapper on top of the raw syscalls
+//
+// liburing isn't available everywhere, and only a small part of it is needed for submitting reads and
+// writes, so the rings are set up and mapped here directly (see `man 7 io_uring`). The submission
+// queue is filled with `uring_get_sqe` and handed to the kernel with `uring_submit`, completions are
+// consumed with `uring_wait_cqe`.
+//
+// io_uring is frequently disabled (older kernels, seccomp filters of containers, the
+// kernel.io_uring_disabled sysctl), in which case `uring_init` fails and callers have to fall back.
+
+#ifndef SPEEDY_URING_H_
+#define SPEEDY_URING_H_
+
+#include "ail/ail.h"
+#include <string.h> // For memset
+
+#if defined(__linux__)
+#   include <unistd.h>          // For syscall, close
+#   include <sys/mman.h>        // For mmap
+#   include <sys/syscall.h>     // For SYS_io_uring_setup, SYS_io_uring_enter
+#   include <linux/io_uring.h>  // For io_uring_params, io_uring_sqe, io_uring_cqe
+#endif
+
+#if defined(__linux__)
+typedef struct Uring {
+    int fd;
+    u32 entries;
+    u32 pending; // Entries that were added to the submission queue but not submitted yet
+    // Submission queue
+    u32 *sq_head;
+    u32 *sq_tail;
+    u32 *sq_mask;
+    u32 *sq_array;
+    struct io_uring_sqe *sqes;
+    // Completion queue
+    u32 *cq_head;
+    u32 *cq_tail;
+    u32 *cq_mask;
+    struct io_uring_cqe *cqes;
+    // Mappings for uring_deinit
+    void *sq_ring;
+    void *cq_ring;
+    u64   sq_ring_size;
+    u64   cq_ring_size;
+    u64   sqes_size;
+} Uring;
+
+// Creates a ring with room for `entries` submissions, returns false if io_uring is unavailable
+static b32 uring_init(Uring *ring, u32 entries)
+{
+    memset(ring, 0, sizeof(*ring));
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(SYS_io_uring_setup, entries, &p);
+    if (fd < 0) return 0;
+    ring->fd      = fd;
+    ring->entries = p.sq_entries;
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries*sizeof(u32);
+    ring->cq_ring_size = p.cq_off.cqes  + p.cq_entries*sizeof(struct io_uring_cqe);
+    ring->sqes_size    = p.sq_entries*sizeof(struct io_uring_sqe);
+    // Since Linux 5.4, both rings share a single mapping
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_ring_size = ring->cq_ring_size = AIL_MAX(ring->sq_ring_size, ring->cq_ring_size);
+    }
+    ring->sq_ring = mmap(0, ring->sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(0, ring->cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) goto fail;
+    }
+    ring->sqes = mmap(0, ring->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+
+    u8 *sq = ring->sq_ring, *cq = ring->cq_ring;
+    ring->sq_head  = (u32*)(sq + p.sq_off.head);
+    ring->sq_tail  = (u32*)(sq + p.sq_off.tail);
+    ring->sq_mask  = (u32*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (u32*)(sq + p.sq_off.array);
+    ring->cq_head  = (u32*)(cq + p.cq_off.head);
+    ring->cq_tail  = (u32*)(cq + p.cq_off.tail);
+    ring->cq_mask  = (u32*)(cq + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 1;
+
+fail:
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    close(fd);
+    memset(ring, 0, sizeof(*ring));
+    return 0;
+}
+
+static void uring_deinit(Uring *ring)
+{
+    if (!ring->sq_ring) return;
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+}
+
+// Returns the next free submission queue entry (cleared), or 0 if the queue is full
+static struct io_uring_sqe *uring_get_sqe(Uring *ring)
+{
+    u32 head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    u32 tail = *ring->sq_tail + ring->pending;
+    if (tail - head >= ring->entries) return 0;
+    u32 idx = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->pending++;
+    return sqe;
+}
+
+// Prepares a read or write (IORING_OP_READ/IORING_OP_WRITE) of `len` bytes at `offset` of the file
+static void uring_prep_rw(struct io_uring_sqe *sqe, u8 op, int fd, void *buf, u32 len, u64 offset, u64 user_data)
+{
+    sqe->opcode    = op;
+    sqe->fd        = fd;
+    sqe->addr      = (u64)buf;
+    sqe->len       = len;
+    sqe->off       = offset;
+    sqe->user_data = user_data;
+}
+
+// Submits all prepared entries and waits until at least `wait_nr` completions are available
+// Returns the amount of submitted entries or a negative value on failure
+static int uring_submit(Uring *ring, u32 wait_nr)
+{
+    u32 count = ring->pending;
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + count, __ATOMIC_RELEASE);
+    ring->pending = 0;
+    return (int)syscall(SYS_io_uring_enter, ring->fd, count, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+}
+
+// Waits for the next completion, which is copied into `cqe` and removed from the queue
+static b32 uring_wait_cqe(Uring *ring, struct io_uring_cqe *cqe)
+{
+    for (;;) {
+        u32 head = *ring->cq_head;
+        if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            *cqe = ring->cqes[head & *ring->cq_mask];
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+            return 1;
+        }
+        if (uring_submit(ring, 1) < 0) return 0;
+    }
+}
+#else
+typedef struct Uring { int fd; } Uring;
+static b32  uring_init(Uring *ring, u32 entries) { (void)ring; (void)entries; return 0; }
+static void uring_deinit(Uring *ring) { (void)ring; }
+#endif
+
+#endif // SPEEDY_URING_H_